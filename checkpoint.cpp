@@ -0,0 +1,218 @@
+/*
+ * checkpoint.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "checkpoint.h"
+#include "tokenizer.h"
+
+/*
+ * Number of bytes at the beginning of the input and before the offset
+ * which the fingerprint hashes.
+ * Hashing only these keeps loading independent of the length of the input.
+ */
+#define FINGERPRINT_LENGTH 4096
+
+/**
+ * Returns the given length rounded up to a multiple of 16.
+ */
+static inline size_t padded_length(size_t length) {
+	return (length + 15) & ~(size_t) 15;
+}
+
+/**
+ * Returns the fingerprint of the first offset bytes of the given input.
+ */
+static uint64_t fingerprint(const input_data *input, size_t offset) {
+	size_t length = std::min(offset, (size_t) FINGERPRINT_LENGTH);
+
+	return ((uint64_t) word_hash(input->data, length) << 32)
+			| word_hash(input->data + offset - length, length);
+}
+
+/**
+ * Returns the flags of the current tokenizer mode and normalizations.
+ */
+static uint64_t tokenizer_flags(void) {
+	int normalization = tokenizer_normalization();
+
+	return (tokenizer_utf8() ? CHECKPOINT_UTF8 : 0)
+			| ((normalization & TOKENIZER_FOLD_CASE) ? CHECKPOINT_FOLD_CASE : 0)
+			| ((normalization & TOKENIZER_TRIM) ? CHECKPOINT_TRIM : 0);
+}
+
+size_t checkpoint_tail_offset(const input_data *input) {
+	return seek_prev_boundary(input->data, input->length);
+}
+
+/**
+ * Reads the whole given file into a buffer, which the caller frees.
+ * Returns the buffer, or NULL if the file cannot be read; errno is ENOENT
+ * then if it does not exist.
+ */
+static char *read_file(const char *fname, size_t *length) {
+	FILE *inputfd = fopen(fname, "rb");
+	char *buffer = NULL;
+	long size;
+
+	if (!inputfd) {
+		return NULL;
+	}
+
+	if ((fseek(inputfd, 0, SEEK_END) == 0) && ((size = ftell(inputfd)) >= 0)
+			&& (fseek(inputfd, 0, SEEK_SET) == 0)) {
+		buffer = (char *) malloc(size ? size : 1);
+		if (buffer && (fread(buffer, 1, size, inputfd) != (size_t) size)) {
+			free(buffer);
+			buffer = NULL;
+		}
+		*length = size;
+	}
+
+	fclose(inputfd);
+	errno = 0;
+
+	return buffer;
+}
+
+int checkpoint_load(const char *fname, const input_data *input,
+		checkpoint *cp) {
+	const checkpoint_header *header;
+	const char *tail;
+	char *buffer;
+	size_t length = 0;
+	int status = EXIT_SUCCESS;
+
+	cp->offset = 0;
+	if (word_table_init(&cp->table, 0) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	buffer = read_file(fname, &length);
+	if (!buffer) {
+		if (errno == ENOENT) {
+			return EXIT_SUCCESS;
+		}
+		fprintf(stderr, "Could not read checkpoint file!\n");
+		return EXIT_FAILURE;
+	}
+
+	header = (const checkpoint_header *) buffer;
+	tail = buffer + sizeof(checkpoint_header);
+
+	/*
+	 * A truncated or damaged file must not be trusted, so the table is
+	 * checked record by record before it is merged.
+	 */
+	if ((length < sizeof(checkpoint_header))
+			|| (memcmp(header->magic, CHECKPOINT_MAGIC,
+					sizeof(header->magic)) != 0)
+			|| (header->tail_length > length)
+			|| (header->table_length > length)
+			|| (length != sizeof(checkpoint_header)
+					+ padded_length(header->tail_length)
+					+ header->table_length)
+			|| (word_table_check_serialized(
+					tail + padded_length(header->tail_length),
+					header->table_length, 1) != EXIT_SUCCESS)) {
+		fprintf(stderr, "%s is not a checkpoint file!\n", fname);
+		free(buffer);
+		return EXIT_FAILURE;
+	}
+
+	// the input must begin with the input of the checkpoint
+	if ((input->length < header->offset + header->tail_length)
+			|| (fingerprint(input, header->offset) != header->fingerprint)
+			|| (memcmp(input->data + header->offset, tail,
+					header->tail_length) != 0)) {
+		fprintf(stdout,
+				"Input file does not extend the input of the checkpoint. Counting it completely.\n");
+	} else if (header->flags != tokenizer_flags()) {
+		fprintf(stdout,
+				"Checkpoint was counted with other tokenizer options. Counting it completely.\n");
+	} else if (word_table_merge_serialized(&cp->table,
+			tail + padded_length(header->tail_length), 0)
+			!= EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		status = EXIT_FAILURE;
+	} else {
+		cp->offset = header->offset;
+	}
+
+	free(buffer);
+
+	return status;
+}
+
+int checkpoint_save(const char *fname, const input_data *input,
+		const checkpoint *cp) {
+	size_t fname_length = strlen(fname);
+	char *tmpfname = (char *) malloc(fname_length + 5);
+	checkpoint_header header;
+	char *table = NULL;
+	FILE *outputfd = NULL;
+	static const char padding[16] = { 0 };
+	int error = 0;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.offset = cp->offset;
+	header.fingerprint = fingerprint(input, cp->offset);
+	header.tail_length = input->length - cp->offset;
+	header.table_length = word_table_serialized_length(&cp->table, 1);
+	header.flags = tokenizer_flags();
+
+	table = (char *) malloc(header.table_length);
+	if (!tmpfname || !table) {
+		fprintf(stderr, "Not enough memory!\n");
+		free(tmpfname);
+		free(table);
+		return EXIT_FAILURE;
+	}
+	word_table_serialize(&cp->table, table, 1);
+
+	memcpy(tmpfname, fname, fname_length);
+	memcpy(tmpfname + fname_length, ".tmp", 5);
+
+	outputfd = fopen(tmpfname, "wb");
+	if (!outputfd) {
+		error = 1;
+	} else {
+		size_t padding_length = padded_length(header.tail_length)
+				- header.tail_length;
+
+		error = (fwrite(&header, sizeof(header), 1, outputfd) != 1)
+				|| (fwrite(input->data + cp->offset, 1, header.tail_length,
+						outputfd) != header.tail_length)
+				|| (fwrite(padding, 1, padding_length, outputfd)
+						!= padding_length)
+				|| (fwrite(table, 1, header.table_length, outputfd)
+						!= header.table_length);
+		error = (fclose(outputfd) != 0) || error;
+	}
+
+	if (!error && (rename(tmpfname, fname) != 0)) {
+		error = 1;
+	}
+	if (error) {
+		fprintf(stderr, "Could not write checkpoint file!\n");
+		remove(tmpfname);
+	}
+
+	free(tmpfname);
+	free(table);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void checkpoint_free(checkpoint *cp) {
+	word_table_free(&cp->table);
+	cp->offset = 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * checkpoint.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "input.h"
+#include "word_table.h"
+
+/*
+ * A checkpoint file begins with a checkpoint_header, which is followed by
+ * the trailing partial word of the input and the serialized table with a
+ * single partition.
+ * The partial word is padded to a multiple of 16 bytes, so that the table
+ * is aligned.
+ */
+#define CHECKPOINT_MAGIC "WFCCKPT2"
+
+/*
+ * Flags of a checkpoint file.
+ */
+#define CHECKPOINT_UTF8 1
+#define CHECKPOINT_FOLD_CASE 2
+#define CHECKPOINT_TRIM 4
+
+/**
+ * Header of a checkpoint file.
+ * The fingerprint hashes the beginning of the input and the bytes before
+ * offset, which detects inputs that were replaced instead of appended to.
+ * The flags record the tokenizer mode and the normalizations with which
+ * the input was counted.
+ */
+typedef struct checkpoint_header_t {
+	char magic[8];
+	uint64_t offset;
+	uint64_t fingerprint;
+	uint64_t tail_length;
+	uint64_t table_length;
+	uint64_t flags;
+} checkpoint_header;
+
+/**
+ * Counts of the words of an append-only input up to offset.
+ * The input before offset ends with a skippable character, so the words
+ * which start at or after offset are unaffected by the counted words.
+ */
+typedef struct checkpoint_t {
+	size_t offset;
+	word_table table;
+} checkpoint;
+
+/**
+ * Returns the offset of the trailing word of the given input, which bytes
+ * appended later may continue, or the length of the input if it ends with
+ * a skippable character.
+ */
+size_t checkpoint_tail_offset(const input_data *input);
+
+/**
+ * Loads the given checkpoint file of the given input into cp.
+ * If the file does not exist or the input is not an extension of the
+ * input of the checkpoint, cp is empty and the whole input needs to be
+ * counted.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read, is
+ * not a checkpoint file, or there is not enough memory.
+ */
+int checkpoint_load(const char *fname, const input_data *input,
+		checkpoint *cp);
+
+/**
+ * Writes cp of the given input to the given checkpoint file, along with
+ * the trailing partial word after cp->offset.
+ * The file is replaced atomically, so an interrupted run leaves the
+ * previous checkpoint intact.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be written.
+ */
+int checkpoint_save(const char *fname, const input_data *input,
+		const checkpoint *cp);
+
+/**
+ * Frees the counts of the given checkpoint.
+ */
+void checkpoint_free(checkpoint *cp);
+
+#endif /* CHECKPOINT_H_ */
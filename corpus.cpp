@@ -0,0 +1,237 @@
+/*
+ * corpus.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "corpus.h"
+#include "decompress.h"
+
+#define MIN_CAPACITY 64
+
+void corpus_init(corpus *files) {
+	files->files = NULL;
+	files->number_files = 0;
+	files->files_capacity = 0;
+	files->length = 0;
+	files->tasks = NULL;
+	files->number_tasks = 0;
+}
+
+/**
+ * Appends the given file of the given length to the corpus.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int add_file(corpus *files, const char *path, size_t length) {
+	corpus_file *file;
+
+	if (files->number_files == files->files_capacity) {
+		size_t capacity = files->files_capacity ?
+				2 * files->files_capacity : MIN_CAPACITY;
+		corpus_file *larger = (corpus_file *) realloc(files->files,
+				sizeof(corpus_file) * capacity);
+
+		if (!larger) {
+			return EXIT_FAILURE;
+		}
+		files->files = larger;
+		files->files_capacity = capacity;
+	}
+
+	file = &files->files[files->number_files];
+	file->name = strdup(path);
+	if (!file->name) {
+		return EXIT_FAILURE;
+	}
+	file->length = length;
+	files->number_files++;
+
+	if (length != CORPUS_UNKNOWN_LENGTH) {
+		files->length += length;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the length of the given file for splitting it into tasks.
+ * Compressed files cannot be split, as their decompressed length is
+ * unknown before they are decompressed.
+ */
+static size_t file_length(const char *path, const struct stat *st) {
+	if (!S_ISREG(st->st_mode)
+			|| (decompress_detect_file(path) != COMPRESSION_NONE)) {
+		return CORPUS_UNKNOWN_LENGTH;
+	}
+
+	return st->st_size;
+}
+
+/**
+ * Adds the files below the given directory to the corpus.
+ * Symbolic links within the directory are not followed, so that cycles
+ * are impossible.
+ */
+static int add_directory(corpus *files, const char *path) {
+	DIR *dir = opendir(path);
+	struct dirent *entry;
+	size_t path_length = strlen(path);
+	int status = EXIT_SUCCESS;
+
+	if (!dir) {
+		fprintf(stderr, "Could not open directory %s!\n", path);
+		return EXIT_FAILURE;
+	}
+
+	while ((status == EXIT_SUCCESS) && (entry = readdir(dir))) {
+		size_t name_length = strlen(entry->d_name);
+		char *child;
+		struct stat st;
+
+		if ((strcmp(entry->d_name, ".") == 0)
+				|| (strcmp(entry->d_name, "..") == 0)) {
+			continue;
+		}
+
+		child = (char *) malloc(path_length + name_length + 2);
+		if (!child) {
+			fprintf(stderr, "Not enough memory!\n");
+			status = EXIT_FAILURE;
+			break;
+		}
+		memcpy(child, path, path_length);
+		child[path_length] = '/';
+		memcpy(child + path_length + 1, entry->d_name, name_length + 1);
+
+		if (lstat(child, &st) != 0) {
+			fprintf(stderr, "Could not access %s!\n", child);
+			status = EXIT_FAILURE;
+		} else if (S_ISDIR(st.st_mode)) {
+			status = add_directory(files, child);
+		} else if (S_ISREG(st.st_mode) && (add_file(files, child,
+				file_length(child, &st)) != EXIT_SUCCESS)) {
+			fprintf(stderr, "Not enough memory!\n");
+			status = EXIT_FAILURE;
+		}
+
+		free(child);
+	}
+
+	closedir(dir);
+
+	return status;
+}
+
+int corpus_add_path(corpus *files, const char *path) {
+	struct stat st;
+
+	if (stat(path, &st) != 0) {
+		fprintf(stderr, "Could not access %s!\n", path);
+		return EXIT_FAILURE;
+	}
+
+	if (S_ISDIR(st.st_mode)) {
+		return add_directory(files, path);
+	}
+
+	if (add_file(files, path, file_length(path, &st)) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int corpus_add_list(corpus *files, const char *listfname) {
+	FILE *listfd = stdin;
+	char *line = NULL;
+	size_t capacity = 0;
+	ssize_t length;
+	int status = EXIT_SUCCESS;
+
+	if (strcmp(listfname, "-") != 0) {
+		listfd = fopen(listfname, "r");
+		if (!listfd) {
+			fprintf(stderr, "Could not open file list %s!\n", listfname);
+			return EXIT_FAILURE;
+		}
+	}
+
+	while ((status == EXIT_SUCCESS)
+			&& ((length = getline(&line, &capacity, listfd)) >= 0)) {
+		if ((length > 0) && (line[length - 1] == '\n')) {
+			line[--length] = 0;
+		}
+		if (length > 0) {
+			status = corpus_add_path(files, line);
+		}
+	}
+
+	free(line);
+	if (listfd != stdin) {
+		fclose(listfd);
+	}
+
+	return status;
+}
+
+int corpus_plan(corpus *files, size_t chunk_size) {
+	size_t number_tasks = 0;
+	corpus_task *task;
+
+	for (size_t i = 0; i < files->number_files; i++) {
+		size_t length = files->files[i].length;
+
+		if (length == CORPUS_UNKNOWN_LENGTH) {
+			number_tasks++;
+		} else {
+			number_tasks += (length + chunk_size - 1) / chunk_size;
+		}
+	}
+
+	free(files->tasks);
+	files->tasks = (corpus_task *) malloc(
+			sizeof(corpus_task) * (number_tasks + 1));
+	files->number_tasks = number_tasks;
+	if (!files->tasks) {
+		return EXIT_FAILURE;
+	}
+
+	task = files->tasks;
+	for (size_t i = 0; i < files->number_files; i++) {
+		size_t length = files->files[i].length;
+
+		if (length == CORPUS_UNKNOWN_LENGTH) {
+			task->file = i;
+			task->start = 0;
+			task->end = CORPUS_UNKNOWN_LENGTH;
+			task++;
+			continue;
+		}
+
+		for (size_t start = 0; start < length; start += chunk_size) {
+			task->file = i;
+			task->start = start;
+			task->end = (length - start > chunk_size) ?
+					start + chunk_size : length;
+			task++;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void corpus_free(corpus *files) {
+	for (size_t i = 0; i < files->number_files; i++) {
+		free(files->files[i].name);
+	}
+	free(files->files);
+	free(files->tasks);
+	corpus_init(files);
+}
@@ -0,0 +1,86 @@
+/*
+ * corpus.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef CORPUS_H_
+#define CORPUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Length of files which are not regular, such as pipes, or compressed,
+ * which cannot be split.
+ */
+#define CORPUS_UNKNOWN_LENGTH SIZE_MAX
+
+/**
+ * Input file of a corpus.
+ */
+typedef struct corpus_file_t {
+	char *name;
+	size_t length;
+} corpus_file;
+
+/**
+ * Part of a corpus which a worker counts at once: the words which start in
+ * the byte range [start, end) of a file.
+ */
+typedef struct corpus_task_t {
+	size_t file;
+	size_t start;
+	size_t end;
+} corpus_task;
+
+/**
+ * Input files, such as the documents of a directory tree, which a fixed
+ * pool of workers counts together.
+ * Small files are counted whole and large files are split into chunks,
+ * which the workers take from a shared queue of tasks.
+ */
+typedef struct corpus_t {
+	corpus_file *files;
+	size_t number_files;
+	size_t files_capacity;
+	size_t length;
+	corpus_task *tasks;
+	size_t number_tasks;
+} corpus;
+
+/**
+ * Initializes an empty corpus.
+ */
+void corpus_init(corpus *files);
+
+/**
+ * Adds the given file to the corpus, or the files below the given directory,
+ * recursively.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if a file cannot be accessed or there
+ * is not enough memory.
+ */
+int corpus_add_path(corpus *files, const char *path);
+
+/**
+ * Adds the files and directories listed in the given file, one path per
+ * line, to the corpus.
+ * If listfname is "-", the list is read from the standard input.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if a file cannot be accessed or there
+ * is not enough memory.
+ */
+int corpus_add_list(corpus *files, const char *listfname);
+
+/**
+ * Splits the files of the corpus into tasks of at most chunk_size bytes.
+ * Empty files are skipped.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int corpus_plan(corpus *files, size_t chunk_size);
+
+/**
+ * Frees the files and tasks of the corpus.
+ */
+void corpus_free(corpus *files);
+
+#endif /* CORPUS_H_ */
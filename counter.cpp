@@ -0,0 +1,111 @@
+/*
+ * counter.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "counter.h"
+#include "tokenizer.h"
+
+/**
+ * Passes the words of the input which start in the byte range [start, end)
+ * to add, which returns EXIT_SUCCESS or EXIT_FAILURE, after trimming them
+ * if the given tokenizer requests it.
+ * This is the loop of count_range, which is instantiated for each kind of
+ * counter, so that adding a word is inlined.
+ */
+template<typename Add>
+static inline int parse_range(const tokenizer *tok,
+		const input_data *input, size_t start, size_t end, size_t *tokens,
+		Add add) {
+	const char *buffer = input->data;
+	size_t buffer_end = input->length;
+	size_t parse_bound = (end < buffer_end) ? end : buffer_end;
+	/*
+	 * A UTF-8 character which begins before the bound may end up to three
+	 * bytes after it.
+	 */
+	size_t lookahead = (buffer_end - parse_bound > 3) ?
+			parse_bound + 3 : buffer_end;
+	size_t parse_position = start;
+	size_t words = 0;
+	int normalization = tok->normalization;
+
+	if (start >= parse_bound) {
+		return EXIT_SUCCESS;
+	}
+
+	/*
+	 * If the previous character belongs to a word, the worker of the
+	 * previous range parses it.
+	 * Skip the rest of the word, which may span the whole range.
+	 */
+	parse_position = tokenizer_skip_partial_word(tok, buffer, start,
+			lookahead);
+
+	// only words which start before the bound belong to this range
+	parse_position = tokenizer_seek_nonskip(tok, buffer, parse_position,
+			lookahead);
+
+	while (parse_position < parse_bound) {
+		size_t next_parse_position = tokenizer_seek_skip(tok, buffer,
+				parse_position, buffer_end);
+		const char *word = &buffer[parse_position];
+		size_t word_length = next_parse_position - parse_position;
+		int status = EXIT_SUCCESS;
+
+		// normalize the word as it is added, without copying it first
+		if (normalization & TOKENIZER_TRIM) {
+			trim_word(&word, &word_length);
+		}
+
+		if (word_length) {
+			status = add(word, word_length,
+					normalization & TOKENIZER_FOLD_CASE);
+			words++;
+		}
+		if (status != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			return EXIT_FAILURE;
+		}
+
+		if (next_parse_position >= parse_bound) {
+			break;
+		}
+		parse_position = tokenizer_seek_nonskip(tok, buffer,
+				next_parse_position, lookahead);
+	}
+
+	if (tokens) {
+		*tokens += words;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int count_range(const tokenizer *tok, const input_data *input, size_t start,
+		size_t end, word_table *table, size_t *tokens) {
+	return parse_range(tok, input, start, end, tokens,
+			[table](const char *word, size_t length, int fold) {
+				return fold ? word_table_add_folded(table, word, length, 1) :
+						word_table_add(table, word, length, 1);
+			});
+}
+
+int count_range_sketch(const tokenizer *tok, const input_data *input,
+		size_t start, size_t end, heavy_hitters *sketch, size_t *tokens) {
+	return parse_range(tok, input, start, end, tokens,
+			[sketch](const char *word, size_t length, int fold) {
+				return heavy_hitters_add(sketch, word, length, fold);
+			});
+}
+
+int count_range_vocabulary(const tokenizer *tok, const input_data *input,
+		size_t start, size_t end, vocabulary_counts *counts, size_t *tokens) {
+	return parse_range(tok, input, start, end, tokens,
+			[counts](const char *word, size_t length, int fold) {
+				return vocabulary_counts_add(counts, word, length, fold);
+			});
+}
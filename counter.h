@@ -0,0 +1,47 @@
+/*
+ * counter.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef COUNTER_H_
+#define COUNTER_H_
+
+#include <stddef.h>
+#include "input.h"
+#include "sketch.h"
+#include "tokenizer.h"
+#include "vocabulary.h"
+#include "word_table.h"
+
+/**
+ * Counts the words of the input which start in the byte range [start, end)
+ * in the given table with the given tokenizer.
+ * A word which starts before start is left to the range before, even if it
+ * extends into this range, and a word which starts before end is parsed
+ * completely, even if it extends beyond end.
+ * Hence, adjacent ranges of any size count each word exactly once, and the
+ * work for a range is bounded by its size plus the length of its last word.
+ * Unless tokens is NULL, the number of words counted is added to it.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int count_range(const tokenizer *tok, const input_data *input, size_t start,
+		size_t end, word_table *table, size_t *tokens);
+
+/**
+ * Counts the words of the input which start in the byte range [start, end)
+ * in the given sketch, like count_range.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int count_range_sketch(const tokenizer *tok, const input_data *input,
+		size_t start, size_t end, heavy_hitters *sketch, size_t *tokens);
+
+/**
+ * Counts the words of the input which start in the byte range [start, end)
+ * in the given counts of a vocabulary, like count_range.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int count_range_vocabulary(const tokenizer *tok, const input_data *input,
+		size_t start, size_t end, vocabulary_counts *counts, size_t *tokens);
+
+#endif /* COUNTER_H_ */
@@ -0,0 +1,793 @@
+/*
+ * decompress.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
+#ifdef WFC_ZSTD
+#include <zstd.h>
+#endif
+#include "decompress.h"
+
+/*
+ * Compressed bytes per thread, below which an input is decoded by fewer
+ * threads.
+ */
+#define MIN_BYTES_PER_DECODER (1024 * 1024)
+
+/*
+ * Compressed bytes which are passed to zlib at once, as its lengths are
+ * 32 bits wide.
+ */
+#define MAX_ZLIB_LENGTH (1024 * 1024 * 1024)
+
+/*
+ * Size of the buffer of compressed bytes of a stream.
+ */
+#define STREAM_BUFFER_SIZE (256 * 1024)
+
+/*
+ * Window bits which make zlib decode a gzip member.
+ */
+#define GZIP_WINDOW_BITS (15 + 16)
+
+static int decoder_threads = 1;
+
+compression decompress_detect(const char *data, size_t length) {
+	const unsigned char *bytes = (const unsigned char *) data;
+
+	if ((length >= 2) && (bytes[0] == 0x1f) && (bytes[1] == 0x8b)) {
+		return COMPRESSION_GZIP;
+	}
+	if ((length >= 4) && (bytes[0] == 0x28) && (bytes[1] == 0xb5)
+			&& (bytes[2] == 0x2f) && (bytes[3] == 0xfd)) {
+		return COMPRESSION_ZSTD;
+	}
+
+	return COMPRESSION_NONE;
+}
+
+compression decompress_detect_file(const char *fname) {
+	char magic[COMPRESSION_MAGIC_LENGTH];
+	size_t length;
+	FILE *file = fopen(fname, "r");
+
+	if (!file) {
+		return COMPRESSION_NONE;
+	}
+	length = fread(magic, sizeof(char), sizeof(magic), file);
+	fclose(file);
+
+	return decompress_detect(magic, length);
+}
+
+void decompress_set_threads(int no_threads) {
+	decoder_threads = std::max(no_threads, 1);
+}
+
+/**
+ * Makes sure that the given buffer of the given capacity holds at least
+ * length bytes.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int reserve(char **buffer, size_t *capacity, size_t length) {
+	char *larger;
+
+	if (*capacity >= length) {
+		return EXIT_SUCCESS;
+	}
+
+	length = std::max(length, 2 * *capacity);
+	larger = (char *) realloc(*buffer, length);
+	if (!larger) {
+		return EXIT_FAILURE;
+	}
+	*buffer = larger;
+	*capacity = length;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Returns true, iff a gzip member with a valid header may start at the
+ * given bytes: the magic number, the deflate method, and no reserved
+ * flags.
+ */
+static inline bool is_member_header(const unsigned char *data,
+		size_t length) {
+	return (length >= 4) && (data[0] == 0x1f) && (data[1] == 0x8b)
+			&& (data[2] == 8) && ((data[3] & 0xe0) == 0);
+}
+
+/**
+ * Returns the offset of the first possible gzip member header in
+ * [start, end) of the given data, or end if there is none.
+ * The compressed data of a member may contain such bytes, too, so a
+ * header is only confirmed by decoding the member.
+ */
+static size_t find_member(const unsigned char *data, size_t length,
+		size_t start, size_t end) {
+	while (start < end) {
+		const unsigned char *candidate = (const unsigned char *) memchr(
+				data + start, 0x1f, end - start);
+
+		if (!candidate) {
+			break;
+		}
+		start = candidate - data;
+		if (is_member_header(candidate, length - start)) {
+			return start;
+		}
+		start++;
+	}
+
+	return end;
+}
+
+/**
+ * Decoded part of a gzip input: the members which start in
+ * [start, end) of the compressed bytes.
+ */
+typedef struct gzip_segment_t {
+	size_t start;
+	size_t end;
+	char *data;
+	size_t length;
+	size_t capacity;
+	int status;
+} gzip_segment;
+
+/**
+ * Decodes the gzip members of data from offset start on, until a member
+ * starts at or beyond stop or the data ends, and appends the decoded bytes
+ * to segment.
+ * Bytes after a member which do not start another one are ignored, as by
+ * gzip.
+ * Stores the end of the last member in the end of segment.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if a member is corrupt or there is
+ * not enough memory.
+ */
+static int inflate_members(const unsigned char *data, size_t length,
+		size_t start, size_t stop, gzip_segment *segment) {
+	size_t position = start;
+	z_stream z;
+	int status = EXIT_SUCCESS;
+
+	segment->start = start;
+	segment->end = start;
+
+	memset(&z, 0, sizeof(z));
+	if (inflateInit2(&z, GZIP_WINDOW_BITS) != Z_OK) {
+		return EXIT_FAILURE;
+	}
+
+	do {
+		int ret = Z_OK;
+
+		if (!is_member_header(data + position, length - position)) {
+			break;
+		}
+		inflateReset(&z);
+		z.next_in = (Bytef *) data + position;
+		z.avail_in = std::min(length - position, (size_t) MAX_ZLIB_LENGTH);
+
+		while (ret != Z_STREAM_END) {
+			// the first guess of the decoded length is four times the input
+			if ((segment->length == segment->capacity)
+					&& (reserve(&segment->data, &segment->capacity,
+							std::max(segment->capacity + 1,
+									4 * (stop - start))) != EXIT_SUCCESS)) {
+				fprintf(stderr, "Not enough memory!\n");
+				status = EXIT_FAILURE;
+				break;
+			}
+
+			z.next_out = (Bytef *) segment->data + segment->length;
+			z.avail_out = std::min(segment->capacity - segment->length,
+					(size_t) MAX_ZLIB_LENGTH);
+			ret = inflate(&z, Z_NO_FLUSH);
+			segment->length = (char *) z.next_out - segment->data;
+
+			if ((ret != Z_OK) && (ret != Z_STREAM_END) && (ret != Z_BUF_ERROR)) {
+				status = EXIT_FAILURE;
+				break;
+			}
+			if (z.avail_in == 0) {
+				size_t consumed = z.next_in - data;
+
+				if ((consumed == length) && (ret != Z_STREAM_END)) {
+					// the member is truncated
+					status = EXIT_FAILURE;
+					break;
+				}
+				z.avail_in = std::min(length - consumed,
+						(size_t) MAX_ZLIB_LENGTH);
+			}
+		}
+
+		if (status != EXIT_SUCCESS) {
+			break;
+		}
+		position = z.next_in - data;
+		segment->end = position;
+	} while ((position < stop) && (position < length));
+
+	inflateEnd(&z);
+
+	return status;
+}
+
+/**
+ * Decodes the members of the given segment of workers segments of the
+ * compressed bytes, starting at the first member header in it.
+ */
+static void inflate_segment(const unsigned char *data, size_t length,
+		int worker, int workers, gzip_segment *segment) {
+	size_t start = length / workers * worker;
+	size_t stop = (worker == workers - 1) ?
+			length : length / workers * (worker + 1);
+
+	start = (worker == 0) ? 0 : find_member(data, length, start, stop);
+	if (start == stop) {
+		// no member starts in the segment
+		segment->start = segment->end = stop;
+		segment->status = EXIT_SUCCESS;
+		return;
+	}
+
+	segment->status = inflate_members(data, length, start, stop, segment);
+}
+
+/**
+ * Decodes a gzip input of one or more members.
+ * The compressed bytes are split into a segment per thread, and each
+ * thread decodes the members which start in its segment.
+ * As the bytes of a member header may occur inside of a member, the
+ * segments are chained afterwards: a segment whose first member does not
+ * start where the previous segment ended is decoded again from there.
+ * So a single member is decoded by one thread, and an input of many
+ * members, such as a log of appended members or the output of bgzip, by
+ * all threads.
+ */
+static int inflate_input(const input_data *compressed, input_data *output) {
+	const unsigned char *data = (const unsigned char *) compressed->data;
+	size_t length = compressed->length;
+	int workers = (int) std::min((size_t) decoder_threads,
+			length / MIN_BYTES_PER_DECODER + 1);
+	std::vector<gzip_segment> segments(workers);
+	std::vector<std::thread> threads;
+	size_t position = 0;
+	size_t total = 0;
+	int decoded = 0;
+	char *buffer;
+	int status = EXIT_SUCCESS;
+
+	for (gzip_segment &segment : segments) {
+		memset(&segment, 0, sizeof(segment));
+	}
+
+	try {
+		for (int i = 1; i < workers; i++) {
+			threads.push_back(std::thread(inflate_segment, data, length, i,
+					workers, &segments[i]));
+		}
+	} catch (const std::system_error &e) {
+		// the segments of missing threads are decoded while chaining
+	}
+	inflate_segment(data, length, 0, workers, &segments[0]);
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	for (size_t i = threads.size() + 1; i < segments.size(); i++) {
+		segments[i].status = EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < workers; i++) {
+		gzip_segment *segment = &segments[i];
+		size_t stop = (i == workers - 1) ? length : length / workers * (i + 1);
+
+		if (status != EXIT_SUCCESS) {
+			break;
+		}
+		if ((position >= stop) || (position == length)) {
+			// the previous segments decoded the members of this one
+			segment->length = 0;
+			continue;
+		}
+		if ((segment->status != EXIT_SUCCESS) || (segment->start != position)) {
+			segment->length = 0;
+			status = inflate_members(data, length, position, stop, segment);
+		}
+		position = segment->end;
+		total += segment->length;
+	}
+
+	for (gzip_segment &segment : segments) {
+		decoded += (segment.length > 0);
+	}
+
+	if (status != EXIT_SUCCESS) {
+		fprintf(stderr, "Could not decompress input file!\n");
+	} else if (decoded <= 1) {
+		// a single member is not copied
+		for (gzip_segment &segment : segments) {
+			if ((segment.length > 0) || (&segment == &segments[0])) {
+				output->data = segment.data;
+				output->length = segment.length;
+				output->mapped = 0;
+				segment.data = NULL;
+				break;
+			}
+		}
+		if (!output->data) {
+			output->data = (char *) malloc(1);
+		}
+		if (!output->data) {
+			fprintf(stderr, "Not enough memory!\n");
+			status = EXIT_FAILURE;
+		}
+	} else if (!(buffer = (char *) malloc(total))) {
+		fprintf(stderr, "Not enough memory!\n");
+		status = EXIT_FAILURE;
+	} else {
+		output->data = buffer;
+		output->length = total;
+		output->mapped = 0;
+		for (gzip_segment &segment : segments) {
+			memcpy(buffer, segment.data, segment.length);
+			buffer += segment.length;
+		}
+	}
+
+	for (gzip_segment &segment : segments) {
+		free(segment.data);
+	}
+
+	return status;
+}
+
+#ifdef WFC_ZSTD
+/**
+ * Frame of a zstd input and the offset of its decoded bytes.
+ */
+typedef struct zstd_frame_t {
+	size_t start;
+	size_t length;
+	size_t output_start;
+	size_t output_length;
+} zstd_frame;
+
+/**
+ * Decodes the frames which the thread takes from the given queue, whose
+ * head is next_frame, into output.
+ */
+static void decode_frames(const char *data, const std::vector<zstd_frame> *frames,
+		std::atomic<size_t> *next_frame, char *output, int *status) {
+	ZSTD_DCtx *context = ZSTD_createDCtx();
+	size_t frame_number;
+
+	*status = context ? EXIT_SUCCESS : EXIT_FAILURE;
+	while ((*status == EXIT_SUCCESS) && ((frame_number = next_frame->fetch_add(
+			1, std::memory_order_relaxed)) < frames->size())) {
+		const zstd_frame *frame = &(*frames)[frame_number];
+		size_t decoded = ZSTD_decompressDCtx(context,
+				output + frame->output_start, frame->output_length,
+				data + frame->start, frame->length);
+
+		if (ZSTD_isError(decoded) || (decoded != frame->output_length)) {
+			*status = EXIT_FAILURE;
+		}
+	}
+
+	ZSTD_freeDCtx(context);
+}
+
+/**
+ * Decodes a zstd input in a single pass, for frames which do not record
+ * their decoded length.
+ */
+static int zstd_stream_input(const input_data *compressed, char **buffer,
+		size_t *length) {
+	ZSTD_DStream *stream = ZSTD_createDStream();
+	ZSTD_inBuffer in = { compressed->data, compressed->length, 0 };
+	size_t capacity = 0;
+	int status = stream ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	*buffer = NULL;
+	*length = 0;
+	while ((status == EXIT_SUCCESS) && (in.pos < in.size)) {
+		ZSTD_outBuffer out;
+		size_t ret;
+
+		if ((*length == capacity) && (reserve(buffer, &capacity,
+				std::max(capacity + 1, 4 * compressed->length)) != EXIT_SUCCESS)) {
+			status = EXIT_FAILURE;
+			break;
+		}
+		out.dst = *buffer + *length;
+		out.size = capacity - *length;
+		out.pos = 0;
+		ret = ZSTD_decompressStream(stream, &out, &in);
+		*length += out.pos;
+		if (ZSTD_isError(ret)) {
+			status = EXIT_FAILURE;
+		}
+	}
+
+	ZSTD_freeDStream(stream);
+
+	return status;
+}
+
+/**
+ * Decodes a zstd input of one or more frames.
+ * The frames are located by their headers and block headers, without
+ * decoding them, so that the threads decode them in parallel into their
+ * places in the output.
+ */
+static int zstd_input(const input_data *compressed, input_data *output) {
+	std::vector<zstd_frame> frames;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> next_frame(0);
+	size_t position = 0;
+	size_t total = 0;
+	bool sized = true;
+	char *buffer = NULL;
+	int workers;
+	int status = EXIT_SUCCESS;
+
+	while (position < compressed->length) {
+		zstd_frame frame;
+		unsigned long long content;
+
+		frame.start = position;
+		frame.length = ZSTD_findFrameCompressedSize(compressed->data + position,
+				compressed->length - position);
+		if (ZSTD_isError(frame.length)) {
+			fprintf(stderr, "Could not decompress input file!\n");
+			return EXIT_FAILURE;
+		}
+		content = ZSTD_getFrameContentSize(compressed->data + position,
+				frame.length);
+		if (content == ZSTD_CONTENTSIZE_ERROR) {
+			fprintf(stderr, "Could not decompress input file!\n");
+			return EXIT_FAILURE;
+		}
+		if (content == ZSTD_CONTENTSIZE_UNKNOWN) {
+			sized = false;
+			break;
+		}
+		frame.output_start = total;
+		frame.output_length = content;
+		total += content;
+		position += frame.length;
+		frames.push_back(frame);
+	}
+
+	if (!sized) {
+		size_t length;
+
+		if (zstd_stream_input(compressed, &buffer, &length) != EXIT_SUCCESS) {
+			fprintf(stderr, "Could not decompress input file!\n");
+			free(buffer);
+			return EXIT_FAILURE;
+		}
+		output->data = buffer;
+		output->length = length;
+		output->mapped = 0;
+		return EXIT_SUCCESS;
+	}
+
+	buffer = (char *) malloc(std::max(total, (size_t) 1));
+	if (!buffer) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	workers = (int) std::min((size_t) decoder_threads, frames.size());
+	workers = std::max(workers, 1);
+	std::vector<int> statuses(workers, EXIT_SUCCESS);
+
+	try {
+		for (int i = 1; i < workers; i++) {
+			threads.push_back(std::thread(decode_frames, compressed->data,
+					&frames, &next_frame, buffer, &statuses[i]));
+		}
+	} catch (const std::system_error &e) {
+		// the remaining threads take the frames of the missing ones
+	}
+	decode_frames(compressed->data, &frames, &next_frame, buffer,
+			&statuses[0]);
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	for (int i = 0; i <= (int) threads.size(); i++) {
+		if (statuses[i] != EXIT_SUCCESS) {
+			status = EXIT_FAILURE;
+		}
+	}
+	if (status != EXIT_SUCCESS) {
+		fprintf(stderr, "Could not decompress input file!\n");
+		free(buffer);
+		return EXIT_FAILURE;
+	}
+
+	output->data = buffer;
+	output->length = total;
+	output->mapped = 0;
+
+	return EXIT_SUCCESS;
+}
+#endif
+
+int decompress_input(const input_data *compressed, compression format,
+		input_data *output) {
+	output->data = NULL;
+	output->length = 0;
+	output->mapped = 0;
+
+	switch (format) {
+	case COMPRESSION_GZIP:
+		return inflate_input(compressed, output);
+	case COMPRESSION_ZSTD:
+#ifdef WFC_ZSTD
+		return zstd_input(compressed, output);
+#else
+		fprintf(stderr,
+				"The input file is compressed with zstd, but wfc was built without zstd!\n");
+		return EXIT_FAILURE;
+#endif
+	default:
+		return EXIT_FAILURE;
+	}
+}
+
+/**
+ * State of a stream which decompresses a file while it is read.
+ * The buffer first holds the bytes which were read to detect the
+ * compression.
+ */
+typedef struct decoder_t {
+	FILE *inputfd;
+	compression format;
+	unsigned char *buffer;
+	size_t buffer_start;
+	size_t buffer_length;
+	bool member_ended;
+	bool ended;
+	bool failed;
+	z_stream z;
+#ifdef WFC_ZSTD
+	ZSTD_DStream *zstd;
+#endif
+} decoder;
+
+/**
+ * Refills the buffer of compressed bytes, once it is consumed.
+ * Returns the number of buffered bytes, zero at the end of the file, or -1
+ * if the file cannot be read.
+ */
+static ssize_t refill(decoder *d) {
+	if (d->buffer_start < d->buffer_length) {
+		return d->buffer_length - d->buffer_start;
+	}
+
+	d->buffer_start = 0;
+	d->buffer_length = fread(d->buffer, sizeof(char), STREAM_BUFFER_SIZE,
+			d->inputfd);
+	if (ferror(d->inputfd)) {
+		return -1;
+	}
+
+	return d->buffer_length;
+}
+
+/**
+ * Reads up to size decoded bytes of a gzip stream of one or more members.
+ */
+static ssize_t read_gzip(decoder *d, char *data, size_t size) {
+	z_stream *z = &d->z;
+
+	z->next_out = (Bytef *) data;
+	z->avail_out = std::min(size, (size_t) MAX_ZLIB_LENGTH);
+
+	while ((z->avail_out > 0) && !d->ended) {
+		ssize_t available = refill(d);
+		int ret;
+
+		if (available < 0) {
+			return -1;
+		}
+		if (available == 0) {
+			if (!d->member_ended) {
+				fprintf(stderr, "Could not decompress input file!\n");
+				return -1;
+			}
+			d->ended = true;
+			break;
+		}
+
+		if (d->member_ended) {
+			// bytes after the last member are ignored, as by gzip
+			if (d->buffer[d->buffer_start] != 0x1f) {
+				d->ended = true;
+				break;
+			}
+			inflateReset(z);
+			d->member_ended = false;
+		}
+
+		z->next_in = d->buffer + d->buffer_start;
+		z->avail_in = available;
+		ret = inflate(z, Z_NO_FLUSH);
+		d->buffer_start = z->next_in - d->buffer;
+
+		if (ret == Z_STREAM_END) {
+			d->member_ended = true;
+		} else if ((ret != Z_OK) && (ret != Z_BUF_ERROR)) {
+			fprintf(stderr, "Could not decompress input file!\n");
+			return -1;
+		}
+	}
+
+	return (char *) z->next_out - data;
+}
+
+#ifdef WFC_ZSTD
+/**
+ * Reads up to size decoded bytes of a zstd stream of one or more frames.
+ */
+static ssize_t read_zstd(decoder *d, char *data, size_t size) {
+	ZSTD_outBuffer out = { data, size, 0 };
+
+	while ((out.pos < out.size) && !d->ended) {
+		ssize_t available = refill(d);
+		ZSTD_inBuffer in;
+		size_t ret;
+
+		if (available < 0) {
+			return -1;
+		}
+		if (available == 0) {
+			if (!d->member_ended) {
+				fprintf(stderr, "Could not decompress input file!\n");
+				return -1;
+			}
+			d->ended = true;
+			break;
+		}
+
+		in.src = d->buffer;
+		in.size = d->buffer_length;
+		in.pos = d->buffer_start;
+		ret = ZSTD_decompressStream(d->zstd, &out, &in);
+		d->buffer_start = in.pos;
+		if (ZSTD_isError(ret)) {
+			fprintf(stderr, "Could not decompress input file!\n");
+			return -1;
+		}
+		// zero means that a frame is complete
+		d->member_ended = (ret == 0);
+	}
+
+	return out.pos;
+}
+#endif
+
+/**
+ * Reads up to size bytes of the decoded stream.
+ * Uncompressed files are read directly into data, after the bytes which
+ * were read to detect the compression.
+ */
+static ssize_t decoder_read(void *cookie, char *data, size_t size) {
+	decoder *d = (decoder *) cookie;
+	size_t length;
+
+	switch (d->format) {
+	case COMPRESSION_GZIP:
+	case COMPRESSION_ZSTD: {
+		ssize_t read;
+
+		// report a corrupt stream once, even if it is read again
+		if (d->failed) {
+			return -1;
+		}
+#ifdef WFC_ZSTD
+		read = (d->format == COMPRESSION_GZIP) ?
+				read_gzip(d, data, size) : read_zstd(d, data, size);
+#else
+		read = read_gzip(d, data, size);
+#endif
+		d->failed = (read < 0);
+		return read;
+	}
+	default:
+		break;
+	}
+
+	length = std::min(size, d->buffer_length - d->buffer_start);
+	memcpy(data, d->buffer + d->buffer_start, length);
+	d->buffer_start += length;
+	if (length < size) {
+		length += fread(data + length, sizeof(char), size - length,
+				d->inputfd);
+		if (ferror(d->inputfd)) {
+			return -1;
+		}
+	}
+
+	return length;
+}
+
+static int decoder_close(void *cookie) {
+	decoder *d = (decoder *) cookie;
+
+	if (d->format == COMPRESSION_GZIP) {
+		inflateEnd(&d->z);
+	}
+#ifdef WFC_ZSTD
+	ZSTD_freeDStream(d->zstd);
+#endif
+	free(d->buffer);
+	free(d);
+
+	return 0;
+}
+
+FILE *decompress_open(FILE *inputfd) {
+	cookie_io_functions_t functions = { decoder_read, NULL, NULL,
+			decoder_close };
+	decoder *d = (decoder *) calloc(1, sizeof(decoder));
+	FILE *stream;
+
+	if (!d || !(d->buffer = (unsigned char *) malloc(STREAM_BUFFER_SIZE))) {
+		free(d);
+		return NULL;
+	}
+
+	d->inputfd = inputfd;
+	d->buffer_length = fread(d->buffer, sizeof(char),
+			COMPRESSION_MAGIC_LENGTH, inputfd);
+	d->format = decompress_detect((const char *) d->buffer, d->buffer_length);
+	// an empty stream of members is complete
+	d->member_ended = true;
+
+	if (d->format == COMPRESSION_GZIP) {
+		if (inflateInit2(&d->z, GZIP_WINDOW_BITS) != Z_OK) {
+			decoder_close(d);
+			return NULL;
+		}
+		// the first member starts at once
+		d->member_ended = false;
+	} else if (d->format == COMPRESSION_ZSTD) {
+#ifdef WFC_ZSTD
+		d->zstd = ZSTD_createDStream();
+		if (!d->zstd) {
+			decoder_close(d);
+			return NULL;
+		}
+#else
+		fprintf(stderr,
+				"The input file is compressed with zstd, but wfc was built without zstd!\n");
+		decoder_close(d);
+		return NULL;
+#endif
+	}
+
+	stream = fopencookie(d, "r", functions);
+	if (!stream) {
+		decoder_close(d);
+	}
+
+	return stream;
+}
@@ -0,0 +1,68 @@
+/*
+ * decompress.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef DECOMPRESS_H_
+#define DECOMPRESS_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include "input.h"
+
+/**
+ * Compression formats of an input, which are recognized by their magic
+ * numbers rather than the names of the files.
+ * zstd is only decoded if wfc was built with WFC_ZSTD (make ZSTD=1).
+ */
+typedef enum compression_t {
+	COMPRESSION_NONE,
+	COMPRESSION_GZIP,
+	COMPRESSION_ZSTD
+} compression;
+
+/**
+ * Bytes at the start of an input which identify its compression.
+ */
+#define COMPRESSION_MAGIC_LENGTH 4
+
+/**
+ * Returns the compression of the input which starts with the given bytes.
+ */
+compression decompress_detect(const char *data, size_t length);
+
+/**
+ * Returns the compression of the given file, or COMPRESSION_NONE if it
+ * cannot be read.
+ */
+compression decompress_detect_file(const char *fname);
+
+/**
+ * Sets the number of threads which decompress an input in memory.
+ * Inputs of several gzip members or zstd frames are decoded in parallel.
+ * The default is a single thread.
+ */
+void decompress_set_threads(int no_threads);
+
+/**
+ * Decompresses the given compressed input into output, whose data is
+ * allocated with malloc.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the input is corrupt, its
+ * format is not supported, or there is not enough memory.
+ */
+int decompress_input(const input_data *compressed, compression format,
+		input_data *output);
+
+/**
+ * Returns a stream which yields the decompressed bytes of inputfd, or the
+ * bytes themselves if they are not compressed, for reading with fread.
+ * Closing the stream does not close inputfd.
+ * The stream is decoded by the thread which reads it, so pipes such as
+ * the standard input may be read, too.
+ * Returns NULL if the compression is not supported or there is not
+ * enough memory.
+ */
+FILE *decompress_open(FILE *inputfd);
+
+#endif /* DECOMPRESS_H_ */
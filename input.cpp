@@ -0,0 +1,143 @@
+/*
+ * input.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "decompress.h"
+#include "input.h"
+
+#define READ_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * Reads the given file until its end into a buffer.
+ * This is the fallback for pipes and files which cannot be mapped.
+ */
+static int read_input(FILE *inputfd, input_data *input) {
+	size_t capacity = READ_BUFFER_SIZE;
+	size_t length = 0;
+	char *buffer = (char *) malloc(capacity);
+
+	if (!buffer) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	for (;;) {
+		size_t read;
+
+		if (length == capacity) {
+			char *larger = (char *) realloc(buffer, 2 * capacity);
+
+			if (!larger) {
+				fprintf(stderr, "Not enough memory!\n");
+				free(buffer);
+				return EXIT_FAILURE;
+			}
+			buffer = larger;
+			capacity *= 2;
+		}
+
+		read = fread(buffer + length, sizeof(char), capacity - length, inputfd);
+		length += read;
+
+		if (read == 0) {
+			break;
+		}
+	}
+
+	if (ferror(inputfd)) {
+		fprintf(stderr, "Could not read input file!\n");
+		free(buffer);
+		return EXIT_FAILURE;
+	}
+
+	input->data = buffer;
+	input->length = length;
+	input->mapped = 0;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Replaces the given input by its decompressed bytes, if it is compressed.
+ */
+static int decompress(input_data *input) {
+	compression format = decompress_detect(input->data, input->length);
+	input_data decompressed;
+
+	if (format == COMPRESSION_NONE) {
+		return EXIT_SUCCESS;
+	}
+
+	if (decompress_input(input, format, &decompressed) != EXIT_SUCCESS) {
+		input_close(input);
+		return EXIT_FAILURE;
+	}
+	input_close(input);
+	*input = decompressed;
+
+	return EXIT_SUCCESS;
+}
+
+int input_open(const char *inputfname, input_data *input) {
+	FILE *inputfd = NULL;
+	struct stat st;
+	void *data;
+	int status;
+
+	input->data = NULL;
+	input->length = 0;
+	input->mapped = 0;
+
+	inputfd = fopen(inputfname, "r");
+	if (!inputfd) {
+		fprintf(stderr, "Could not open input file!\n");
+		return EXIT_FAILURE;
+	}
+
+	if ((fstat(fileno(inputfd), &st) == 0) && S_ISREG(st.st_mode)) {
+		if (st.st_size == 0) {
+			fclose(inputfd);
+			return EXIT_SUCCESS;
+		}
+
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+				fileno(inputfd), 0);
+
+		if (data != MAP_FAILED) {
+			// the workers scan their parts from front to back
+			madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+			input->data = (const char *) data;
+			input->length = st.st_size;
+			input->mapped = 1;
+			fclose(inputfd);
+			return decompress(input);
+		}
+	}
+
+	status = read_input(inputfd, input);
+	fclose(inputfd);
+
+	return (status == EXIT_SUCCESS) ? decompress(input) : status;
+}
+
+void input_close(input_data *input) {
+	if (input->mapped) {
+		munmap((void *) input->data, input->length);
+	} else {
+		free((void *) input->data);
+	}
+
+	input->data = NULL;
+	input->length = 0;
+	input->mapped = 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * input.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stddef.h>
+
+/**
+ * Content of an input file.
+ * Regular files are memory-mapped, so that the workers parse the page
+ * cache directly.
+ * Pipes and other files which cannot be mapped are read into a buffer.
+ * Compressed files are decompressed into a buffer.
+ */
+typedef struct input_data_t {
+	const char *data;
+	size_t length;
+	int mapped;
+} input_data;
+
+/**
+ * Makes the content of the given file available in input.
+ * If the file is compressed with gzip or zstd, its decompressed content
+ * is made available (see decompress_input).
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read.
+ */
+int input_open(const char *inputfname, input_data *input);
+
+/**
+ * Releases the content of the given input.
+ */
+void input_close(input_data *input);
+
+#endif /* INPUT_H_ */
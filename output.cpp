@@ -0,0 +1,351 @@
+/*
+ * output.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "output.h"
+#include "parallel.h"
+
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+/*
+ * Number of words below which output_write formats in the calling thread.
+ */
+#define SEQUENTIAL_WORDS 65536
+
+/*
+ * Maximum number of characters of a count, i.e. the digits of UINT64_MAX.
+ */
+#define MAX_COUNT_LENGTH 20
+
+/**
+ * State shared by the threads of output_write and output_format.
+ * The i-th thread writes the lines of its part of the words beginning at
+ * offsets[i] of the file, or of memory if it is not NULL.
+ */
+typedef struct output_work_t {
+	const word_count *words;
+	size_t different_words;
+	int no_threads;
+	int outputfd;
+	int seekable;
+	char *memory;
+	size_t *offsets;
+	int *statuses;
+} output_work;
+
+static const char digit_pairs[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+
+/**
+ * Returns the number of decimal digits of the given count.
+ */
+static inline int count_length(uint64_t value) {
+	int digits = 1;
+
+	for (;;) {
+		if (value < 10) {
+			return digits;
+		}
+		if (value < 100) {
+			return digits + 1;
+		}
+		if (value < 1000) {
+			return digits + 2;
+		}
+		if (value < 10000) {
+			return digits + 3;
+		}
+		value /= 10000;
+		digits += 4;
+	}
+}
+
+/**
+ * Writes the given count in decimal to out, two digits at a time.
+ * Returns the end of the written characters.
+ */
+static inline char *encode_count(char *out, uint64_t value) {
+	char *end = out + count_length(value);
+
+	out = end;
+	while (value >= 100) {
+		const char *pair = digit_pairs + 2 * (value % 100);
+
+		value /= 100;
+		*--out = pair[1];
+		*--out = pair[0];
+	}
+	if (value >= 10) {
+		*--out = digit_pairs[2 * value + 1];
+		*--out = digit_pairs[2 * value];
+	} else {
+		*--out = '0' + value;
+	}
+
+	return end;
+}
+
+/**
+ * Writes length bytes of buffer to the given file at the given offset, or
+ * at the current position if the file is not seekable.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be written.
+ */
+static int write_fully(const output_work *work, const char *buffer,
+		size_t length, size_t offset) {
+	while (length > 0) {
+		ssize_t written = work->seekable ?
+				pwrite(work->outputfd, buffer, length, offset) :
+				write(work->outputfd, buffer, length);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return EXIT_FAILURE;
+		}
+
+		buffer += written;
+		length -= written;
+		offset += written;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the first word of the part of the given thread.
+ */
+static inline size_t part_start(const output_work *work, int thread) {
+	return work->different_words * thread / work->no_threads;
+}
+
+/**
+ * Stores the number of bytes of the lines of the part of the given thread
+ * in the offset of the next thread.
+ */
+static void measure_part(void *arg, int thread) {
+	output_work *work = (output_work *) arg;
+	size_t end = part_start(work, thread + 1);
+	size_t length = 0;
+
+	for (size_t i = part_start(work, thread); i < end; i++) {
+		length += strlen(work->words[i].word)
+				+ count_length(work->words[i].count) + 2;
+	}
+
+	work->offsets[thread + 1] = length;
+}
+
+/**
+ * Writes the line of the given word to out.
+ * Returns the end of the written characters.
+ */
+static inline char *format_line(char *out, const word_count *word,
+		size_t length) {
+	memcpy(out, word->word, length);
+	out += length;
+	*out++ = '\t';
+	out = encode_count(out, word->count);
+	*out++ = '\n';
+
+	return out;
+}
+
+/**
+ * Formats the lines of the part of the given thread into memory at the
+ * offset of the thread.
+ */
+static void fill_part(void *arg, int thread) {
+	output_work *work = (output_work *) arg;
+	size_t end = part_start(work, thread + 1);
+	char *out = work->memory + work->offsets[thread];
+
+	for (size_t i = part_start(work, thread); i < end; i++) {
+		const word_count *word = &work->words[i];
+
+		out = format_line(out, word, strlen(word->word));
+	}
+}
+
+/**
+ * Formats the lines of the part of the given thread into a buffer, which
+ * is written to the file whenever it is full.
+ */
+static void format_part(void *arg, int thread) {
+	output_work *work = (output_work *) arg;
+	size_t end = part_start(work, thread + 1);
+	size_t offset = work->offsets[thread];
+	size_t capacity = OUTPUT_BUFFER_SIZE;
+	char *buffer = (char *) malloc(capacity);
+	char *out = buffer;
+	int status = buffer ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	for (size_t i = part_start(work, thread);
+			(i < end) && (status == EXIT_SUCCESS); i++) {
+		const word_count *word = &work->words[i];
+		size_t length = strlen(word->word);
+		size_t line_length = length + MAX_COUNT_LENGTH + 2;
+
+		if ((size_t) (buffer + capacity - out) < line_length) {
+			status = write_fully(work, buffer, out - buffer, offset);
+			offset += out - buffer;
+			out = buffer;
+
+			// only words longer than the buffer do not fit into it now
+			if (capacity < line_length) {
+				char *larger = (char *) realloc(buffer, line_length);
+
+				if (!larger) {
+					status = EXIT_FAILURE;
+					break;
+				}
+				buffer = out = larger;
+				capacity = line_length;
+			}
+		}
+
+		out = format_line(out, word, length);
+	}
+
+	if (status == EXIT_SUCCESS) {
+		status = write_fully(work, buffer, out - buffer, offset);
+	}
+
+	free(buffer);
+	work->statuses[thread] = status;
+}
+
+int output_write_fd(int outputfd, const word_count *words,
+		size_t different_words, int no_threads) {
+	output_work work;
+	struct stat st;
+	int error = 0;
+
+	work.outputfd = outputfd;
+	work.memory = NULL;
+
+	// pipes, sockets, and devices are written sequentially
+	work.seekable = (fstat(work.outputfd, &st) == 0) && S_ISREG(st.st_mode);
+	if (!work.seekable || (different_words < SEQUENTIAL_WORDS)
+			|| (no_threads < 1)) {
+		no_threads = 1;
+	}
+
+	work.words = words;
+	work.different_words = different_words;
+	work.no_threads = no_threads;
+	work.offsets = (size_t *) calloc(no_threads + 1, sizeof(size_t));
+	work.statuses = (int *) calloc(no_threads, sizeof(int));
+
+	if (!work.offsets || !work.statuses) {
+		fprintf(stderr, "Not enough memory!\n");
+		error = 1;
+	}
+
+	// compute the offset of each part from the lengths of the parts before
+	if (!error && (no_threads > 1)) {
+		run_parallel(no_threads, measure_part, &work);
+		for (int i = 0; i < no_threads; i++) {
+			work.offsets[i + 1] += work.offsets[i];
+		}
+
+		if (ftruncate(work.outputfd, work.offsets[no_threads]) != 0) {
+			error = 1;
+		}
+	}
+
+	if (!error) {
+		run_parallel(no_threads, format_part, &work);
+		for (int i = 0; i < no_threads; i++) {
+			error = error || (work.statuses[i] != EXIT_SUCCESS);
+		}
+	}
+
+	free(work.offsets);
+	free(work.statuses);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int output_write(const char *outputfname, const word_count *words,
+		size_t different_words, int no_threads) {
+	int outputfd = open(outputfname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	int error;
+
+	if (outputfd < 0) {
+		fprintf(stderr, "Could not open output file!\n");
+		return EXIT_FAILURE;
+	}
+
+	error = output_write_fd(outputfd, words, different_words, no_threads);
+
+	if ((close(outputfd) != 0) || error) {
+		fprintf(stderr, "Could not write output file!\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int output_format(const word_count *words, size_t different_words,
+		int no_threads, char **buffer, size_t *length) {
+	output_work work;
+
+	if ((different_words < SEQUENTIAL_WORDS) || (no_threads < 1)) {
+		no_threads = 1;
+	}
+
+	work.words = words;
+	work.different_words = different_words;
+	work.no_threads = no_threads;
+	work.outputfd = -1;
+	work.seekable = 0;
+	work.memory = NULL;
+	work.offsets = (size_t *) calloc(no_threads + 1, sizeof(size_t));
+	work.statuses = NULL;
+
+	if (!work.offsets) {
+		return EXIT_FAILURE;
+	}
+
+	// compute the offset of each part from the lengths of the parts before
+	run_parallel(no_threads, measure_part, &work);
+	for (int i = 0; i < no_threads; i++) {
+		work.offsets[i + 1] += work.offsets[i];
+	}
+
+	// one more byte, so that an empty output is not a NULL buffer
+	work.memory = (char *) malloc(work.offsets[no_threads] + 1);
+	if (!work.memory) {
+		free(work.offsets);
+		return EXIT_FAILURE;
+	}
+
+	run_parallel(no_threads, fill_part, &work);
+
+	*buffer = work.memory;
+	*length = work.offsets[no_threads];
+	free(work.offsets);
+
+	return EXIT_SUCCESS;
+}
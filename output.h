@@ -0,0 +1,40 @@
+/*
+ * output.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <stddef.h>
+#include "ranking.h"
+
+/**
+ * Writes one line "<word>\t<count>\n" for each of the given words to the
+ * given file, which is created or truncated.
+ * If the file is a regular file, up to no_threads threads format disjoint
+ * parts of the words and write them at their offsets in the file.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be written.
+ */
+int output_write(const char *outputfname, const word_count *words,
+		size_t different_words, int no_threads);
+
+/**
+ * Writes the lines of output_write to the given open file, e.g. a socket,
+ * which is not closed.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be written.
+ */
+int output_write_fd(int outputfd, const word_count *words,
+		size_t different_words, int no_threads);
+
+/**
+ * Formats the lines of output_write into a new buffer, which the caller
+ * frees, and stores its length in length.
+ * Up to no_threads threads format disjoint parts of the words.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int output_format(const word_count *words, size_t different_words,
+		int no_threads, char **buffer, size_t *length);
+
+#endif /* OUTPUT_H_ */
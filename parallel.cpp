@@ -0,0 +1,30 @@
+/*
+ * parallel.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+void run_parallel(int no_threads, parallel_function function, void *arg) {
+	std::vector<std::thread> threads;
+	int thread = 1;
+
+	try {
+		for (; thread < no_threads; thread++) {
+			threads.push_back(std::thread(function, arg, thread));
+		}
+	} catch (const std::system_error &e) {
+		for (; thread < no_threads; thread++) {
+			function(arg, thread);
+		}
+	}
+
+	function(arg, 0);
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+}
@@ -0,0 +1,23 @@
+/*
+ * parallel.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+/**
+ * Function which each thread of run_parallel executes with its number.
+ */
+typedef void (*parallel_function)(void *arg, int thread);
+
+/**
+ * Executes function with no_threads threads, numbered from zero, and waits
+ * for them to terminate.
+ * The calling thread is thread zero and takes over the work of threads
+ * which cannot be created, so the function always runs for every number.
+ */
+void run_parallel(int no_threads, parallel_function function, void *arg);
+
+#endif /* PARALLEL_H_ */
@@ -0,0 +1,340 @@
+/*
+ * partial.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "partial.h"
+#include "tokenizer.h"
+
+#define FILE_BUFFER_SIZE (1024 * 1024)
+#define MAGIC_LENGTH (sizeof(PARTIAL_MAGIC) - 1)
+#define MIN_CAPACITY 1024
+
+/**
+ * Partial-count file of the given size in bytes which is being merged,
+ * along with its current record.
+ * A length of zero means that the file has been read completely.
+ */
+typedef struct partial_reader_t {
+	FILE *inputfd;
+	const char *fname;
+	uint64_t size;
+	uint64_t flags;
+	char *word;
+	size_t length;
+	size_t capacity;
+	uint64_t count;
+} partial_reader;
+
+/**
+ * Returns true, iff the first word is lexicographically smaller than the
+ * second word.
+ * Words do not contain null bytes, so strcmp compares their bytes.
+ */
+static bool word_before(const word_count &lhs, const word_count &rhs) {
+	return strcmp(lhs.word, rhs.word) < 0;
+}
+
+/**
+ * Returns true, iff the current word of the first reader is greater than
+ * that of the second reader, which makes the heap of readers a min-heap.
+ */
+static bool reader_after(const partial_reader *lhs, const partial_reader *rhs) {
+	return strcmp(lhs->word, rhs->word) > 0;
+}
+
+/**
+ * Returns the flags of the current tokenizer mode and normalizations.
+ */
+static uint64_t tokenizer_flags(void) {
+	int normalization = tokenizer_normalization();
+
+	return (tokenizer_utf8() ? PARTIAL_UTF8 : 0)
+			| ((normalization & TOKENIZER_FOLD_CASE) ? PARTIAL_FOLD_CASE : 0)
+			| ((normalization & TOKENIZER_TRIM) ? PARTIAL_TRIM : 0);
+}
+
+/**
+ * Writes the given value as variable length integer.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be written.
+ */
+static int write_varint(FILE *outputfd, uint64_t value) {
+	while (value >= 0x80) {
+		if (putc((int) (value & 0x7f) | 0x80, outputfd) == EOF) {
+			return EXIT_FAILURE;
+		}
+		value >>= 7;
+	}
+
+	return (putc((int) value, outputfd) == EOF) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Reads a variable length integer into value.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file ends or the integer
+ * is too long.
+ */
+static int read_varint(FILE *inputfd, uint64_t *value) {
+	*value = 0;
+
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = getc(inputfd);
+
+		if (c == EOF) {
+			return EXIT_FAILURE;
+		}
+
+		*value |= (uint64_t) (c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return EXIT_SUCCESS;
+		}
+	}
+
+	return EXIT_FAILURE;
+}
+
+int partial_write(const char *fname, word_count *words,
+		size_t different_words) {
+	FILE *outputfd = NULL;
+	int error = 0;
+
+	std::sort(words, words + different_words, word_before);
+
+	outputfd = fopen(fname, "wb");
+	if (!outputfd) {
+		fprintf(stderr, "Could not open output file!\n");
+		return EXIT_FAILURE;
+	}
+	setvbuf(outputfd, NULL, _IOFBF, FILE_BUFFER_SIZE);
+
+	error = (fwrite(PARTIAL_MAGIC, 1, MAGIC_LENGTH, outputfd) != MAGIC_LENGTH)
+			|| (write_varint(outputfd, tokenizer_flags()) != EXIT_SUCCESS);
+
+	for (size_t i = 0; (i < different_words) && !error; i++) {
+		size_t length = strlen(words[i].word);
+
+		error = (write_varint(outputfd, length) != EXIT_SUCCESS)
+				|| (fwrite(words[i].word, 1, length, outputfd) != length)
+				|| (write_varint(outputfd, words[i].count)
+						!= EXIT_SUCCESS);
+	}
+
+	// terminate the records, so that truncated files are detected
+	error = error || (write_varint(outputfd, 0) != EXIT_SUCCESS);
+
+	if ((fclose(outputfd) != 0) || error) {
+		fprintf(stderr, "Could not write output file!\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Reads the next record of the given reader.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read, is
+ * truncated, or holds a word which is longer than the file.
+ */
+static int reader_next(partial_reader *reader) {
+	uint64_t length;
+
+	if (read_varint(reader->inputfd, &length) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+	if (length == 0) {
+		reader->length = 0;
+		return EXIT_SUCCESS;
+	}
+
+	// a corrupt length must neither wrap around nor exhaust the memory
+	if (length > reader->size) {
+		return EXIT_FAILURE;
+	}
+
+	if (length + 1 > reader->capacity) {
+		size_t capacity = std::max((size_t) length + 1, 2 * reader->capacity);
+		char *word = (char *) realloc(reader->word, capacity);
+
+		if (!word) {
+			return EXIT_FAILURE;
+		}
+		reader->word = word;
+		reader->capacity = capacity;
+	}
+
+	if (fread(reader->word, 1, length, reader->inputfd) != length) {
+		return EXIT_FAILURE;
+	}
+	reader->word[length] = 0;
+	reader->length = length;
+
+	return read_varint(reader->inputfd, &reader->count);
+}
+
+/**
+ * Opens the given partial-count file and reads its first record.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read.
+ */
+static int reader_open(partial_reader *reader, const char *fname) {
+	char magic[MAGIC_LENGTH];
+	struct stat st;
+
+	reader->fname = fname;
+	reader->inputfd = fopen(fname, "rb");
+	if (!reader->inputfd || (fstat(fileno(reader->inputfd), &st) != 0)) {
+		fprintf(stderr, "Could not open partial-count file %s!\n", fname);
+		return EXIT_FAILURE;
+	}
+	reader->size = st.st_size;
+	setvbuf(reader->inputfd, NULL, _IOFBF, FILE_BUFFER_SIZE);
+
+	if ((fread(magic, 1, MAGIC_LENGTH, reader->inputfd) != MAGIC_LENGTH)
+			|| (memcmp(magic, PARTIAL_MAGIC, MAGIC_LENGTH) != 0)
+			|| (read_varint(reader->inputfd, &reader->flags) != EXIT_SUCCESS)) {
+		fprintf(stderr, "%s is not a partial-count file!\n", fname);
+		return EXIT_FAILURE;
+	}
+
+	if (reader_next(reader) != EXIT_SUCCESS) {
+		fprintf(stderr, "Could not read partial-count file %s!\n", fname);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Adds count occurrences of the given word, which is not smaller than the
+ * words in result, to result.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the word is smaller, there is
+ * not enough memory, or the count overflows.
+ */
+static int result_add(partial_result *result, const partial_reader *reader) {
+	word_count *last = result->different_words ?
+			&result->words[result->different_words - 1] : NULL;
+	int order = last ? strcmp(reader->word, last->word) : 1;
+
+	if (order < 0) {
+		fprintf(stderr, "Partial-count file %s is not sorted!\n",
+				reader->fname);
+		return EXIT_FAILURE;
+	}
+
+	if (order == 0) {
+		if (reader->count > UINT64_MAX - last->count) {
+			fprintf(stderr, "Count of %s is too large!\n", last->word);
+			return EXIT_FAILURE;
+		}
+		last->count += reader->count;
+		return EXIT_SUCCESS;
+	}
+
+	if (result->different_words == result->capacity) {
+		size_t capacity = std::max((size_t) MIN_CAPACITY, 2 * result->capacity);
+		word_count *words = (word_count *) realloc(result->words,
+				sizeof(word_count) * capacity);
+
+		if (!words) {
+			fprintf(stderr, "Not enough memory!\n");
+			return EXIT_FAILURE;
+		}
+		result->words = words;
+		result->capacity = capacity;
+	}
+
+	last = &result->words[result->different_words];
+	last->word = word_arena_copy(&result->arena, reader->word, reader->length);
+	last->count = reader->count;
+	if (!last->word) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+	result->different_words++;
+
+	return EXIT_SUCCESS;
+}
+
+int partial_merge(char *const *fnames, int number_files,
+		partial_result *result) {
+	partial_reader *readers = (partial_reader *) calloc(number_files,
+			sizeof(partial_reader));
+	partial_reader **heap = (partial_reader **) malloc(
+			sizeof(partial_reader *) * number_files);
+	size_t heap_size = 0;
+	int error = 0;
+
+	result->words = NULL;
+	result->different_words = 0;
+	result->capacity = 0;
+	result->arena = NULL;
+
+	if (!readers || !heap) {
+		fprintf(stderr, "Not enough memory!\n");
+		free(readers);
+		free(heap);
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; (i < number_files) && !error; i++) {
+		error = (reader_open(&readers[i], fnames[i]) != EXIT_SUCCESS);
+
+		// the counts of different tokenizer options do not add up
+		if (!error && (readers[i].flags != readers[0].flags)) {
+			fprintf(stderr,
+					"Partial-count files %s and %s were counted with different tokenizer options!\n",
+					fnames[0], fnames[i]);
+			error = 1;
+		}
+
+		if (!error && readers[i].length) {
+			heap[heap_size++] = &readers[i];
+			std::push_heap(heap, heap + heap_size, reader_after);
+		}
+	}
+
+	// take the smallest current word of all files until all files are read
+	while (heap_size && !error) {
+		partial_reader *reader;
+
+		std::pop_heap(heap, heap + heap_size, reader_after);
+		reader = heap[--heap_size];
+
+		error = (result_add(result, reader) != EXIT_SUCCESS);
+		if (!error && (reader_next(reader) != EXIT_SUCCESS)) {
+			fprintf(stderr, "Could not read partial-count file %s!\n",
+					reader->fname);
+			error = 1;
+		}
+
+		if (!error && reader->length) {
+			heap[heap_size++] = reader;
+			std::push_heap(heap, heap + heap_size, reader_after);
+		}
+	}
+
+	for (int i = 0; i < number_files; i++) {
+		if (readers[i].inputfd) {
+			fclose(readers[i].inputfd);
+		}
+		free(readers[i].word);
+	}
+	free(readers);
+	free(heap);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void partial_result_free(partial_result *result) {
+	free(result->words);
+	word_arena_free(&result->arena);
+	result->words = NULL;
+	result->different_words = 0;
+	result->capacity = 0;
+}
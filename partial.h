@@ -0,0 +1,71 @@
+/*
+ * partial.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef PARTIAL_H_
+#define PARTIAL_H_
+
+#include <stddef.h>
+#include "ranking.h"
+#include "word_table.h"
+
+/*
+ * A partial-count file holds the counts of the words of a part of the
+ * input, such as a byte range of a file which one of several hosts counts.
+ * It begins with PARTIAL_MAGIC and the flags of the tokenizer mode and
+ * normalizations with which the words were counted, which are followed by
+ * one record per word in ascending byte order of the words, and ends with
+ * a record of length zero.
+ * A record consists of the length of the word, the word, and its count.
+ * Lengths and counts are unsigned LEB128 variable length integers, so
+ * that the frequent short words and small counts take a byte each.
+ */
+#define PARTIAL_MAGIC "WFCPART2"
+
+/*
+ * Flags of a partial-count file.
+ */
+#define PARTIAL_UTF8 1
+#define PARTIAL_FOLD_CASE 2
+#define PARTIAL_TRIM 4
+
+/**
+ * Words merged from partial-count files.
+ * The words are stored in the arena.
+ */
+typedef struct partial_result_t {
+	word_count *words;
+	size_t different_words;
+	size_t capacity;
+	word_arena_block *arena;
+} partial_result;
+
+/**
+ * Sorts the given words by their bytes and writes them along with their
+ * counts and the current tokenizer mode and normalizations to the given
+ * partial-count file.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be written.
+ */
+int partial_write(const char *fname, word_count *words,
+		size_t different_words);
+
+/**
+ * Merges the given partial-count files into result, adding the counts of
+ * equal words.
+ * The files are read in a single streaming pass of a k-way merge, so only
+ * the current record of each file is held in memory besides result.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if a file cannot be read, is not
+ * a partial-count file, was counted with other tokenizer options than the
+ * first file, or a count overflows.
+ */
+int partial_merge(char *const *fnames, int number_files,
+		partial_result *result);
+
+/**
+ * Releases the words of the given result.
+ */
+void partial_result_free(partial_result *result);
+
+#endif /* PARTIAL_H_ */
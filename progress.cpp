@@ -0,0 +1,207 @@
+/*
+ * progress.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "progress.h"
+
+/*
+ * State of the reporter.
+ * The counters are NULL unless the reporter is running.
+ * The parent updates the phase while the reporter reads it, so the
+ * description of the phase is atomic, too.
+ * The reporter is a POSIX thread rather than a std::thread, so that the
+ * process may exit while it runs.
+ */
+static progress_counters *counters = NULL;
+static int max_counters = 0;
+static std::atomic<int> number_counters(0);
+static std::atomic<uint64_t> total(0);
+static std::atomic<uint64_t> phase_start(0);
+static std::atomic<uint64_t> map_start(0);
+static std::atomic<const char *> phase("start");
+static std::atomic<bool> stopping(false);
+static double reporter_interval;
+static pthread_t reporter;
+
+uint64_t progress_clock(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Writes a report of the progress of the mappers to the standard error:
+ * the bytes and tokens so far, the throughput, and the estimated time
+ * until the map phase ends, as well as how far each mapper lags behind
+ * the mapper with the most bytes and how long ago it progressed last.
+ */
+static void report(void) {
+	uint64_t now = progress_clock();
+	uint64_t bytes = 0;
+	uint64_t tokens = 0;
+	uint64_t leader = 0;
+	uint64_t bytes_total = total.load(std::memory_order_relaxed);
+	int mappers = number_counters.load(std::memory_order_relaxed);
+	double elapsed = (now - map_start.load(std::memory_order_relaxed)) / 1e9;
+	double rate;
+
+	for (int i = 0; i < mappers; i++) {
+		uint64_t mapper_bytes = counters[i].bytes.load(
+				std::memory_order_relaxed);
+
+		bytes += mapper_bytes;
+		tokens += counters[i].tokens.load(std::memory_order_relaxed);
+		if (mapper_bytes > leader) {
+			leader = mapper_bytes;
+		}
+	}
+	rate = (elapsed > 0) ? bytes / elapsed : 0;
+
+	fprintf(stderr, "Progress (%s, %.1f s): %.1f MB",
+			phase.load(std::memory_order_relaxed),
+			(now - phase_start.load(std::memory_order_relaxed)) / 1e9,
+			bytes / 1e6);
+	if (bytes_total) {
+		fprintf(stderr, " of %.1f MB (%.1f%%)", bytes_total / 1e6,
+				100.0 * bytes / bytes_total);
+	}
+	fprintf(stderr, ", %.1f MB/s, %llu tokens", rate / 1e6,
+			(unsigned long long) tokens);
+	if (bytes_total && (rate > 0) && (bytes < bytes_total)) {
+		fprintf(stderr, ", ETA %.1f s", (bytes_total - bytes) / rate);
+	}
+	fprintf(stderr, "\n");
+
+	for (int i = 0; i < mappers; i++) {
+		uint64_t mapper_bytes = counters[i].bytes.load(
+				std::memory_order_relaxed);
+		uint64_t updated = counters[i].updated.load(std::memory_order_relaxed);
+
+		fprintf(stderr, "  Mapper %d: %.1f MB, lag %.1f MB", i,
+				mapper_bytes / 1e6, (leader - mapper_bytes) / 1e6);
+		if (updated) {
+			fprintf(stderr, ", last progress %.2f s ago",
+					(now > updated) ? (now - updated) / 1e9 : 0);
+		} else {
+			fprintf(stderr, ", no progress yet");
+		}
+		fprintf(stderr, "\n");
+	}
+}
+
+/**
+ * Entry point of the reporter thread.
+ * Waits for SIGUSR1 or the next interval and reports, until it is stopped.
+ */
+static void *reporter_main(void *arg) {
+	double interval = reporter_interval;
+	sigset_t signals;
+	struct timespec timeout;
+
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGUSR1);
+	timeout.tv_sec = (time_t) interval;
+	timeout.tv_nsec = (long) ((interval - timeout.tv_sec) * 1e9);
+
+	for (;;) {
+		int signal = (interval > 0) ?
+				sigtimedwait(&signals, NULL, &timeout) :
+				sigwaitinfo(&signals, NULL);
+
+		if (stopping.load()) {
+			break;
+		}
+		if ((signal == SIGUSR1) || ((signal < 0) && (errno == EAGAIN))) {
+			report();
+		}
+	}
+
+	return NULL;
+}
+
+int progress_start(int max_mappers, double interval) {
+	sigset_t signals;
+	void *memory = mmap(NULL, max_mappers * sizeof(progress_counters),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (memory == MAP_FAILED) {
+		perror("mmap");
+		return EXIT_FAILURE;
+	}
+
+	/*
+	 * SIGUSR1 stays blocked in all threads and forked children, which
+	 * inherit the mask, so only the reporter takes it.
+	 */
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	// the mapping is zeroed
+	counters = (progress_counters *) memory;
+	max_counters = max_mappers;
+	phase_start.store(progress_clock());
+	map_start.store(progress_clock());
+
+	reporter_interval = interval;
+	if (pthread_create(&reporter, NULL, reporter_main, NULL) != 0) {
+		fprintf(stderr, "Could not create thread!\n");
+		munmap(memory, max_mappers * sizeof(progress_counters));
+		counters = NULL;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void progress_stop(void) {
+	if (!counters) {
+		return;
+	}
+
+	stopping.store(true);
+	pthread_kill(reporter, SIGUSR1);
+	pthread_join(reporter, NULL);
+	munmap(counters, max_counters * sizeof(progress_counters));
+	counters = NULL;
+}
+
+void progress_begin(int number_mappers, uint64_t total_bytes) {
+	if (!counters) {
+		return;
+	}
+
+	if (number_mappers > max_counters) {
+		number_mappers = max_counters;
+	}
+	for (int i = 0; i < number_mappers; i++) {
+		counters[i].bytes.store(0, std::memory_order_relaxed);
+		counters[i].tokens.store(0, std::memory_order_relaxed);
+		counters[i].updated.store(0, std::memory_order_relaxed);
+	}
+	total.store(total_bytes, std::memory_order_relaxed);
+	number_counters.store(number_mappers, std::memory_order_relaxed);
+	map_start.store(progress_clock(), std::memory_order_relaxed);
+	progress_phase("map");
+}
+
+void progress_phase(const char *name) {
+	if (counters) {
+		phase_start.store(progress_clock(), std::memory_order_relaxed);
+		phase.store(name, std::memory_order_relaxed);
+	}
+}
+
+progress_counters *progress_mapper(int mapper) {
+	return (counters && (mapper < max_counters)) ? &counters[mapper] : NULL;
+}
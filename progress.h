@@ -0,0 +1,87 @@
+/*
+ * progress.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef PROGRESS_H_
+#define PROGRESS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * Progress counters of one mapper.
+ * Only the mapper writes them, with relaxed atomic stores after each chunk
+ * or task, and the reporter reads them with relaxed loads, so the mapper
+ * never synchronizes with the reporter.
+ * The time of the last update is in nanoseconds of the monotonic clock.
+ * Counters are padded to a cache line, so that mappers do not contend.
+ */
+typedef struct progress_counters_t {
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> tokens;
+	std::atomic<uint64_t> updated;
+	char padding[64 - 3 * sizeof(std::atomic<uint64_t>)];
+} progress_counters;
+
+/**
+ * Starts the reporter thread for up to the given number of mappers.
+ * The counters of the mappers are kept in shared memory, so that forked
+ * mappers publish their progress, too.
+ * The reporter writes a progress report to the standard error whenever
+ * the process receives SIGUSR1 and, if interval is positive, every
+ * interval seconds.
+ * SIGUSR1 is blocked in the calling thread, so call this function before
+ * any other thread is started.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the reporter cannot be started.
+ */
+int progress_start(int max_mappers, double interval);
+
+/**
+ * Stops the reporter thread.
+ */
+void progress_stop(void);
+
+/**
+ * Resets the counters for a map phase of the given number of mappers over
+ * total_bytes bytes, or an unknown number of bytes if total_bytes is zero.
+ */
+void progress_begin(int number_mappers, uint64_t total_bytes);
+
+/**
+ * Sets the name of the current phase of the run, such as "reduce", which
+ * the reports show.
+ */
+void progress_phase(const char *name);
+
+/**
+ * Returns the counters of the given mapper, or NULL if the reporter is not
+ * running.
+ */
+progress_counters *progress_mapper(int mapper);
+
+/**
+ * Returns the nanoseconds of the monotonic clock.
+ */
+uint64_t progress_clock(void);
+
+/**
+ * Adds the given bytes and tokens to the counters of a mapper, unless they
+ * are NULL.
+ */
+static inline void progress_add(progress_counters *counters, uint64_t bytes,
+		uint64_t tokens) {
+	if (counters) {
+		counters->bytes.store(
+				counters->bytes.load(std::memory_order_relaxed) + bytes,
+				std::memory_order_relaxed);
+		counters->tokens.store(
+				counters->tokens.load(std::memory_order_relaxed) + tokens,
+				std::memory_order_relaxed);
+		counters->updated.store(progress_clock(), std::memory_order_relaxed);
+	}
+}
+
+#endif /* PROGRESS_H_ */
@@ -0,0 +1,328 @@
+/*
+ * ranking.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include "parallel.h"
+#include "ranking.h"
+
+/*
+ * Word frequencies follow Zipf's law, so most words occur only a few times.
+ * rank_words puts the words which occur less than SMALL_COUNTS times into
+ * one bucket per count and first byte, which are already in rank order.
+ * Bucket 0 holds the few frequent words, which are radix sorted by count.
+ */
+#define SMALL_COUNTS 64
+#define NUMBER_BUCKETS (1 + (SMALL_COUNTS - 1) * 256)
+
+/*
+ * Number of words below which rank_words sorts in the calling thread.
+ */
+#define SEQUENTIAL_WORDS 65536
+
+/**
+ * State shared by the threads of rank_words.
+ */
+typedef struct rank_work_t {
+	word_count *words;
+	word_count *sorted;
+	size_t different_words;
+	int no_threads;
+	size_t *offsets;
+	size_t *bucket_starts;
+	std::atomic<size_t> next_bucket;
+} rank_work;
+
+size_t top_k_table(const word_table *table, size_t k, word_count *top) {
+	size_t size = 0;
+
+	if (k == 0) {
+		return 0;
+	}
+
+	/*
+	 * Keep the k most frequent words seen so far in a heap whose front is
+	 * the least frequent of them.
+	 */
+	for (size_t i = 0; i < table->capacity; i++) {
+		const word_table_slot *slot = &table->slots[i];
+		word_count word;
+
+		if (!slot->word) {
+			continue;
+		}
+
+		word.word = slot->word;
+		word.count = slot->count;
+
+		if (size < k) {
+			top[size++] = word;
+			std::push_heap(top, top + size, ranks_before);
+		} else if (ranks_before(word, top[0])) {
+			std::pop_heap(top, top + size, ranks_before);
+			top[size - 1] = word;
+			std::push_heap(top, top + size, ranks_before);
+		}
+	}
+
+	return size;
+}
+
+int top_k_keep(word_table *table, size_t k) {
+	word_count *top = NULL;
+	word_table top_table;
+	size_t size;
+
+	if (k >= table->size) {
+		return EXIT_SUCCESS;
+	}
+
+	top = (word_count *) malloc(sizeof(word_count) * k);
+	if (!top || (word_table_init(&top_table, k) != EXIT_SUCCESS)) {
+		free(top);
+		return EXIT_FAILURE;
+	}
+
+	size = top_k_table(table, k, top);
+	for (size_t i = 0; i < size; i++) {
+		if (word_table_add(&top_table, top[i].word, strlen(top[i].word),
+				top[i].count) != EXIT_SUCCESS) {
+			free(top);
+			word_table_free(&top_table);
+			return EXIT_FAILURE;
+		}
+	}
+
+	free(top);
+	word_table_free(table);
+	*table = top_table;
+
+	return EXIT_SUCCESS;
+}
+
+size_t top_k_words(word_count *words, size_t different_words, size_t k) {
+	if (k >= different_words) {
+		return different_words;
+	}
+
+	std::nth_element(words, words + k, words + different_words, ranks_before);
+
+	return k;
+}
+
+/**
+ * Returns true, iff the first word is lexicographically smaller than the
+ * second word.
+ */
+static bool word_before(const word_count &lhs, const word_count &rhs) {
+	return strcmp(lhs.word, rhs.word) < 0;
+}
+
+/**
+ * Returns the bucket of the given word.
+ * Buckets are numbered in rank order.
+ */
+static inline size_t bucket_of(const word_count &word) {
+	if (word.count >= SMALL_COUNTS) {
+		return 0;
+	}
+
+	return 1 + (size_t) (SMALL_COUNTS - 1 - word.count) * 256
+			+ (unsigned char) word.word[0];
+}
+
+/**
+ * Returns the first word of the part of the words which the given thread
+ * distributes to the buckets.
+ */
+static inline size_t part_start(const rank_work *work, int thread) {
+	return work->different_words * thread / work->no_threads;
+}
+
+/**
+ * Counts the words of the part of the given thread per bucket.
+ */
+static void count_buckets(void *arg, int thread) {
+	rank_work *work = (rank_work *) arg;
+	size_t *offsets = work->offsets + (size_t) thread * NUMBER_BUCKETS;
+	size_t end = part_start(work, thread + 1);
+
+	for (size_t i = part_start(work, thread); i < end; i++) {
+		offsets[bucket_of(work->words[i])]++;
+	}
+}
+
+/**
+ * Moves the words of the part of the given thread to their buckets in
+ * sorted, beginning at the offsets of the thread.
+ */
+static void distribute_buckets(void *arg, int thread) {
+	rank_work *work = (rank_work *) arg;
+	size_t *offsets = work->offsets + (size_t) thread * NUMBER_BUCKETS;
+	size_t end = part_start(work, thread + 1);
+
+	for (size_t i = part_start(work, thread); i < end; i++) {
+		work->sorted[offsets[bucket_of(work->words[i])]++] = work->words[i];
+	}
+}
+
+/**
+ * Returns the radix key of the given count, which orders counts descending.
+ */
+static inline uint64_t count_key(uint64_t count) {
+	return UINT64_MAX - count;
+}
+
+/**
+ * Sorts the given words by count in descending order with a least
+ * significant digit radix sort of eight bit digits.
+ * Digits which all words share are skipped.
+ * buffer must hold length words.
+ * Returns the array which holds the sorted words, i.e. words or buffer.
+ */
+static word_count *radix_sort_counts(word_count *words, word_count *buffer,
+		size_t length) {
+	for (int shift = 0; shift < 64; shift += 8) {
+		size_t offsets[256] = { 0 };
+		size_t offset = 0;
+
+		for (size_t i = 0; i < length; i++) {
+			offsets[(count_key(words[i].count) >> shift) & 0xff]++;
+		}
+		if (offsets[(count_key(words[0].count) >> shift) & 0xff] == length) {
+			continue;
+		}
+
+		for (int digit = 0; digit < 256; digit++) {
+			size_t number = offsets[digit];
+
+			offsets[digit] = offset;
+			offset += number;
+		}
+		for (size_t i = 0; i < length; i++) {
+			buffer[offsets[(count_key(words[i].count) >> shift) & 0xff]++] =
+					words[i];
+		}
+
+		std::swap(words, buffer);
+	}
+
+	return words;
+}
+
+/**
+ * Sorts the given bucket of sorted and stores it in words.
+ * The words of a bucket which holds less than SMALL_COUNTS occurrences
+ * share their count, so only their words need to be sorted.
+ */
+static void sort_bucket(rank_work *work, size_t bucket) {
+	size_t start = work->bucket_starts[bucket];
+	size_t length = work->bucket_starts[bucket + 1] - start;
+	word_count *bucket_words = work->sorted + start;
+
+	if (length == 0) {
+		return;
+	}
+
+	if (bucket == 0) {
+		// words is free by now, so use it as the buffer of the radix sort
+		bucket_words = radix_sort_counts(bucket_words, work->words + start,
+				length);
+
+		// sort words of equal count
+		for (size_t i = 0; i < length;) {
+			size_t j = i + 1;
+
+			while ((j < length)
+					&& (bucket_words[j].count == bucket_words[i].count)) {
+				j++;
+			}
+			std::sort(bucket_words + i, bucket_words + j, word_before);
+			i = j;
+		}
+	} else {
+		std::sort(bucket_words, bucket_words + length, word_before);
+	}
+
+	if (bucket_words != work->words + start) {
+		memcpy(work->words + start, bucket_words, length * sizeof(word_count));
+	}
+}
+
+/**
+ * Sorts the buckets which the given thread takes until none is left.
+ */
+static void sort_buckets(void *arg, int thread) {
+	rank_work *work = (rank_work *) arg;
+	size_t bucket;
+
+	(void) thread;
+	while ((bucket = work->next_bucket.fetch_add(1, std::memory_order_relaxed))
+			< NUMBER_BUCKETS) {
+		sort_bucket(work, bucket);
+	}
+}
+
+int rank_words(word_count *words, size_t different_words, int no_threads) {
+	rank_work work;
+	size_t offset = 0;
+
+	if (no_threads < 1) {
+		no_threads = 1;
+	}
+	if (different_words < SEQUENTIAL_WORDS) {
+		std::sort(words, words + different_words, ranks_before);
+		return EXIT_SUCCESS;
+	}
+
+	work.words = words;
+	work.different_words = different_words;
+	work.no_threads = no_threads;
+	work.sorted = (word_count *) malloc(sizeof(word_count) * different_words);
+	work.offsets = (size_t *) calloc((size_t) no_threads * NUMBER_BUCKETS,
+			sizeof(size_t));
+	work.bucket_starts = (size_t *) malloc(
+			sizeof(size_t) * (NUMBER_BUCKETS + 1));
+	work.next_bucket = 0;
+
+	if (!work.sorted || !work.offsets || !work.bucket_starts) {
+		free(work.sorted);
+		free(work.offsets);
+		free(work.bucket_starts);
+		return EXIT_FAILURE;
+	}
+
+	run_parallel(no_threads, count_buckets, &work);
+
+	/*
+	 * Each thread moves its words of a bucket behind those of the threads
+	 * before it, so that the distribution is stable.
+	 */
+	for (size_t bucket = 0; bucket < NUMBER_BUCKETS; bucket++) {
+		work.bucket_starts[bucket] = offset;
+		for (int thread = 0; thread < no_threads; thread++) {
+			size_t *count = &work.offsets[(size_t) thread * NUMBER_BUCKETS
+					+ bucket];
+			size_t number = *count;
+
+			*count = offset;
+			offset += number;
+		}
+	}
+	work.bucket_starts[NUMBER_BUCKETS] = offset;
+
+	run_parallel(no_threads, distribute_buckets, &work);
+	run_parallel(no_threads, sort_buckets, &work);
+
+	free(work.sorted);
+	free(work.offsets);
+	free(work.bucket_starts);
+
+	return EXIT_SUCCESS;
+}
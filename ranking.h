@@ -0,0 +1,69 @@
+/*
+ * ranking.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef RANKING_H_
+#define RANKING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "word_table.h"
+
+/**
+ * Pair of word and its frequency.
+ */
+typedef struct word_count_t {
+	uint64_t count;
+	const char *word;
+} word_count;
+
+/**
+ * Returns true, iff the first word ranks before the second word in the
+ * output, i.e. it is more frequent, or equally frequent and
+ * lexicographically smaller.
+ * Distinct words never tie, so the output order is deterministic.
+ */
+static inline bool ranks_before(const word_count &lhs, const word_count &rhs) {
+	if (lhs.count != rhs.count) {
+		return lhs.count > rhs.count;
+	}
+
+	return strcmp(lhs.word, rhs.word) < 0;
+}
+
+/**
+ * Selects the k most frequent words of the given table with a bounded heap
+ * in O(n log k) and stores them in top, which must hold k words.
+ * The words in top are not sorted.
+ * Returns the number of words stored, which is less than k if the table
+ * holds less words.
+ */
+size_t top_k_table(const word_table *table, size_t k, word_count *top);
+
+/**
+ * Removes all but the k most frequent words from the given table.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int top_k_keep(word_table *table, size_t k);
+
+/**
+ * Moves the k most frequent of the given words to the front of the array
+ * in O(n).
+ * The moved words are not sorted.
+ * Returns the number of words moved, which is less than k if there are
+ * less words.
+ */
+size_t top_k_words(word_count *words, size_t different_words, size_t k);
+
+/**
+ * Sorts the given words by rank (see ranks_before) with up to no_threads
+ * threads.
+ * Counts must be positive.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int rank_words(word_count *words, size_t different_words, int no_threads);
+
+#endif /* RANKING_H_ */
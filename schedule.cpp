@@ -0,0 +1,128 @@
+/*
+ * schedule.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <new>
+#include "schedule.h"
+
+/**
+ * Returns the number of bytes of the queue before its deques.
+ */
+static inline size_t header_size(void) {
+	return (sizeof(chunk_queue) + sizeof(work_deque) - 1)
+			& ~(sizeof(work_deque) - 1);
+}
+
+static inline uint64_t pack(uint64_t front, uint64_t back) {
+	return (back << 32) | front;
+}
+
+static inline uint32_t front_of(uint64_t chunks) {
+	return (uint32_t) chunks;
+}
+
+static inline uint32_t back_of(uint64_t chunks) {
+	return (uint32_t) (chunks >> 32);
+}
+
+size_t chunk_queue_size(int number_workers) {
+	return header_size() + number_workers * sizeof(work_deque);
+}
+
+chunk_queue *chunk_queue_init(void *memory, size_t start, size_t end,
+		size_t chunk_size, int number_workers) {
+	chunk_queue *queue = new (memory) chunk_queue;
+	size_t length = end - start;
+	size_t number_chunks;
+
+	if (chunk_size == 0) {
+		chunk_size = length / ((size_t) number_workers * CHUNKS_PER_WORKER);
+		if (chunk_size < MIN_SCHEDULE_CHUNK_SIZE) {
+			chunk_size = MIN_SCHEDULE_CHUNK_SIZE;
+		} else if (chunk_size > MAX_SCHEDULE_CHUNK_SIZE) {
+			chunk_size = MAX_SCHEDULE_CHUNK_SIZE;
+		}
+	}
+
+	// chunk indices must fit into 32 bits
+	if (length / chunk_size >= UINT32_MAX) {
+		chunk_size = length / (UINT32_MAX - 1) + 1;
+	}
+	number_chunks = (length + chunk_size - 1) / chunk_size;
+
+	queue->start = start;
+	queue->end = end;
+	queue->chunk_size = chunk_size;
+	queue->number_workers = number_workers;
+	queue->deques = (work_deque *) ((char *) memory + header_size());
+
+	// each worker begins with an equal share of consecutive chunks
+	for (int i = 0; i < number_workers; i++) {
+		work_deque *deque = new (&queue->deques[i]) work_deque;
+
+		deque->chunks.store(pack(number_chunks * i / number_workers,
+				number_chunks * (i + 1) / number_workers));
+	}
+
+	return queue;
+}
+
+/**
+ * Moves the back half of the deque of another worker to the empty deque of
+ * the given worker.
+ * Returns false, iff the deques of all other workers were found empty.
+ * Chunks which a concurrent thief moves to its own deque may be missed, but
+ * that thief counts them.
+ */
+static bool steal(chunk_queue *queue, int thief) {
+	for (int i = 1; i < queue->number_workers; i++) {
+		work_deque *victim = &queue->deques[(thief + i)
+				% queue->number_workers];
+		uint64_t chunks = victim->chunks.load(std::memory_order_acquire);
+
+		while (front_of(chunks) < back_of(chunks)) {
+			uint32_t front = front_of(chunks);
+			uint32_t back = back_of(chunks);
+			uint32_t middle = back - (back - front + 1) / 2;
+
+			if (victim->chunks.compare_exchange_weak(chunks,
+					pack(front, middle), std::memory_order_acq_rel)) {
+				queue->deques[thief].chunks.store(pack(middle, back),
+						std::memory_order_release);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool chunk_queue_next(chunk_queue *queue, int worker, size_t *chunk_start,
+		size_t *chunk_end) {
+	work_deque *deque = &queue->deques[worker];
+
+	for (;;) {
+		uint64_t chunks = deque->chunks.load(std::memory_order_acquire);
+
+		while (front_of(chunks) < back_of(chunks)) {
+			uint32_t front = front_of(chunks);
+
+			if (deque->chunks.compare_exchange_weak(chunks,
+					pack(front + 1, back_of(chunks)),
+					std::memory_order_acq_rel)) {
+				*chunk_start = queue->start + front * queue->chunk_size;
+				*chunk_end = *chunk_start + queue->chunk_size;
+				if (*chunk_end > queue->end) {
+					*chunk_end = queue->end;
+				}
+				return true;
+			}
+		}
+
+		if (!steal(queue, worker)) {
+			return false;
+		}
+	}
+}
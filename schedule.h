@@ -0,0 +1,78 @@
+/*
+ * schedule.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef SCHEDULE_H_
+#define SCHEDULE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Bounds of the size of the chunks which chunk_queue_init chooses.
+ * Small chunks balance the load better, but each costs a claim.
+ */
+#define MIN_SCHEDULE_CHUNK_SIZE (64 * 1024)
+#define MAX_SCHEDULE_CHUNK_SIZE (4 * 1024 * 1024)
+
+/*
+ * Number of chunks per worker which chunk_queue_init aims for.
+ */
+#define CHUNKS_PER_WORKER 64
+
+/**
+ * Deque of consecutive chunks of a worker.
+ * The index of its first chunk (low 32 bits) and the index after its last
+ * chunk (high 32 bits) are packed into one lock-free atomic, so that the
+ * owner and thieves claim chunks with a single compare-and-swap, which
+ * works in shared memory across processes, too.
+ * Deques are padded to a cache line, so that workers do not contend.
+ */
+typedef struct work_deque_t {
+	std::atomic<uint64_t> chunks;
+	char padding[64 - sizeof(std::atomic<uint64_t>)];
+} work_deque;
+
+/**
+ * Byte range of the input, which is split into chunks for workers.
+ * Each worker owns a deque of consecutive chunks, which it takes from the
+ * front, so that it reads its part of the input sequentially.
+ * A worker whose deque is empty steals the back half of the deque of
+ * another worker, so that no worker idles while chunks are left.
+ * The queue is followed by the deques of its workers.
+ */
+typedef struct chunk_queue_t {
+	size_t start;
+	size_t end;
+	size_t chunk_size;
+	int number_workers;
+	work_deque *deques;
+} chunk_queue;
+
+/**
+ * Returns the number of bytes chunk_queue_init needs for the given number
+ * of workers.
+ */
+size_t chunk_queue_size(int number_workers);
+
+/**
+ * Initializes a queue in memory of chunk_queue_size bytes, which splits the
+ * byte range [start, end) into chunks of chunk_size bytes, or of a size
+ * chosen for the number of workers if chunk_size is zero.
+ * Returns the queue.
+ */
+chunk_queue *chunk_queue_init(void *memory, size_t start, size_t end,
+		size_t chunk_size, int number_workers);
+
+/**
+ * Claims the next chunk for the given worker and stores its byte range in
+ * chunk_start and chunk_end.
+ * Returns false, iff no chunk is left.
+ */
+bool chunk_queue_next(chunk_queue *queue, int worker, size_t *chunk_start,
+		size_t *chunk_end);
+
+#endif /* SCHEDULE_H_ */
@@ -0,0 +1,940 @@
+/*
+ * serve.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "counter.h"
+#include "input.h"
+#include "output.h"
+#include "ranking.h"
+#include "schedule.h"
+#include "serve.h"
+#include "topology.h"
+#include "word_table.h"
+
+/*
+ * Bytes of input per worker, below which a request is counted by fewer
+ * workers, so that small requests do not wake the whole pool.
+ */
+#define BYTES_PER_WORKER (256 * 1024)
+
+/*
+ * Words which the tables of a worker take initially.
+ */
+#define INITIAL_WORDS 4096
+
+/*
+ * Slots above which the table of a worker is shrunk after a request, so
+ * that a large request does not make clearing the tables of all later
+ * requests expensive.
+ */
+#define MAX_KEPT_SLOTS (1024 * 1024)
+
+/*
+ * Maximum length of a request line.
+ */
+#define MAX_LINE_LENGTH 4096
+
+#define SOCKET_BACKLOG 16
+
+/*
+ * Connections which are served at the same time.
+ * Each one has a thread and may hold the data of a request.
+ */
+#define MAX_CONNECTIONS 64
+
+/*
+ * Seconds after which a client which neither sends nor receives is
+ * dropped, so that it does not hold a connection forever.
+ */
+#define CLIENT_TIMEOUT 60
+
+/*
+ * Maximum number of bytes of a DATA request.
+ */
+#define MAX_DATA_LENGTH ((size_t) 1 << 30)
+
+/*
+ * Maximum number of bytes of the data buffers of all connections, so that
+ * MAX_CONNECTIONS clients cannot make the server hold MAX_DATA_LENGTH
+ * bytes each.
+ */
+#define MAX_SERVER_DATA (4 * MAX_DATA_LENGTH)
+
+/*
+ * Bytes above which the data buffer of a connection is freed after a
+ * request, so that an idle connection does not hold the data of a large
+ * request.
+ */
+#define MAX_KEPT_DATA (16 * 1024 * 1024)
+
+/**
+ * Phase of a request, which the workers of the pool execute.
+ */
+typedef enum pool_phase_t {
+	PHASE_MAP,
+	PHASE_REDUCE
+} pool_phase;
+
+/**
+ * Tables and buffers of a worker, which outlive the requests.
+ */
+typedef struct pool_worker_t {
+	word_table map_table;
+	word_table reduce_table;
+	char *buffer;
+	size_t buffer_capacity;
+	int status;
+} pool_worker;
+
+/**
+ * Worker pool and the state of the current request.
+ * The server starts a phase by incrementing the generation, and each
+ * worker decrements pending when it has finished the phase.
+ * Only the first job_workers workers take part in a request.
+ */
+typedef struct worker_pool_t {
+	int no_workers;
+	pool_worker *workers;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable start;
+	std::condition_variable done;
+	uint64_t generation;
+	int pending;
+	bool stopping;
+	pool_phase phase;
+	input_data input;
+	int job_workers;
+	chunk_queue *chunks;
+	word_count *words;
+	size_t words_capacity;
+} worker_pool;
+
+/**
+ * Pool and connections of a server.
+ * Each connection is served by its own thread, which reads the requests
+ * of the client and counts them with the pool, one request at a time, so
+ * that a slow or idle client does not hold up the others.
+ * job_mutex is held while a request is counted and its response is
+ * formatted, mutex guards the file descriptors of the open connections,
+ * the bytes of their data buffers, and quit.
+ */
+typedef struct server_t {
+	worker_pool pool;
+	int listenfd;
+	std::mutex job_mutex;
+	std::mutex mutex;
+	std::condition_variable closed;
+	std::vector<int> connections;
+	size_t data_bytes;
+	bool quit;
+} server;
+
+/**
+ * Buffered reader of the requests of a connection and the data of its
+ * DATA requests.
+ */
+typedef struct connection_t {
+	int fd;
+	char buffer[MAX_LINE_LENGTH];
+	size_t start;
+	size_t end;
+	char *data;
+	size_t data_capacity;
+} connection;
+
+/**
+ * Grows the given buffer to hold at least length bytes.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int reserve(char **buffer, size_t *capacity, size_t length) {
+	char *larger;
+
+	if (*capacity >= length) {
+		return EXIT_SUCCESS;
+	}
+
+	length = std::max(length, 2 * *capacity);
+	larger = (char *) realloc(*buffer, length);
+	if (!larger) {
+		return EXIT_FAILURE;
+	}
+	*buffer = larger;
+	*capacity = length;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Empties the given table for the next request.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int reset_table(word_table *table) {
+	if (table->capacity <= MAX_KEPT_SLOTS) {
+		word_table_clear(table);
+		return EXIT_SUCCESS;
+	}
+
+	word_table_free(table);
+	return word_table_init(table, INITIAL_WORDS);
+}
+
+/**
+ * Map step of a worker.
+ * The worker counts the chunks it claims or steals in its map table and,
+ * unless it is the only worker of the request, serializes the table
+ * partitioned by hash.
+ */
+static int map_worker(worker_pool *pool, int worker) {
+	pool_worker *w = &pool->workers[worker];
+	size_t chunk_start, chunk_end;
+	size_t length;
+
+	if (reset_table(&w->map_table) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	while (chunk_queue_next(pool->chunks, worker, &chunk_start, &chunk_end)) {
+		if (count_range(tokenizer_default(), &pool->input, chunk_start,
+				chunk_end, &w->map_table, NULL) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (pool->job_workers == 1) {
+		return EXIT_SUCCESS;
+	}
+
+	length = word_table_serialized_length(&w->map_table, pool->job_workers);
+	if (reserve(&w->buffer, &w->buffer_capacity, length) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+	word_table_serialize(&w->map_table, w->buffer, pool->job_workers);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Reduce step of a worker.
+ * The worker merges the partition with its number of all mappers.
+ */
+static int reduce_worker(worker_pool *pool, int worker) {
+	pool_worker *w = &pool->workers[worker];
+
+	if (reset_table(&w->reduce_table) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < pool->job_workers; i++) {
+		if (word_table_merge_serialized(&w->reduce_table,
+				pool->workers[i].buffer, worker) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Entry point of a thread of the pool, which executes the phases of the
+ * requests until the pool stops.
+ */
+static void pool_main(worker_pool *pool, int worker) {
+	uint64_t generation = 0;
+
+	topology_pin(worker);
+
+	for (;;) {
+		pool_phase phase;
+
+		{
+			std::unique_lock<std::mutex> lock(pool->mutex);
+
+			while (!pool->stopping && (pool->generation == generation)) {
+				pool->start.wait(lock);
+			}
+			if (pool->stopping) {
+				return;
+			}
+			generation = pool->generation;
+			phase = pool->phase;
+		}
+
+		if (worker >= pool->job_workers) {
+			continue;
+		}
+		pool->workers[worker].status = (phase == PHASE_MAP) ?
+				map_worker(pool, worker) : reduce_worker(pool, worker);
+
+		{
+			std::lock_guard<std::mutex> lock(pool->mutex);
+
+			if (--pool->pending == 0) {
+				pool->done.notify_one();
+			}
+		}
+	}
+}
+
+/**
+ * Executes the given phase with the workers of the current request and
+ * waits for them to finish.
+ * A request of a single worker is mapped by the calling thread, which
+ * saves waking a worker.
+ * Returns EXIT_SUCCESS, iff all workers finished the phase successfully.
+ */
+static int run_phase(worker_pool *pool, pool_phase phase) {
+	if ((pool->job_workers == 1) && (phase == PHASE_MAP)) {
+		return map_worker(pool, 0);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(pool->mutex);
+
+		pool->phase = phase;
+		pool->pending = pool->job_workers;
+		pool->generation++;
+		pool->start.notify_all();
+		while (pool->pending > 0) {
+			pool->done.wait(lock);
+		}
+	}
+
+	for (int i = 0; i < pool->job_workers; i++) {
+		if (pool->workers[i].status != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Stops the threads of the pool and frees its tables and buffers.
+ */
+static void pool_free(worker_pool *pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+
+		pool->stopping = true;
+		pool->start.notify_all();
+	}
+	for (std::thread &thread : pool->threads) {
+		thread.join();
+	}
+
+	for (int i = 0; i < pool->no_workers; i++) {
+		word_table_free(&pool->workers[i].map_table);
+		word_table_free(&pool->workers[i].reduce_table);
+		free(pool->workers[i].buffer);
+	}
+	free(pool->workers);
+	free(pool->chunks);
+	free(pool->words);
+}
+
+/**
+ * Allocates the tables of the workers and starts the threads of the pool.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory or
+ * a thread cannot be created.
+ */
+static int pool_init(worker_pool *pool, int no_workers) {
+	int error = 0;
+
+	pool->no_workers = no_workers;
+	pool->generation = 0;
+	pool->pending = 0;
+	pool->stopping = false;
+	pool->job_workers = 0;
+	pool->words = NULL;
+	pool->words_capacity = 0;
+	pool->workers = (pool_worker *) calloc(no_workers, sizeof(pool_worker));
+	pool->chunks = (chunk_queue *) aligned_alloc(sizeof(work_deque),
+			chunk_queue_size(no_workers));
+
+	if (!pool->workers || !pool->chunks) {
+		fprintf(stderr, "Not enough memory!\n");
+		free(pool->workers);
+		free(pool->chunks);
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; (i < no_workers) && !error; i++) {
+		error = (word_table_init(&pool->workers[i].map_table, INITIAL_WORDS)
+				!= EXIT_SUCCESS)
+				|| (word_table_init(&pool->workers[i].reduce_table,
+						INITIAL_WORDS) != EXIT_SUCCESS);
+	}
+	if (error) {
+		fprintf(stderr, "Not enough memory!\n");
+	}
+
+	try {
+		for (int i = 0; (i < no_workers) && !error; i++) {
+			pool->threads.push_back(std::thread(pool_main, pool, i));
+		}
+	} catch (const std::system_error &e) {
+		fprintf(stderr, "Could not create thread: %s\n", e.what());
+		error = 1;
+	}
+
+	if (error) {
+		pool_free(pool);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the table which holds the words of the given partition after
+ * the current request was counted.
+ */
+static inline const word_table *result_table(const worker_pool *pool,
+		int partition) {
+	// a single mapper holds all words already
+	return (pool->job_workers == 1) ?
+			&pool->workers[partition].map_table :
+			&pool->workers[partition].reduce_table;
+}
+
+/**
+ * Counts the words of the input of the pool with the pool.
+ * Stores the ranked words, or the top_k most frequent ones if top_k is
+ * not zero, in the words of the pool and their number in different_words.
+ * The words stay valid until the next request.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int count_request(worker_pool *pool, size_t top_k,
+		size_t *different_words) {
+	size_t length = pool->input.length;
+	size_t capacity = 0;
+	size_t number_words = 0;
+
+	pool->job_workers = (int) std::min((size_t) pool->no_workers,
+			length / BYTES_PER_WORKER + 1);
+	chunk_queue_init(pool->chunks, 0, length, 0, pool->job_workers);
+
+	if ((run_phase(pool, PHASE_MAP) != EXIT_SUCCESS)
+			|| ((pool->job_workers > 1)
+					&& (run_phase(pool, PHASE_REDUCE) != EXIT_SUCCESS))) {
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < pool->job_workers; i++) {
+		size_t size = result_table(pool, i)->size;
+
+		capacity += top_k ? std::min(top_k, size) : size;
+	}
+
+	if (pool->words_capacity < capacity + 1) {
+		word_count *larger = (word_count *) realloc(pool->words,
+				sizeof(word_count) * (capacity + 1));
+
+		if (!larger) {
+			return EXIT_FAILURE;
+		}
+		pool->words = larger;
+		pool->words_capacity = capacity + 1;
+	}
+
+	for (int i = 0; i < pool->job_workers; i++) {
+		const word_table *table = result_table(pool, i);
+
+		if (top_k) {
+			number_words += top_k_table(table, top_k,
+					pool->words + number_words);
+			continue;
+		}
+		for (size_t j = 0; j < table->capacity; j++) {
+			if (table->slots[j].word) {
+				pool->words[number_words].word = table->slots[j].word;
+				pool->words[number_words].count = table->slots[j].count;
+				number_words++;
+			}
+		}
+	}
+
+	if (top_k) {
+		number_words = top_k_words(pool->words, number_words, top_k);
+	}
+	if (rank_words(pool->words, number_words, pool->job_workers)
+			!= EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	*different_words = number_words;
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Writes the given bytes to the given socket.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the client went away.
+ */
+static int send_fully(int fd, const char *data, size_t length) {
+	while (length > 0) {
+		ssize_t sent = write(fd, data, length);
+
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return EXIT_FAILURE;
+		}
+		data += sent;
+		length -= sent;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Sends an error response with the given message.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the client went away.
+ */
+static int send_error(int fd, const char *message) {
+	char line[MAX_LINE_LENGTH];
+	int length = snprintf(line, sizeof(line), "ERROR %s\n", message);
+
+	return send_fully(fd, line, std::min((size_t) length, sizeof(line) - 1));
+}
+
+/**
+ * Reads the next line of the connection without its newline into line,
+ * which holds MAX_LINE_LENGTH bytes.
+ * Returns the length of the line, or -1 if the connection ended or the
+ * line is too long.
+ */
+static ssize_t read_line(connection *c, char *line) {
+	for (;;) {
+		char *newline = (char *) memchr(c->buffer + c->start, '\n',
+				c->end - c->start);
+		ssize_t received;
+
+		if (newline) {
+			size_t length = newline - (c->buffer + c->start);
+
+			memcpy(line, c->buffer + c->start, length);
+			line[length] = 0;
+			c->start += length + 1;
+			return length;
+		}
+
+		// move the partial line to the front to make room
+		memmove(c->buffer, c->buffer + c->start, c->end - c->start);
+		c->end -= c->start;
+		c->start = 0;
+		if (c->end == sizeof(c->buffer)) {
+			return -1;
+		}
+
+		received = read(c->fd, c->buffer + c->end, sizeof(c->buffer) - c->end);
+		if ((received < 0) && (errno == EINTR)) {
+			continue;
+		}
+		if (received <= 0) {
+			return -1;
+		}
+		c->end += received;
+	}
+}
+
+/**
+ * Reads length bytes of the connection into data.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the connection ended.
+ */
+static int read_data(connection *c, char *data, size_t length) {
+	size_t buffered = std::min(length, c->end - c->start);
+
+	memcpy(data, c->buffer + c->start, buffered);
+	c->start += buffered;
+	data += buffered;
+	length -= buffered;
+
+	while (length > 0) {
+		ssize_t received = read(c->fd, data, length);
+
+		if ((received < 0) && (errno == EINTR)) {
+			continue;
+		}
+		if (received <= 0) {
+			return EXIT_FAILURE;
+		}
+		data += received;
+		length -= received;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Counts the given input with the pool, while no other connection uses
+ * the pool, and sends the ranking to the client.
+ * The ranking is formatted into a buffer, which is sent after the pool is
+ * released, so that a client which reads slowly does not hold up the
+ * others.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the client went away.
+ */
+static int respond_locked(server *srv, int fd, const input_data *input,
+		size_t top_k) {
+	char line[64];
+	size_t different_words;
+	char *lines = NULL;
+	size_t length;
+	int status;
+
+	{
+		std::lock_guard<std::mutex> lock(srv->job_mutex);
+
+		srv->pool.input = *input;
+		status = count_request(&srv->pool, top_k, &different_words);
+		if (status == EXIT_SUCCESS) {
+			status = output_format(srv->pool.words, different_words,
+					srv->pool.job_workers, &lines, &length);
+		}
+	}
+
+	if (status != EXIT_SUCCESS) {
+		return send_error(fd, "Not enough memory");
+	}
+
+	status = send_fully(fd, line,
+			snprintf(line, sizeof(line), "OK %zu\n", different_words));
+	if (status == EXIT_SUCCESS) {
+		status = send_fully(fd, lines, length);
+	}
+	free(lines);
+
+	return status;
+}
+
+/**
+ * Grows the data buffer of the given connection to hold length bytes,
+ * unless the data buffers of all connections would exceed MAX_SERVER_DATA.
+ * Returns EXIT_SUCCESS, or sends an error to the client and returns
+ * EXIT_FAILURE if the server holds too much data or there is not enough
+ * memory.
+ */
+static int reserve_data(server *srv, connection *c, size_t length) {
+	size_t growth = (length > c->data_capacity) ? length - c->data_capacity : 0;
+	char *larger;
+
+	if (!growth) {
+		return EXIT_SUCCESS;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(srv->mutex);
+
+		if (srv->data_bytes + growth > MAX_SERVER_DATA) {
+			send_error(c->fd, "Too much data pending");
+			return EXIT_FAILURE;
+		}
+		srv->data_bytes += growth;
+	}
+
+	larger = (char *) realloc(c->data, length);
+	if (!larger) {
+		std::lock_guard<std::mutex> lock(srv->mutex);
+
+		srv->data_bytes -= growth;
+		send_error(c->fd, "Not enough memory");
+		return EXIT_FAILURE;
+	}
+	c->data = larger;
+	c->data_capacity = length;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Frees the data buffer of the given connection.
+ */
+static void release_data(server *srv, connection *c) {
+	std::lock_guard<std::mutex> lock(srv->mutex);
+
+	srv->data_bytes -= c->data_capacity;
+	free(c->data);
+	c->data = NULL;
+	c->data_capacity = 0;
+}
+
+/**
+ * Serves the requests of the given connection until it ends.
+ * Returns true, iff the client asked the server to stop.
+ */
+static bool serve_requests(server *srv, connection *c) {
+	char line[MAX_LINE_LENGTH];
+	int fd = c->fd;
+
+	while (read_line(c, line) >= 0) {
+		char request[8];
+		unsigned long long top_k;
+		int number = 0;
+		int argument = 0;
+		int status;
+
+		if (strcmp(line, SERVE_REQUEST_QUIT) == 0) {
+			send_fully(fd, "OK 0\n", 5);
+			return true;
+		}
+
+		// strtoull and sscanf take "-1" as a huge number
+		if ((sscanf(line, "%4s %n%llu %n", request, &number, &top_k,
+				&argument) < 2) || !isdigit((unsigned char) line[number])) {
+			argument = 0;
+		}
+
+		if (argument && (strcmp(request, SERVE_REQUEST_FILE) == 0)) {
+			input_data input;
+
+			if (input_open(line + argument, &input) != EXIT_SUCCESS) {
+				status = send_error(fd, "Could not read input file");
+			} else {
+				status = respond_locked(srv, fd, &input, top_k);
+				input_close(&input);
+			}
+		} else if (argument && (strcmp(request, SERVE_REQUEST_DATA) == 0)) {
+			const char *digits = line + argument;
+			char *end;
+			size_t length = strtoull(digits, &end, 10);
+			input_data input;
+
+			// the data cannot be skipped, so the connection ends on errors
+			if (!isdigit((unsigned char) *digits) || *end) {
+				status = send_error(fd, "Invalid length");
+			} else if (length > MAX_DATA_LENGTH) {
+				send_error(fd, "Data too long");
+				return false;
+			} else if (reserve_data(srv, c, length) != EXIT_SUCCESS) {
+				return false;
+			} else if (read_data(c, c->data, length) != EXIT_SUCCESS) {
+				return false;
+			} else {
+				input.data = c->data;
+				input.length = length;
+				input.mapped = 0;
+				status = respond_locked(srv, fd, &input, top_k);
+			}
+
+			if (c->data_capacity > MAX_KEPT_DATA) {
+				release_data(srv, c);
+			}
+		} else {
+			status = send_error(fd, "Invalid request");
+		}
+
+		if (status != EXIT_SUCCESS) {
+			return false;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Stops the server: no further connections are accepted, and the open
+ * connections end after their current request.
+ * The caller holds the mutex of the server.
+ */
+static void stop_server(server *srv) {
+	srv->quit = true;
+	// wakes the accept of the server
+	shutdown(srv->listenfd, SHUT_RDWR);
+	for (int fd : srv->connections) {
+		shutdown(fd, SHUT_RD);
+	}
+}
+
+/**
+ * Entry point of the thread of a connection, which serves its requests
+ * and closes it.
+ */
+static void connection_main(server *srv, int fd) {
+	connection *c = (connection *) malloc(sizeof(connection));
+	bool quit = false;
+
+	if (c) {
+		c->fd = fd;
+		c->start = 0;
+		c->end = 0;
+		c->data = NULL;
+		c->data_capacity = 0;
+		quit = serve_requests(srv, c);
+		release_data(srv, c);
+		free(c);
+	} else {
+		send_error(fd, "Not enough memory");
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(srv->mutex);
+
+		srv->connections.erase(std::find(srv->connections.begin(),
+				srv->connections.end(), fd));
+		close(fd);
+		if (quit && !srv->quit) {
+			stop_server(srv);
+		}
+		srv->closed.notify_one();
+	}
+}
+
+/**
+ * Starts a thread which serves the given connection, unless the server
+ * serves MAX_CONNECTIONS already or stops.
+ */
+static void open_connection(server *srv, int fd) {
+	struct timeval timeout;
+	std::lock_guard<std::mutex> lock(srv->mutex);
+
+	if (srv->quit || (srv->connections.size() >= MAX_CONNECTIONS)) {
+		send_error(fd, "Too many connections");
+		close(fd);
+		return;
+	}
+
+	// a stalled client is dropped instead of holding its thread
+	timeout.tv_sec = CLIENT_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	try {
+		std::thread(connection_main, srv, fd).detach();
+	} catch (const std::system_error &e) {
+		fprintf(stderr, "Could not create thread: %s\n", e.what());
+		send_error(fd, "Could not create thread");
+		close(fd);
+		return;
+	}
+	srv->connections.push_back(fd);
+}
+
+int serve(const char *socketfname, int no_workers) {
+	server srv;
+	struct sockaddr_un address;
+	struct stat st;
+	bool failed = false;
+
+	if (strlen(socketfname) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Socket path is too long!\n");
+		return EXIT_FAILURE;
+	}
+
+	// a client which goes away must not terminate the server
+	signal(SIGPIPE, SIG_IGN);
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketfname);
+
+	/*
+	 * Replace the socket of a previous server, but only if nobody listens
+	 * on it anymore, so that a running server keeps its socket.
+	 */
+	if ((stat(socketfname, &st) == 0) && S_ISSOCK(st.st_mode)) {
+		int probefd = socket(AF_UNIX, SOCK_STREAM, 0);
+		int status = (probefd < 0) ? -1 : connect(probefd,
+				(struct sockaddr *) &address, sizeof(address));
+		int probe_errno = errno;
+
+		if (probefd >= 0) {
+			close(probefd);
+		}
+		if (status == 0) {
+			fprintf(stderr, "Another server is serving on %s already!\n",
+					socketfname);
+			return EXIT_FAILURE;
+		}
+		if (probe_errno == ECONNREFUSED) {
+			unlink(socketfname);
+		}
+	}
+
+	/*
+	 * Clients can stop the server and have it read any file it can read,
+	 * so only the user of the server may connect.
+	 * Connections are refused until listen, so the socket is private from
+	 * the start.
+	 */
+	srv.listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	srv.data_bytes = 0;
+	srv.quit = false;
+	if ((srv.listenfd < 0)
+			|| (bind(srv.listenfd, (struct sockaddr *) &address,
+					sizeof(address)) != 0)
+			|| (chmod(socketfname, S_IRUSR | S_IWUSR) != 0)
+			|| (listen(srv.listenfd, SOCKET_BACKLOG) != 0)) {
+		perror("socket");
+		if (srv.listenfd >= 0) {
+			close(srv.listenfd);
+		}
+		return EXIT_FAILURE;
+	}
+
+	if (pool_init(&srv.pool, no_workers) != EXIT_SUCCESS) {
+		close(srv.listenfd);
+		unlink(socketfname);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stdout, "Serving on %s with %d workers\n", socketfname,
+			no_workers);
+	fflush(stdout);
+
+	for (;;) {
+		int fd = accept(srv.listenfd, NULL, NULL);
+
+		if (fd >= 0) {
+			open_connection(&srv, fd);
+			continue;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(srv.mutex);
+
+		if (!srv.quit) {
+			perror("accept");
+			failed = true;
+			stop_server(&srv);
+		}
+		break;
+	}
+
+	// the threads of the connections use the pool
+	{
+		std::unique_lock<std::mutex> lock(srv.mutex);
+
+		while (!srv.connections.empty()) {
+			srv.closed.wait(lock);
+		}
+	}
+
+	pool_free(&srv.pool);
+	close(srv.listenfd);
+	unlink(socketfname);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+/*
+ * serve.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef SERVE_H_
+#define SERVE_H_
+
+/*
+ * Protocol of the server.
+ * A client sends requests over a Unix domain stream socket and receives a
+ * response to each before it sends the next one; a connection may carry
+ * any number of requests.
+ * A client which neither sends nor receives for a minute is dropped, and
+ * so is a DATA request of more than 1 GiB, or one which would make the
+ * server hold more than 4 GiB of data of all clients.
+ * Each request is a line of one of the forms
+ *
+ *     FILE <top words> <path>
+ *     DATA <top words> <bytes>
+ *     QUIT
+ *
+ * FILE counts the file at the given path, DATA the given number of bytes
+ * which follow the line.
+ * If top words is zero, all words are returned.
+ * QUIT stops the server.
+ * The response is a line "OK <words>", followed by one line
+ * "<word>\t<count>" per word in the order of the output file of wfc, or a
+ * single line "ERROR <message>".
+ */
+#define SERVE_REQUEST_FILE "FILE"
+#define SERVE_REQUEST_DATA "DATA"
+#define SERVE_REQUEST_QUIT "QUIT"
+
+/**
+ * Serves count requests on the Unix domain socket at the given path until
+ * a client sends QUIT.
+ * The no_workers threads of the worker pool and their word tables are
+ * created once and reused for each request, so a request pays neither
+ * for starting workers nor for allocating their tables.
+ * Each connection is served by its own thread, and the requests of all
+ * connections are counted by the pool one at a time.
+ * Clients act with the rights of the server, so the socket is accessible
+ * to the user of the server only.
+ * The socket of a previous server is replaced, unless that server still
+ * accepts connections.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the socket cannot be created,
+ * another server serves on it, or the pool cannot be started.
+ */
+int serve(const char *socketfname, int no_workers);
+
+#endif /* SERVE_H_ */
@@ -0,0 +1,478 @@
+/*
+ * sketch.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "sketch.h"
+#include "word_table.h"
+
+/*
+ * Bytes of the SpaceSaving summary per monitored word: its entry, the word,
+ * its place in the heap, and two slots of the index.
+ */
+#define BYTES_PER_WORD (sizeof(sketch_entry) + SKETCH_WORD_BYTES \
+		+ 3 * sizeof(uint32_t))
+
+/*
+ * Index of an empty slot of the index.
+ */
+#define EMPTY_SLOT UINT32_MAX
+
+size_t heavy_hitters_capacity(size_t budget) {
+	return budget / 2 / BYTES_PER_WORD;
+}
+
+/**
+ * Returns the largest power of two which is at most the given value, or
+ * one.
+ */
+static size_t floor_power_of_two(size_t value) {
+	size_t power = 1;
+
+	while (power <= value / 2) {
+		power *= 2;
+	}
+
+	return power;
+}
+
+int heavy_hitters_init(heavy_hitters *sketch, size_t budget) {
+	size_t capacity = std::max(heavy_hitters_capacity(budget), (size_t) 1);
+	size_t index_capacity = 2 * floor_power_of_two(capacity) * 2;
+	size_t width = floor_power_of_two(
+			(budget - std::min(budget, capacity * BYTES_PER_WORD))
+					/ (SKETCH_DEPTH * sizeof(uint64_t)));
+
+	sketch->capacity = capacity;
+	sketch->size = 0;
+	sketch->entries = (sketch_entry *) calloc(capacity, sizeof(sketch_entry));
+	sketch->heap = (uint32_t *) malloc(capacity * sizeof(uint32_t));
+	sketch->index = (uint32_t *) malloc(index_capacity * sizeof(uint32_t));
+	sketch->index_mask = index_capacity - 1;
+	sketch->counters = (uint64_t *) calloc(SKETCH_DEPTH * width,
+			sizeof(uint64_t));
+	sketch->width = width;
+	sketch->tokens = 0;
+	sketch->scratch = NULL;
+	sketch->scratch_capacity = 0;
+
+	if (!sketch->entries || !sketch->heap || !sketch->index
+			|| !sketch->counters) {
+		heavy_hitters_free(sketch);
+		return EXIT_FAILURE;
+	}
+	memset(sketch->index, 0xff, index_capacity * sizeof(uint32_t));
+
+	return EXIT_SUCCESS;
+}
+
+void heavy_hitters_free(heavy_hitters *sketch) {
+	if (sketch->entries) {
+		for (size_t i = 0; i < sketch->size; i++) {
+			free(sketch->entries[i].word);
+		}
+	}
+	free(sketch->entries);
+	free(sketch->heap);
+	free(sketch->index);
+	free(sketch->counters);
+	free(sketch->scratch);
+	sketch->entries = NULL;
+	sketch->heap = NULL;
+	sketch->index = NULL;
+	sketch->counters = NULL;
+	sketch->scratch = NULL;
+	sketch->size = 0;
+}
+
+/**
+ * Returns the column of the given row of the Count-Min sketch for a word
+ * of the given hash.
+ * The rows combine two halves of a mixed hash (Kirsch and Mitzenmacher),
+ * which behaves like independent hashes for the bounds of the sketch.
+ */
+static inline size_t column(const heavy_hitters *sketch, uint32_t hash,
+		int row) {
+	uint64_t mixed = hash * 0x9e3779b97f4a7c15ULL;
+	uint32_t first = (uint32_t) (mixed >> 32);
+	uint32_t second = (uint32_t) mixed | 1;
+
+	return (first + row * second) & (sketch->width - 1);
+}
+
+/**
+ * Returns the Count-Min estimate of the count of a word of the given hash.
+ */
+static uint64_t count_min(const heavy_hitters *sketch, uint32_t hash) {
+	uint64_t estimate = UINT64_MAX;
+
+	for (int row = 0; row < SKETCH_DEPTH; row++) {
+		estimate = std::min(estimate,
+				sketch->counters[row * sketch->width
+						+ column(sketch, hash, row)]);
+	}
+
+	return estimate;
+}
+
+/**
+ * Returns the slot of the index which holds the given word, or the empty
+ * slot at which it would be inserted.
+ */
+static size_t find_slot(const heavy_hitters *sketch, const char *word,
+		size_t length, uint32_t hash) {
+	size_t i = hash & sketch->index_mask;
+
+	while (sketch->index[i] != EMPTY_SLOT) {
+		const sketch_entry *entry = &sketch->entries[sketch->index[i]];
+
+		if ((entry->hash == hash) && (entry->length == length)
+				&& (memcmp(entry->word, word, length) == 0)) {
+			break;
+		}
+		i = (i + 1) & sketch->index_mask;
+	}
+
+	return i;
+}
+
+/**
+ * Removes the given monitored word from the index.
+ * The following words of its cluster are shifted back, so that linear
+ * probing finds them without tombstones.
+ */
+static void remove_slot(heavy_hitters *sketch, const sketch_entry *entry) {
+	size_t mask = sketch->index_mask;
+	size_t i = find_slot(sketch, entry->word, entry->length, entry->hash);
+	size_t j = i;
+
+	for (;;) {
+		size_t home;
+
+		j = (j + 1) & mask;
+		if (sketch->index[j] == EMPTY_SLOT) {
+			break;
+		}
+
+		// move the word back, unless its home slot lies in (i, j]
+		home = sketch->entries[sketch->index[j]].hash & mask;
+		if (((i < j) && ((home <= i) || (home > j)))
+				|| ((i > j) && (home <= i) && (home > j))) {
+			sketch->index[i] = sketch->index[j];
+			i = j;
+		}
+	}
+
+	sketch->index[i] = EMPTY_SLOT;
+}
+
+/**
+ * Moves the entry at the given position of the heap down, until the counts
+ * of its children are at least its count.
+ */
+static void sift_down(heavy_hitters *sketch, size_t position) {
+	uint32_t *heap = sketch->heap;
+	uint32_t entry = heap[position];
+	uint64_t count = sketch->entries[entry].count;
+
+	for (;;) {
+		size_t child = 2 * position + 1;
+
+		if (child >= sketch->size) {
+			break;
+		}
+		if ((child + 1 < sketch->size) && (sketch->entries[heap[child
+				+ 1]].count < sketch->entries[heap[child]].count)) {
+			child++;
+		}
+		if (sketch->entries[heap[child]].count >= count) {
+			break;
+		}
+
+		heap[position] = heap[child];
+		sketch->entries[heap[position]].heap_position = position;
+		position = child;
+	}
+
+	heap[position] = entry;
+	sketch->entries[entry].heap_position = position;
+}
+
+/**
+ * Moves the entry at the given position of the heap up, until the count
+ * of its parent is at most its count.
+ */
+static void sift_up(heavy_hitters *sketch, size_t position) {
+	uint32_t *heap = sketch->heap;
+	uint32_t entry = heap[position];
+	uint64_t count = sketch->entries[entry].count;
+
+	while (position > 0) {
+		size_t parent = (position - 1) / 2;
+
+		if (sketch->entries[heap[parent]].count <= count) {
+			break;
+		}
+
+		heap[position] = heap[parent];
+		sketch->entries[heap[position]].heap_position = position;
+		position = parent;
+	}
+
+	heap[position] = entry;
+	sketch->entries[entry].heap_position = position;
+}
+
+/**
+ * Stores a copy of the given word in the given entry.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int set_word(sketch_entry *entry, const char *word, size_t length,
+		uint32_t hash) {
+	if (entry->capacity < length + 1) {
+		char *larger = (char *) realloc(entry->word, length + 1);
+
+		if (!larger) {
+			return EXIT_FAILURE;
+		}
+		entry->word = larger;
+		entry->capacity = length + 1;
+	}
+
+	memcpy(entry->word, word, length);
+	entry->word[length] = 0;
+	entry->length = length;
+	entry->hash = hash;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Monitors the given word with the given count and error in the summary,
+ * which is not full.
+ */
+static int insert(heavy_hitters *sketch, size_t slot, const char *word,
+		size_t length, uint32_t hash, uint64_t count, uint64_t error) {
+	uint32_t entry_number = sketch->size;
+	sketch_entry *entry = &sketch->entries[entry_number];
+
+	if (set_word(entry, word, length, hash) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+	entry->count = count;
+	entry->error = error;
+	sketch->index[slot] = entry_number;
+	sketch->heap[sketch->size] = entry_number;
+	sketch->size++;
+	sift_up(sketch, sketch->size - 1);
+
+	return EXIT_SUCCESS;
+}
+
+int heavy_hitters_add(heavy_hitters *sketch, const char *word, size_t length,
+		int fold) {
+	uint32_t hash;
+	size_t slot;
+
+	// the summary compares whole words, so fold the case into a copy first
+	if (fold) {
+		if (sketch->scratch_capacity < length) {
+			char *larger = (char *) realloc(sketch->scratch, length);
+
+			if (!larger) {
+				return EXIT_FAILURE;
+			}
+			sketch->scratch = larger;
+			sketch->scratch_capacity = length;
+		}
+		word_fold(word, length, sketch->scratch);
+		word = sketch->scratch;
+	}
+
+	hash = word_hash(word, length);
+	sketch->tokens++;
+	for (int row = 0; row < SKETCH_DEPTH; row++) {
+		sketch->counters[row * sketch->width + column(sketch, hash, row)]++;
+	}
+
+	slot = find_slot(sketch, word, length, hash);
+	if (sketch->index[slot] != EMPTY_SLOT) {
+		sketch_entry *entry = &sketch->entries[sketch->index[slot]];
+
+		entry->count++;
+		sift_down(sketch, entry->heap_position);
+		return EXIT_SUCCESS;
+	}
+
+	if (sketch->size < sketch->capacity) {
+		return insert(sketch, slot, word, length, hash, 1, 0);
+	}
+
+	// replace the word of the smallest count, whose count is inherited
+	{
+		uint32_t entry_number = sketch->heap[0];
+		sketch_entry *entry = &sketch->entries[entry_number];
+
+		remove_slot(sketch, entry);
+		if (set_word(entry, word, length, hash) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+		entry->error = entry->count;
+		entry->count++;
+		sketch->index[find_slot(sketch, word, length, hash)] = entry_number;
+		sift_down(sketch, 0);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the smallest count of the given summary, which unmonitored words
+ * may have reached, or zero if the summary is not full.
+ */
+static inline uint64_t missing_count(const heavy_hitters *sketch) {
+	return (sketch->size == sketch->capacity) ?
+			sketch->entries[sketch->heap[0]].count : 0;
+}
+
+int heavy_hitters_merge(heavy_hitters *destination,
+		const heavy_hitters *source) {
+	uint64_t destination_missing = missing_count(destination);
+	uint64_t source_missing = missing_count(source);
+	std::vector<sketch_entry> merged(destination->entries,
+			destination->entries + destination->size);
+	int status = EXIT_SUCCESS;
+
+	for (size_t i = 0; i < SKETCH_DEPTH * destination->width; i++) {
+		destination->counters[i] += source->counters[i];
+	}
+	destination->tokens += source->tokens;
+
+	// charge the words which the source does not monitor
+	for (sketch_entry &entry : merged) {
+		size_t slot = find_slot(source, entry.word, entry.length, entry.hash);
+
+		if (source->index[slot] != EMPTY_SLOT) {
+			entry.count += source->entries[source->index[slot]].count;
+			entry.error += source->entries[source->index[slot]].error;
+		} else {
+			entry.count += source_missing;
+			entry.error += source_missing;
+		}
+	}
+
+	// and the words which the destination does not monitor
+	for (size_t i = 0; i < source->size; i++) {
+		const sketch_entry *entry = &source->entries[i];
+		size_t slot = find_slot(destination, entry->word, entry->length,
+				entry->hash);
+		sketch_entry copy;
+
+		if (destination->index[slot] != EMPTY_SLOT) {
+			continue;
+		}
+
+		memset(&copy, 0, sizeof(copy));
+		if (set_word(&copy, entry->word, entry->length, entry->hash)
+				!= EXIT_SUCCESS) {
+			status = EXIT_FAILURE;
+			break;
+		}
+		copy.count = entry->count + destination_missing;
+		copy.error = entry->error + destination_missing;
+		merged.push_back(copy);
+	}
+
+	// keep the words of the highest counts
+	if (merged.size() > destination->capacity) {
+		std::nth_element(merged.begin(),
+				merged.begin() + destination->capacity, merged.end(),
+				[](const sketch_entry &lhs, const sketch_entry &rhs) {
+					return lhs.count > rhs.count;
+				});
+		for (size_t i = destination->capacity; i < merged.size(); i++) {
+			free(merged[i].word);
+		}
+		merged.resize(destination->capacity);
+	}
+
+	// rebuild the summary from the merged words
+	memset(destination->index, 0xff,
+			(destination->index_mask + 1) * sizeof(uint32_t));
+	destination->size = merged.size();
+	for (size_t i = 0; i < merged.size(); i++) {
+		destination->entries[i] = merged[i];
+		destination->heap[i] = i;
+		destination->index[find_slot(destination, merged[i].word,
+				merged[i].length, merged[i].hash)] = i;
+	}
+	for (size_t i = destination->size / 2; i-- > 0;) {
+		sift_down(destination, i);
+	}
+	for (size_t i = 0; i < destination->size; i++) {
+		destination->entries[destination->heap[i]].heap_position = i;
+	}
+
+	return status;
+}
+
+/**
+ * Returns the estimated count of the given monitored word.
+ */
+static inline uint64_t estimate(const heavy_hitters *sketch,
+		const sketch_entry *entry) {
+	return std::min(entry->count, count_min(sketch, entry->hash));
+}
+
+size_t heavy_hitters_words(const heavy_hitters *sketch, word_count *words) {
+	for (size_t i = 0; i < sketch->size; i++) {
+		words[i].word = sketch->entries[i].word;
+		words[i].count = estimate(sketch, &sketch->entries[i]);
+	}
+
+	return sketch->size;
+}
+
+void heavy_hitters_bounds_of(const heavy_hitters *sketch, size_t top_k,
+		heavy_hitters_bounds *bounds) {
+	std::vector<const sketch_entry *> ranked(sketch->size);
+	uint64_t threshold = missing_count(sketch);
+	size_t k = std::min(top_k, sketch->size);
+
+	for (size_t i = 0; i < sketch->size; i++) {
+		ranked[i] = &sketch->entries[i];
+	}
+	std::sort(ranked.begin(), ranked.end(),
+			[sketch](const sketch_entry *lhs, const sketch_entry *rhs) {
+				return estimate(sketch, lhs) > estimate(sketch, rhs);
+			});
+
+	bounds->tokens = sketch->tokens;
+	bounds->max_error = 0;
+	bounds->missing_bound = threshold;
+	bounds->count_min_error = (uint64_t) ceil(M_E * sketch->tokens
+			/ sketch->width);
+	bounds->count_min_confidence = 1 - exp(-SKETCH_DEPTH);
+	bounds->certain = 0;
+
+	// the other words occur at most as often as the highest of them
+	if (k < sketch->size) {
+		threshold = std::max(threshold, estimate(sketch, ranked[k]));
+	}
+	for (size_t i = 0; i < k; i++) {
+		const sketch_entry *entry = ranked[i];
+
+		bounds->max_error = std::max(bounds->max_error,
+				std::min(entry->error, estimate(sketch, entry)));
+		if (entry->count - entry->error >= threshold) {
+			bounds->certain++;
+		}
+	}
+}
@@ -0,0 +1,138 @@
+/*
+ * sketch.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef SKETCH_H_
+#define SKETCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ranking.h"
+
+/*
+ * Rows of the Count-Min sketch.
+ * A count exceeds its bound with a probability of at most e^-depth.
+ */
+#define SKETCH_DEPTH 4
+
+/*
+ * Mean length of a monitored word, which the memory budget assumes.
+ */
+#define SKETCH_WORD_BYTES 16
+
+/**
+ * Word which a SpaceSaving summary monitors.
+ * Its count exceeds the frequency of the word by at most its error.
+ */
+typedef struct sketch_entry_t {
+	char *word;
+	uint32_t length;
+	uint32_t capacity;
+	uint32_t hash;
+	uint32_t heap_position;
+	uint64_t count;
+	uint64_t error;
+} sketch_entry;
+
+/**
+ * Approximate counts of the most frequent words in a fixed amount of
+ * memory, however many distinct words the input has.
+ * A SpaceSaving summary monitors a fixed number of words: an unmonitored
+ * word replaces the monitored word of the smallest count and inherits
+ * that count as its error.
+ * A Count-Min sketch of the same tokens bounds the counts of the
+ * monitored words further.
+ * Both only overestimate, and both are mergeable, so that each worker
+ * counts in a sketch of its own and the sketches are merged afterwards.
+ * Sketches of the same memory budget have the same dimensions.
+ */
+typedef struct heavy_hitters_t {
+	size_t capacity;
+	size_t size;
+	sketch_entry *entries;
+	uint32_t *heap;
+	uint32_t *index;
+	size_t index_mask;
+	uint64_t *counters;
+	size_t width;
+	uint64_t tokens;
+	char *scratch;
+	size_t scratch_capacity;
+} heavy_hitters;
+
+/**
+ * Error bounds of the counts of a sketch.
+ * Each count of the top words is at most max_error higher than the
+ * frequency of its word, and each word which is not counted occurs at most
+ * missing_bound times.
+ * With a probability of at least count_min_confidence, each count is at
+ * most count_min_error higher, too.
+ * Of the top words, certain words are certainly at least as frequent as
+ * all words outside of the top words.
+ */
+typedef struct heavy_hitters_bounds_t {
+	uint64_t tokens;
+	uint64_t max_error;
+	uint64_t missing_bound;
+	uint64_t count_min_error;
+	double count_min_confidence;
+	size_t certain;
+} heavy_hitters_bounds;
+
+/**
+ * Returns the number of words which a sketch of the given budget in bytes
+ * monitors.
+ */
+size_t heavy_hitters_capacity(size_t budget);
+
+/**
+ * Initializes an empty sketch of about the given budget in bytes.
+ * Half of the budget is taken by the SpaceSaving summary and half by the
+ * Count-Min sketch.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int heavy_hitters_init(heavy_hitters *sketch, size_t budget);
+
+/**
+ * Frees the given sketch.
+ */
+void heavy_hitters_free(heavy_hitters *sketch);
+
+/**
+ * Counts one occurrence of the given word, whose case is folded like by
+ * word_fold if fold is not zero.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int heavy_hitters_add(heavy_hitters *sketch, const char *word, size_t length,
+		int fold);
+
+/**
+ * Adds the counts of the sketch source, which must have the same budget,
+ * to the sketch destination.
+ * Words which only one of the sketches monitors are charged the smallest
+ * count of the other one, so that the merged counts still overestimate,
+ * and the destination keeps the words of the highest merged counts.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int heavy_hitters_merge(heavy_hitters *destination,
+		const heavy_hitters *source);
+
+/**
+ * Stores the monitored words of the given sketch and their estimated
+ * counts, the smaller of both estimates, in words, which must hold the
+ * capacity of the sketch.
+ * The words are not sorted and stay valid until the sketch changes.
+ * Returns the number of words stored.
+ */
+size_t heavy_hitters_words(const heavy_hitters *sketch, word_count *words);
+
+/**
+ * Computes the error bounds of the given sketch for its top_k most
+ * frequent words.
+ */
+void heavy_hitters_bounds_of(const heavy_hitters *sketch, size_t top_k,
+		heavy_hitters_bounds *bounds);
+
+#endif /* SKETCH_H_ */
@@ -0,0 +1,277 @@
+/*
+ * stats.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+/*
+ * Largest number of phases which are recorded.
+ */
+#define MAX_PHASES 16
+
+/**
+ * Wall and CPU time of a phase.
+ */
+typedef struct phase_stats_t {
+	const char *name;
+	double wall_seconds;
+	double cpu_seconds;
+} phase_stats;
+
+/*
+ * State of the statistics.
+ * The statistics of the workers are NULL unless the statistics are
+ * enabled.
+ */
+static worker_stats *mappers = NULL;
+static worker_stats *reducers = NULL;
+static int max_workers = 0;
+static int workers = 0;
+static phase_stats phases[MAX_PHASES];
+static int number_phases = 0;
+static double phase_start;
+static double phase_cpu_start;
+static double run_start;
+static double run_cpu_start;
+static uint64_t run_distinct_words = 0;
+static bool run_distinct_words_set = false;
+
+double stats_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Returns the CPU seconds of the calling thread.
+ */
+static double thread_cpu(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Returns the CPU seconds of the process and its terminated children.
+ */
+static double process_cpu(void) {
+	struct rusage self, children;
+
+	getrusage(RUSAGE_SELF, &self);
+	getrusage(RUSAGE_CHILDREN, &children);
+
+	return self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6
+			+ self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6
+			+ children.ru_utime.tv_sec + children.ru_utime.tv_usec / 1e6
+			+ children.ru_stime.tv_sec + children.ru_stime.tv_usec / 1e6;
+}
+
+int stats_enable(int number_workers) {
+	size_t size = 2 * number_workers * sizeof(worker_stats);
+	void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (memory == MAP_FAILED) {
+		perror("mmap");
+		return EXIT_FAILURE;
+	}
+
+	// the mapping is zeroed
+	mappers = (worker_stats *) memory;
+	reducers = mappers + number_workers;
+	max_workers = number_workers;
+	workers = number_workers;
+	run_start = stats_now();
+	run_cpu_start = process_cpu();
+
+	return EXIT_SUCCESS;
+}
+
+void stats_set_workers(int number_workers) {
+	if (mappers && (number_workers <= max_workers)) {
+		workers = number_workers;
+	}
+}
+
+void stats_phase_begin(const char *name) {
+	if (!mappers || (number_phases == MAX_PHASES)) {
+		return;
+	}
+
+	phases[number_phases].name = name;
+	phase_start = stats_now();
+	phase_cpu_start = process_cpu();
+}
+
+void stats_phase_end(void) {
+	if (!mappers || (number_phases == MAX_PHASES)) {
+		return;
+	}
+
+	phases[number_phases].wall_seconds = stats_now() - phase_start;
+	phases[number_phases].cpu_seconds = process_cpu() - phase_cpu_start;
+	number_phases++;
+}
+
+worker_stats *stats_mapper(int worker) {
+	return (mappers && (worker < max_workers)) ? &mappers[worker] : NULL;
+}
+
+worker_stats *stats_reducer(int worker) {
+	return (reducers && (worker < max_workers)) ? &reducers[worker] : NULL;
+}
+
+void stats_worker_begin(worker_stats *stats) {
+	if (stats) {
+		stats->start = stats_now();
+		stats->cpu_start = thread_cpu();
+	}
+}
+
+void stats_worker_end(worker_stats *stats) {
+	if (stats) {
+		stats->wall_seconds = stats_now() - stats->start;
+		stats->cpu_seconds = thread_cpu() - stats->cpu_start;
+	}
+}
+
+void stats_table(worker_stats *stats, const word_table *table) {
+	size_t mask = table->capacity - 1;
+
+	if (!stats) {
+		return;
+	}
+
+	stats->tokens = 0;
+	stats->distinct_words = table->size;
+	stats->probes = 0;
+	stats->max_probe = 0;
+	for (size_t i = 0; i < table->capacity; i++) {
+		const word_table_slot *slot = &table->slots[i];
+
+		if (slot->word) {
+			uint64_t probe = (i - slot->hash) & mask;
+
+			stats->tokens += slot->count;
+			stats->probes += probe;
+			if (probe > stats->max_probe) {
+				stats->max_probe = probe;
+			}
+		}
+	}
+}
+
+/**
+ * Returns the wall time of the phase with the given name, or zero.
+ */
+static double phase_seconds(const char *name) {
+	for (int i = 0; i < number_phases; i++) {
+		if (strcmp(phases[i].name, name) == 0) {
+			return phases[i].wall_seconds;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Writes the statistics of the given workers as a JSON array.
+ * The idle time of a worker is the part of the phase in which it waited
+ * for the other workers.
+ */
+static void write_workers(FILE *file, const worker_stats *stats,
+		const char *phase) {
+	double phase_wall = phase_seconds(phase);
+
+	fprintf(file, "[");
+	for (int i = 0; i < workers; i++) {
+		const worker_stats *worker = &stats[i];
+		double idle = phase_wall - worker->wall_seconds;
+
+		fprintf(file,
+				"%s\n    { \"worker\": %d, \"wall_seconds\": %.6f, \"cpu_seconds\": %.6f, \"idle_seconds\": %.6f, \"publish_seconds\": %.6f, \"bytes\": %llu, \"tokens\": %llu, \"distinct_words\": %llu, \"probes\": %llu, \"max_probe\": %llu }",
+				(i == 0) ? "" : ",", i, worker->wall_seconds,
+				worker->cpu_seconds, (idle > 0) ? idle : 0,
+				worker->publish_seconds, (unsigned long long) worker->bytes,
+				(unsigned long long) worker->tokens,
+				(unsigned long long) worker->distinct_words,
+				(unsigned long long) worker->probes,
+				(unsigned long long) worker->max_probe);
+	}
+	fprintf(file, "\n  ]");
+}
+
+void stats_set_distinct_words(uint64_t distinct_words) {
+	run_distinct_words = distinct_words;
+	run_distinct_words_set = true;
+}
+
+int stats_write(const char *statsfname) {
+	FILE *file = stderr;
+	struct rusage self, children;
+	uint64_t bytes = 0;
+	uint64_t tokens = 0;
+	uint64_t distinct_words = 0;
+	int error;
+
+	if (!mappers) {
+		return EXIT_SUCCESS;
+	}
+
+	if (strcmp(statsfname, "-") != 0) {
+		file = fopen(statsfname, "w");
+		if (!file) {
+			fprintf(stderr, "Could not open statistics file!\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (int i = 0; i < workers; i++) {
+		bytes += mappers[i].bytes;
+		tokens += mappers[i].tokens;
+		distinct_words += reducers[i].distinct_words;
+	}
+	if (run_distinct_words_set) {
+		distinct_words = run_distinct_words;
+	}
+	getrusage(RUSAGE_SELF, &self);
+	getrusage(RUSAGE_CHILDREN, &children);
+
+	fprintf(file,
+			"{\n  \"workers\": %d,\n  \"wall_seconds\": %.6f,\n  \"cpu_seconds\": %.6f,\n  \"bytes\": %llu,\n  \"tokens\": %llu,\n  \"distinct_words\": %llu,\n  \"peak_memory_kib\": %ld,\n  \"peak_child_memory_kib\": %ld,\n  \"phases\": [",
+			workers, stats_now() - run_start, process_cpu() - run_cpu_start,
+			(unsigned long long) bytes, (unsigned long long) tokens,
+			(unsigned long long) distinct_words, self.ru_maxrss,
+			children.ru_maxrss);
+	for (int i = 0; i < number_phases; i++) {
+		fprintf(file,
+				"%s\n    { \"name\": \"%s\", \"wall_seconds\": %.6f, \"cpu_seconds\": %.6f }",
+				(i == 0) ? "" : ",", phases[i].name, phases[i].wall_seconds,
+				phases[i].cpu_seconds);
+	}
+	fprintf(file, "\n  ],\n  \"mappers\": ");
+	write_workers(file, mappers, "map");
+	fprintf(file, ",\n  \"reducers\": ");
+	write_workers(file, reducers, "reduce");
+	fprintf(file, "\n}\n");
+
+	error = ferror(file);
+	if (file != stderr) {
+		error = (fclose(file) != 0) || error;
+	}
+	if (error) {
+		fprintf(stderr, "Could not write statistics file!\n");
+	}
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
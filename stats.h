@@ -0,0 +1,105 @@
+/*
+ * stats.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "word_table.h"
+
+/**
+ * Statistics of one mapper or reducer.
+ * The probes are the distances of the words of the worker's table from
+ * their home slots, i.e. the slots which a lookup of a word touches in
+ * addition to the first one.
+ */
+typedef struct worker_stats_t {
+	double wall_seconds;
+	double cpu_seconds;
+	double publish_seconds;
+	uint64_t bytes;
+	uint64_t tokens;
+	uint64_t distinct_words;
+	uint64_t probes;
+	uint64_t max_probe;
+	double start;
+	double cpu_start;
+} worker_stats;
+
+/**
+ * Enables the statistics for up to the given number of workers.
+ * The statistics of the workers are kept in shared memory, so that forked
+ * workers record them, too.
+ * As long as the statistics are disabled, the functions below do nothing
+ * and workers get NULL statistics.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int stats_enable(int max_workers);
+
+/**
+ * Sets the number of workers of the engine, which is at most the number
+ * given to stats_enable.
+ */
+void stats_set_workers(int number_workers);
+
+/**
+ * Begins the phase with the given name, which ends with the next call of
+ * stats_phase_end.
+ * The wall time and the CPU time of the process and its terminated
+ * children are recorded for each phase.
+ */
+void stats_phase_begin(const char *name);
+
+/**
+ * Ends the current phase.
+ */
+void stats_phase_end(void);
+
+/**
+ * Returns the statistics of the given mapper or reducer, or NULL if the
+ * statistics are disabled.
+ */
+worker_stats *stats_mapper(int worker);
+worker_stats *stats_reducer(int worker);
+
+/**
+ * Starts measuring the wall and CPU time of the calling worker.
+ */
+void stats_worker_begin(worker_stats *stats);
+
+/**
+ * Stops measuring the wall and CPU time of the calling worker.
+ */
+void stats_worker_end(worker_stats *stats);
+
+/**
+ * Records the tokens, the distinct words, and the probes of the given
+ * table of a worker.
+ * The tokens are the sum of the counts of the words.
+ */
+void stats_table(worker_stats *stats, const word_table *table);
+
+/**
+ * Sets the distinct words of the run, which the statistics report instead
+ * of the sum of the distinct words of the reducers, e.g. the words of a
+ * checkpoint along with the words counted after it.
+ */
+void stats_set_distinct_words(uint64_t distinct_words);
+
+/**
+ * Writes the statistics as JSON to the given file, or to the standard
+ * error if the file name is "-".
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be written.
+ */
+int stats_write(const char *statsfname);
+
+/**
+ * Returns the seconds of the monotonic clock.
+ */
+double stats_now(void);
+
+#endif /* STATS_H_ */
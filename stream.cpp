@@ -0,0 +1,211 @@
+/*
+ * stream.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+#include "tokenizer.h"
+
+int chunk_stream_init(chunk_stream *stream, FILE *inputfd, size_t chunk_size,
+		int number_chunks) {
+	stream->inputfd = inputfd;
+	stream->chunk_size = chunk_size;
+	stream->number_chunks = number_chunks;
+	stream->carry_length = 0;
+	stream->carry_capacity = chunk_size;
+	stream->done = 0;
+	stream->error = 0;
+	stream->cancelled = 0;
+	stream->carry = (char *) malloc(chunk_size);
+	stream->chunks = (stream_chunk *) calloc(number_chunks,
+			sizeof(stream_chunk));
+
+	if (!stream->carry || !stream->chunks) {
+		chunk_stream_free(stream);
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < number_chunks; i++) {
+		stream->chunks[i].data = (char *) malloc(chunk_size);
+		stream->chunks[i].capacity = chunk_size;
+
+		if (!stream->chunks[i].data) {
+			chunk_stream_free(stream);
+			return EXIT_FAILURE;
+		}
+		stream->free_chunks.push_back(i);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void chunk_stream_free(chunk_stream *stream) {
+	if (stream->chunks) {
+		for (int i = 0; i < stream->number_chunks; i++) {
+			free(stream->chunks[i].data);
+		}
+	}
+	free(stream->carry);
+	free(stream->chunks);
+	stream->carry = NULL;
+	stream->chunks = NULL;
+}
+
+/**
+ * Marks the stream as ended and wakes up all workers.
+ */
+static void finish(chunk_stream *stream, int error) {
+	std::lock_guard<std::mutex> lock(stream->mutex);
+
+	stream->done = 1;
+	stream->error = error;
+	stream->changed.notify_all();
+}
+
+/**
+ * Makes sure that the given buffer of the given capacity holds at least
+ * length bytes.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int reserve(char **buffer, size_t *capacity, size_t length) {
+	char *larger;
+
+	if (*capacity >= length) {
+		return EXIT_SUCCESS;
+	}
+
+	larger = (char *) realloc(*buffer, length);
+	if (!larger) {
+		return EXIT_FAILURE;
+	}
+	*buffer = larger;
+	*capacity = length;
+
+	return EXIT_SUCCESS;
+}
+
+int chunk_stream_read(chunk_stream *stream) {
+	int chunk_number = -1;
+
+	for (;;) {
+		stream_chunk *chunk;
+		size_t length;
+		size_t read;
+		int end_of_input;
+
+		// wait for a free chunk, unless the previous one was not handed out
+		if (chunk_number < 0) {
+			std::unique_lock<std::mutex> lock(stream->mutex);
+
+			while (stream->free_chunks.empty() && !stream->cancelled) {
+				stream->changed.wait(lock);
+			}
+			if (stream->cancelled) {
+				return EXIT_FAILURE;
+			}
+			chunk_number = stream->free_chunks.front();
+			stream->free_chunks.pop_front();
+		}
+		chunk = &stream->chunks[chunk_number];
+
+		if (reserve(&chunk->data, &chunk->capacity,
+				stream->carry_length + stream->chunk_size) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			finish(stream, 1);
+			return EXIT_FAILURE;
+		}
+
+		// continue the word that the previous chunk ended with
+		memcpy(chunk->data, stream->carry, stream->carry_length);
+		length = stream->carry_length;
+		stream->carry_length = 0;
+
+		// read the next chunk_size bytes of the input
+		do {
+			read = fread(chunk->data + length, sizeof(char),
+					chunk->capacity - length, stream->inputfd);
+			length += read;
+		} while ((read > 0) && (length < chunk->capacity));
+
+		if (ferror(stream->inputfd)) {
+			fprintf(stderr, "Could not read input file!\n");
+			finish(stream, 1);
+			return EXIT_FAILURE;
+		}
+
+		end_of_input = (length < chunk->capacity);
+		chunk->length = length;
+
+		if (!end_of_input) {
+			/*
+			 * Carry the last word over to the next chunk, as it may continue
+			 * there.
+			 */
+			size_t cut = seek_prev_boundary(chunk->data, length);
+
+			if (reserve(&stream->carry, &stream->carry_capacity,
+					length - cut) != EXIT_SUCCESS) {
+				fprintf(stderr, "Not enough memory!\n");
+				finish(stream, 1);
+				return EXIT_FAILURE;
+			}
+			stream->carry_length = length - cut;
+			memcpy(stream->carry, chunk->data + cut, stream->carry_length);
+			chunk->length = cut;
+
+			if (cut == 0) {
+				// the chunk is part of a long word, so keep on reading it
+				continue;
+			}
+		}
+
+		// hand the chunk to the workers
+		{
+			std::lock_guard<std::mutex> lock(stream->mutex);
+
+			stream->full_chunks.push_back(chunk_number);
+			stream->changed.notify_all();
+		}
+		chunk_number = -1;
+
+		if (end_of_input) {
+			finish(stream, 0);
+			return EXIT_SUCCESS;
+		}
+	}
+}
+
+void chunk_stream_cancel(chunk_stream *stream) {
+	std::lock_guard<std::mutex> lock(stream->mutex);
+
+	stream->cancelled = 1;
+	stream->changed.notify_all();
+}
+
+int chunk_stream_next(chunk_stream *stream) {
+	std::unique_lock<std::mutex> lock(stream->mutex);
+	int chunk;
+
+	while (stream->full_chunks.empty() && !stream->done) {
+		stream->changed.wait(lock);
+	}
+
+	if (stream->full_chunks.empty()) {
+		return -1;
+	}
+
+	chunk = stream->full_chunks.front();
+	stream->full_chunks.pop_front();
+
+	return chunk;
+}
+
+void chunk_stream_release(chunk_stream *stream, int chunk) {
+	std::lock_guard<std::mutex> lock(stream->mutex);
+
+	stream->free_chunks.push_back(chunk);
+	stream->changed.notify_all();
+}
@@ -0,0 +1,90 @@
+/*
+ * stream.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#define DEFAULT_CHUNK_SIZE (4 * 1024 * 1024)
+
+/**
+ * Chunk of a stream, which holds complete words only.
+ */
+typedef struct stream_chunk_t {
+	char *data;
+	size_t length;
+	size_t capacity;
+} stream_chunk;
+
+/**
+ * Stream which a reader splits into chunks of bounded size for workers.
+ * A fixed ring of chunk buffers bounds the memory by the chunk size times
+ * the number of chunks, independent of the length of the stream.
+ * A word that spans the end of a chunk is carried over to the next chunk,
+ * so that workers can parse chunks independently.
+ * Only words longer than a chunk make buffers grow beyond the chunk size.
+ */
+typedef struct chunk_stream_t {
+	FILE *inputfd;
+	size_t chunk_size;
+	int number_chunks;
+	char *carry;
+	size_t carry_length;
+	size_t carry_capacity;
+	int done;
+	int error;
+	int cancelled;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<int> free_chunks;
+	std::deque<int> full_chunks;
+	stream_chunk *chunks;
+} chunk_stream;
+
+/**
+ * Initializes a stream which reads from inputfd in chunks of chunk_size
+ * bytes, number_chunks of which may be in flight.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int chunk_stream_init(chunk_stream *stream, FILE *inputfd, size_t chunk_size,
+		int number_chunks);
+
+/**
+ * Frees the buffers of the given stream.
+ * The input file is not closed.
+ */
+void chunk_stream_free(chunk_stream *stream);
+
+/**
+ * Reads the input file until its end and hands the chunks to the workers.
+ * This function is meant to be executed by a single reader thread.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if reading failed.
+ */
+int chunk_stream_read(chunk_stream *stream);
+
+/**
+ * Stops the reader, e.g., because the workers failed to start.
+ */
+void chunk_stream_cancel(chunk_stream *stream);
+
+/**
+ * Waits for the next chunk and returns its number, or -1 if the stream
+ * has ended.
+ * The caller must return the chunk with chunk_stream_release.
+ */
+int chunk_stream_next(chunk_stream *stream);
+
+/**
+ * Returns the given chunk to the reader.
+ */
+void chunk_stream_release(chunk_stream *stream, int chunk);
+
+#endif /* STREAM_H_ */
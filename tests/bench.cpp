@@ -0,0 +1,241 @@
+/*
+ * bench.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "bench.h"
+
+/*
+ * Number of attempts to draw a distinct word of a length before the length
+ * is increased, as there are only few short words.
+ */
+#define MAX_ATTEMPTS 16
+
+/**
+ * Returns a uniformly distributed random number in [0, 1).
+ */
+static double next_uniform(bench_corpus *c) {
+	return (bench_random(&c->state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Returns a random word length of the geometric distribution on 1, 2, ...
+ * with the given mean, which is at most CORPUS_MAX_WORD_LENGTH.
+ */
+static int next_length(bench_corpus *c, double mean) {
+	double p = 1.0 / mean;
+	int length;
+
+	do {
+		length = 1 + (int) (log(1.0 - next_uniform(c)) / log(1.0 - p));
+	} while (length > CORPUS_MAX_WORD_LENGTH);
+
+	return length;
+}
+
+/**
+ * Writes a random word of the given number of letters to word.
+ * Returns the number of bytes written.
+ */
+static size_t draw_word(bench_corpus *c, int letters, int mixed, char *word) {
+	static const char *const utf8_letters[] = { "\xc3\xa9", "\xc3\x89",
+			"\xd0\xb6", "\xd0\x96", "\xe4\xb8\x80", "\xf0\x90\x90\x80" };
+	size_t length = 0;
+
+	if (mixed && (bench_random(&c->state) % 16 == 0)) {
+		word[length++] = '\'';
+	}
+	for (int j = 0; j < letters; j++) {
+		if (mixed && (bench_random(&c->state) % 16 == 0)) {
+			const char *letter = utf8_letters[bench_random(&c->state)
+					% (sizeof(utf8_letters) / sizeof(utf8_letters[0]))];
+
+			memcpy(word + length, letter, strlen(letter));
+			length += strlen(letter);
+		} else {
+			char letter = 'a' + bench_random(&c->state) % 26;
+
+			if (mixed && (bench_random(&c->state) % 8 == 0)) {
+				letter -= 'a' - 'A';
+			}
+			word[length++] = letter;
+		}
+	}
+
+	return length;
+}
+
+/**
+ * Draws vocabulary distinct random words.
+ * The table of the generator tells whether a word was drawn before.
+ * The words are null-terminated and stored in the arena of the table, in
+ * the order of their rank.
+ */
+static void make_vocabulary(bench_corpus *c, double mean, int mixed) {
+	char word[CORPUS_MAX_WORD_BYTES];
+
+	c->words = (const char **) malloc(c->vocabulary * sizeof(char *));
+	c->lengths = (size_t *) malloc(c->vocabulary * sizeof(size_t));
+	if (!c->words || !c->lengths || (word_table_init(&c->table, c->vocabulary)
+			!= EXIT_SUCCESS)) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < c->vocabulary; i++) {
+		int letters = next_length(c, mean);
+		int attempts = 0;
+		size_t length;
+
+		for (;;) {
+			size_t size = c->table.size;
+
+			length = draw_word(c, letters, mixed, word);
+			if (word_table_add(&c->table, word, length, 1) != EXIT_SUCCESS) {
+				fprintf(stderr, "Not enough memory!\n");
+				exit(EXIT_FAILURE);
+			}
+			if (c->table.size > size) {
+				break;
+			}
+
+			// the word exists already, so draw another one
+			if (++attempts == MAX_ATTEMPTS) {
+				letters++;
+				attempts = 0;
+			}
+		}
+
+		c->words[i] = word_arena_copy(&c->table.arena, word, length);
+		c->lengths[i] = length;
+		if (!c->words[i]) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * Computes the cumulative distribution of Zipf's law with the given skew
+ * over the ranks 1 to vocabulary.
+ */
+static void make_distribution(bench_corpus *c, double skew) {
+	double sum = 0;
+
+	c->cdf = (double *) malloc(c->vocabulary * sizeof(double));
+	if (!c->cdf) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < c->vocabulary; i++) {
+		sum += 1.0 / pow((double) (i + 1), skew);
+		c->cdf[i] = sum;
+	}
+	for (size_t i = 0; i < c->vocabulary; i++) {
+		c->cdf[i] /= sum;
+	}
+}
+
+void bench_corpus_init(bench_corpus *c, uint64_t seed, size_t vocabulary,
+		double skew, double mean, int mixed) {
+	c->state = seed;
+	c->vocabulary = vocabulary;
+	c->line_length = 0;
+	make_vocabulary(c, mean, mixed);
+	make_distribution(c, skew);
+}
+
+void bench_corpus_free(bench_corpus *c) {
+	free(c->cdf);
+	free(c->lengths);
+	free(c->words);
+	word_table_free(&c->table);
+}
+
+/**
+ * Returns the rank of the next word, counted from zero.
+ */
+static size_t next_rank(bench_corpus *c) {
+	double u = next_uniform(c);
+	size_t rank = std::upper_bound(c->cdf, c->cdf + c->vocabulary, u) - c->cdf;
+
+	return std::min(rank, c->vocabulary - 1);
+}
+
+size_t bench_corpus_next(bench_corpus *c, char *buffer, size_t length) {
+	size_t rank = next_rank(c);
+	const char *word = c->words[rank];
+	size_t used = c->lengths[rank];
+
+	// the corpus ends with a newline instead of a truncated word
+	if (used + 1 > length) {
+		memset(buffer, '\n', length);
+		return length;
+	}
+
+	memcpy(buffer, word, used);
+	c->line_length += used + 1;
+
+	// end sentences and lines now and then
+	if ((bench_random(&c->state) % 16 == 0) && (used + 2 <= length)) {
+		buffer[used++] = '.';
+		c->line_length++;
+	}
+	if ((c->line_length >= 72) || (used + 1 == length)) {
+		buffer[used++] = '\n';
+		c->line_length = 0;
+	} else {
+		buffer[used++] = ' ';
+	}
+
+	return used;
+}
+
+void bench_corpus_fill(bench_corpus *c, char *buffer, size_t length) {
+	size_t used = 0;
+
+	while (used < length) {
+		used += bench_corpus_next(c, buffer + used, length - used);
+	}
+}
+
+void bench_corpus_tokens(bench_corpus *c, uint32_t *tokens, size_t number) {
+	for (size_t i = 0; i < number; i++) {
+		tokens[i] = next_rank(c);
+	}
+}
+
+void generate_text(char *buffer, size_t length, int mixed) {
+	bench_corpus c;
+
+	bench_corpus_init(&c, CORPUS_SEED, CORPUS_VOCABULARY, CORPUS_SKEW,
+			CORPUS_MEAN_LENGTH, mixed);
+	bench_corpus_fill(&c, buffer, length);
+	bench_corpus_free(&c);
+}
+
+word_count *make_words(bench_corpus *c, size_t number) {
+	word_count *words = (word_count *) malloc(number * sizeof(word_count));
+
+	if (!words) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// the vocabulary is drawn in the order of rank
+	bench_corpus_init(c, CORPUS_SEED, number, CORPUS_SKEW, CORPUS_MEAN_LENGTH,
+			0);
+	for (size_t i = 0; i < number; i++) {
+		words[i].word = c->words[i];
+		words[i].count = number / (i + 1) + 1;
+	}
+
+	return words;
+}
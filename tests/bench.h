@@ -0,0 +1,130 @@
+/*
+ * bench.h
+ *
+ * Helpers which the benchmarks share: the clock, and the generator of the
+ * synthetic corpus of gen_corpus, so that the benchmarks count the same
+ * text as the end-to-end runs of the benchmark suite.
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "ranking.h"
+#include "word_table.h"
+
+/*
+ * Default parameters of the corpus, which are those of gen_corpus.
+ */
+#define CORPUS_SEED 42
+#define CORPUS_VOCABULARY 100000
+#define CORPUS_SKEW 1.0
+#define CORPUS_MEAN_LENGTH 5.0
+#define CORPUS_MAX_WORD_LENGTH 32
+
+/*
+ * Maximum number of bytes of a word of the corpus along with its
+ * punctuation and separator.
+ */
+#define CORPUS_MAX_WORD_BYTES (4 * (CORPUS_MAX_WORD_LENGTH + 64) + 3)
+
+/**
+ * Returns the time of the monotonic clock in seconds.
+ */
+static inline double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Returns the next number of the random number generator (SplitMix64)
+ * with the given state.
+ * The generator does not depend on the C library, so the same seed always
+ * yields the same numbers.
+ */
+static inline uint64_t bench_random(uint64_t *state) {
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * Generator of a corpus, whose words are drawn from a vocabulary whose
+ * frequencies follow Zipf's law, i.e. the word of rank r occurs with a
+ * probability proportional to 1 / r^skew.
+ * The lengths of the vocabulary words follow a geometric distribution
+ * with the given mean.
+ */
+typedef struct bench_corpus_t {
+	uint64_t state;
+	word_table table;
+	const char **words;
+	size_t *lengths;
+	double *cdf;
+	size_t vocabulary;
+	size_t line_length;
+} bench_corpus;
+
+/**
+ * Initializes the generator of a corpus with the given seed and
+ * parameters.
+ * The words consist of lowercase ASCII letters, unless mixed is not zero;
+ * then they contain upper case letters, UTF-8 letters of two to four
+ * bytes, and leading apostrophes now and then, too.
+ * Exits if there is not enough memory.
+ */
+void bench_corpus_init(bench_corpus *c, uint64_t seed, size_t vocabulary,
+		double skew, double mean, int mixed);
+
+/**
+ * Frees the vocabulary of the given generator.
+ */
+void bench_corpus_free(bench_corpus *c);
+
+/**
+ * Writes the next word of the corpus, followed by punctuation and a space
+ * or newline, to buffer, of which at most length bytes remain in the
+ * corpus.
+ * If the word does not fit, the remaining bytes are filled with newlines
+ * instead of a truncated word.
+ * Returns the number of bytes written, at most CORPUS_MAX_WORD_BYTES.
+ */
+size_t bench_corpus_next(bench_corpus *c, char *buffer, size_t length);
+
+/**
+ * Fills buffer with the next length bytes of the corpus.
+ */
+void bench_corpus_fill(bench_corpus *c, char *buffer, size_t length);
+
+/**
+ * Fills tokens with the ranks of the next number words of the corpus,
+ * counted from zero, which index the words of the generator.
+ * Punctuation and separators are not drawn.
+ */
+void bench_corpus_tokens(bench_corpus *c, uint32_t *tokens, size_t number);
+
+/**
+ * Fills buffer with length bytes of the corpus of the default parameters,
+ * i.e. the beginning of the corpus which gen_corpus writes by default.
+ * The words are mixed if mixed is not zero (see bench_corpus_init).
+ */
+void generate_text(char *buffer, size_t length, int mixed);
+
+/**
+ * Initializes c with a vocabulary of number words and returns its words
+ * ranked like the output of wfc, whose counts follow Zipf's law.
+ * The words stay valid until c is freed; the caller frees the returned
+ * array.
+ * Exits if there is not enough memory.
+ */
+word_count *make_words(bench_corpus *c, size_t number);
+
+#endif /* BENCH_H_ */
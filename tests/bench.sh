@@ -0,0 +1,279 @@
+#!/bin/bash
+#
+# Benchmark suite of wfc.
+#
+# Generates synthetic corpora with tests/gen_corpus, runs the
+# microbenchmarks (tokenizer, table, sort, output, scheduling) and wfc
+# end-to-end for each corpus size, engine, and parallelism, and writes the
+# best figure of each benchmark out of several repetitions to a JSON file.
+# The figures of the microbenchmarks are the throughputs (e.g. GB/s or
+# Mtok/s) and latencies (ms) which they print for their timed sections, so
+# that generating their input does not count; the figure of a run of wfc
+# is the size of its corpus divided by its wall-clock time.
+# Given the results of an earlier run as baseline, it compares the
+# figures and fails if one of them is worse than the baseline by more
+# than the tolerance.
+#
+# Usage: tests/bench.sh [-o <results file>] [-b <baseline file>]
+#                       [-t <tolerance in percent>] [-r <repetitions>]
+#                       [-s "<corpus sizes>"] [-p "<parallelisms>"]
+#                       [-v <vocabulary size>] [-z <skew>] [-l <mean word length>]
+#
+# Run `make all bench` first.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+results=bench_results.json
+baseline=
+tolerance=10
+repetitions=3
+sizes="4M 64M"
+cpus=$(nproc)
+parallelisms=$(printf '%s\n' 1 2 4 $cpus | sort -nu | tr '\n' ' ')
+vocabulary=100000
+skew=1.0
+length=5
+
+while getopts "ho:b:t:r:s:p:v:z:l:" opt
+do
+  case $opt in
+    o) results=$OPTARG ;;
+    b) baseline=$OPTARG ;;
+    t) tolerance=$OPTARG ;;
+    r) repetitions=$OPTARG ;;
+    s) sizes=$OPTARG ;;
+    p) parallelisms=$OPTARG ;;
+    v) vocabulary=$OPTARG ;;
+    z) skew=$OPTARG ;;
+    l) length=$OPTARG ;;
+    *) sed -n '/^# Usage/,/^# Run/p' "$0" | sed 's/^# \?//' >&2; exit 1 ;;
+  esac
+done
+
+for program in wfc tests/gen_corpus tests/bench_tokenizer tests/bench_table \
+    tests/bench_rank tests/bench_output tests/bench_schedule tests/bench_counter \
+    tests/bench_decompress tests/bench_serve tests/bench_sketch \
+    tests/bench_vocabulary
+do
+  if [ ! -x $program ]
+  then
+    echo "$program is missing, run make all bench first!" >&2
+    exit 1
+  fi
+done
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+names=()
+values=()
+units=()
+
+# Records the given value in the given unit under the given name.
+record() {
+  names+=("$1")
+  values+=("$2")
+  units+=("$3")
+  printf '%-40s %12s %s\n' "$1" "$2" "$3"
+}
+
+# Returns success, iff the first value is better than the second one in
+# the given unit: latencies are better when lower, throughputs when higher.
+better() {
+  awk -v unit="$1" -v a="$2" -v b="$3" \
+    'BEGIN { exit !((unit == "ms") ? a + 0 < b + 0 : a + 0 > b + 0) }'
+}
+
+# Runs the given benchmark repetitions times and records the best of each
+# of its figures under the given prefix.
+# The given awk program extracts lines "<name> <value>" from the output of
+# the benchmark, whose values are in the given unit.
+# The suite fails if the benchmark fails, as the benchmarks check their
+# results.
+measure() {
+  local prefix=$1
+  local unit=$2
+  local program=$3
+  local -A best=()
+  local order=()
+  local name value
+  shift 3
+
+  for ((r = 0; r < repetitions; r++))
+  do
+    if ! "$@" > "$work/log" 2>&1
+    then
+      echo "$prefix failed:" >&2
+      cat "$work/log" >&2
+      exit 1
+    fi
+
+    while read -r name value
+    do
+      if [ -z "${best[$name]}" ]
+      then
+        order+=("$name")
+        best[$name]=$value
+      elif better "$unit" "$value" "${best[$name]}"
+      then
+        best[$name]=$value
+      fi
+    done < <(awk "$program" "$work/log")
+  done
+
+  if [ ${#order[@]} -eq 0 ]
+  then
+    echo "$prefix printed no figures:" >&2
+    cat "$work/log" >&2
+    exit 1
+  fi
+
+  for name in "${order[@]}"
+  do
+    record "$prefix/$name" "${best[$name]}" "$unit"
+  done
+}
+
+# Runs wfc with the given arguments on the given corpus repetitions times
+# and records the size of the corpus divided by its best time in MB/s
+# under the given name.
+measure_wfc() {
+  local name=$1
+  local corpus=$2
+  local bytes=$(stat -c %s "$corpus")
+  local best=
+  shift 2
+
+  for ((r = 0; r < repetitions; r++))
+  do
+    local start=$(date +%s%N)
+
+    if ! ./wfc "$@" -i "$corpus" -o "$work/out.txt" > "$work/log" 2>&1
+    then
+      echo "$name failed:" >&2
+      cat "$work/log" >&2
+      exit 1
+    fi
+
+    local elapsed=$(( $(date +%s%N) - start ))
+
+    if [ -z "$best" ] || [ $elapsed -lt $best ]
+    then
+      best=$elapsed
+    fi
+  done
+
+  record "$name" "$(awk -v bytes=$bytes -v ns=$best \
+    'BEGIN { printf "%.1f", bytes * 1000 / ns }')" MB/s
+}
+
+echo "Generating corpora: $sizes (vocabulary $vocabulary, skew $skew, mean word length $length)"
+for size in $sizes
+do
+  tests/gen_corpus -n $size -v $vocabulary -z $skew -l $length \
+    -o "$work/corpus_$size.txt" || exit 1
+done
+largest=$(ls -S "$work"/corpus_*.txt | head -n 1)
+
+echo "Microbenchmarks"
+# the programs pick the rows of the checked results and name them by the
+# columns which tell the rows apart
+measure micro/tokenizer GB/s \
+  '$NF == "ok" { print $1 "/" (($2 == "yes") ? "utf8" : "ascii"), $4 }' \
+  tests/bench_tokenizer "$largest"
+measure micro/table Mtok/s '$1 ~ /^[0-9]+$/ { print "v" $2, $5 }' \
+  tests/bench_table 4000000 $vocabulary
+measure micro/sort Mw/s '$NF == "ok" { print "t" $2, $4 }' \
+  tests/bench_rank 1000000 1 $cpus
+measure micro/output MB/s '$NF == "ok" { print "t" $2, $4 }' \
+  tests/bench_output 1000000 1 $cpus
+measure micro/schedule MB/s '$NF == "ok" && NF == 7 { print $2 "/t" $1, $6 }' \
+  tests/bench_schedule 16 $cpus
+measure micro/counter MB/s '$1 ~ /^[0-9]+$/ && $NF == "ok" { print "span" $1, $3 }' \
+  tests/bench_counter 16 $cpus
+measure micro/decompress MB/s \
+  '$NF == "ok" && $4 != "-" { print $1 "/t" $2, $4 }' \
+  tests/bench_decompress 32 1 $cpus
+measure micro/serve ms '$NF == "ok" {
+    job = $1
+    for (i = 2; i <= NF - 4; i++) job = job "-" $i
+    print job "/p50", $(NF - 3)
+    print job "/p99", $(NF - 2)
+  }' tests/bench_serve 1024 20 $cpus
+measure micro/sketch Mtok/s '$NF == "ok" {
+    budget = $1
+    for (i = 2; i <= NF - 7; i++) budget = budget $i
+    print budget, $(NF - 4)
+  }' tests/bench_sketch 16 $cpus
+measure micro/vocabulary Mtok/s '$NF == "ok" { print $1, $3 }' \
+  tests/bench_vocabulary 300000 16 $cpus
+
+echo "End-to-end runs"
+for size in $sizes
+do
+  for engine in processes threads
+  do
+    for p in $parallelisms
+    do
+      measure_wfc wfc/$size/$engine/p$p "$work/corpus_$size.txt" \
+        -p $p --$engine
+    done
+  done
+done
+
+{
+  echo "{"
+  echo "  \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\","
+  echo "  \"host\": \"$(uname -n)\","
+  echo "  \"cpus\": $cpus,"
+  echo "  \"repetitions\": $repetitions,"
+  echo "  \"corpus\": { \"vocabulary\": $vocabulary, \"skew\": $skew, \"mean_length\": $length },"
+  echo "  \"results\": ["
+  for ((i = 0; i < ${#names[@]}; i++))
+  do
+    separator=","
+    if [ $i -eq $((${#names[@]} - 1)) ]
+    then
+      separator=
+    fi
+    echo "    { \"name\": \"${names[$i]}\", \"value\": ${values[$i]}, \"unit\": \"${units[$i]}\" }$separator"
+  done
+  echo "  ]"
+  echo "}"
+} > "$results"
+echo "Results written to $results"
+
+if [ -z "$baseline" ]
+then
+  exit 0
+fi
+
+# Extracts "name value unit" lines from a results file.
+extract() {
+  sed -n 's/.*"name": "\([^"]*\)", "value": \([0-9.]*\), "unit": "\([^"]*\)".*/\1 \2 \3/p' "$1"
+}
+
+echo "Comparison to $baseline (tolerance $tolerance%)"
+awk -v tolerance=$tolerance '
+  NR == FNR { base[$1] = $2; next }
+  {
+    if (!($1 in base)) {
+      printf "%-40s %12s %12.3f %9s %s\n", $1, "-", $2, "new", $3
+      next
+    }
+    change = (base[$1] > 0) ? 100 * ($2 - base[$1]) / base[$1] : 0
+    # latencies regress when they grow, throughputs when they shrink
+    worse = ($3 == "ms") ? change : -change
+    verdict = (worse > tolerance) ? "REGRESSION" : ""
+    if (verdict != "") {
+      regressions++
+    }
+    printf "%-40s %12.3f %12.3f %+8.1f%% %-6s %s\n", $1, base[$1], $2, change, $3, verdict
+  }
+  END {
+    if (regressions) {
+      printf "%d regression(s)\n", regressions
+      exit 1
+    }
+  }' <(extract "$baseline") <(extract "$results")
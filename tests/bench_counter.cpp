@@ -0,0 +1,287 @@
+/*
+ * bench_counter.cpp
+ *
+ * Measures feeding a word_counter of libwfc in spans of several sizes and
+ * checks that the counts do not depend on the span size, that counters of
+ * several threads merge to the same counts, and that serialized counters,
+ * single-word queries, and the top words agree with them.
+ * It also checks that counters with tokenizers of their own, which are
+ * used at the same time, do not affect each other.
+ * The text mixes ASCII and UTF-8 words, which are counted in UTF-8 mode
+ * with both normalizations, so that spans split multibyte characters, too.
+ *
+ * Usage: bench_counter [<MiB> [<threads>]]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "word_counter.h"
+
+#define DEFAULT_MIB 16
+#define DEFAULT_THREADS 4
+#define TOP_WORDS 10
+
+/**
+ * Feeds the given text to counter in spans of the given size and finishes
+ * the stream.
+ */
+static void feed(word_counter *counter, const char *text, size_t length,
+		size_t span) {
+	for (size_t offset = 0; offset < length; offset += span) {
+		size_t span_length = (length - offset < span) ? length - offset : span;
+
+		if (word_counter_feed(counter, text + offset, span_length)
+				!= EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (word_counter_finish(counter) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Returns true, iff both counters hold the same words with the same counts.
+ */
+static bool same_counts(const word_counter *counter1,
+		const word_counter *counter2) {
+	const word_table *table = &counter1->table;
+
+	if ((counter1->tokens != counter2->tokens)
+			|| (word_counter_size(counter1) != word_counter_size(counter2))) {
+		return false;
+	}
+
+	for (size_t i = 0; i < table->capacity; i++) {
+		const word_table_slot *slot = &table->slots[i];
+
+		if (slot->word && (word_counter_count(counter2, slot->word,
+				slot->length) != slot->count)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Counts the given text with number_threads counters, one per thread,
+ * and merges them into merged.
+ * The text is split at word boundaries.
+ */
+static void count_threads(const char *text, size_t length,
+		int number_threads, word_counter *merged) {
+	std::vector<word_counter> counters(number_threads);
+	std::vector<std::thread> threads;
+	size_t start = 0;
+
+	for (int i = 0; i < number_threads; i++) {
+		size_t end = (i == number_threads - 1) ?
+				length :
+				seek_prev_boundary(text, length / number_threads * (i + 1));
+
+		if (end < start) {
+			end = start;
+		}
+		if (word_counter_init(&counters[i]) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		threads.emplace_back(feed, &counters[i], text + start, end - start,
+				(size_t) 64 * 1024);
+		start = end;
+	}
+	for (int i = 0; i < number_threads; i++) {
+		threads[i].join();
+		if (word_counter_merge(merged, &counters[i]) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		word_counter_free(&counters[i]);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	const size_t spans[] = { 1, 7, 64, 4096, 1024 * 1024 };
+	size_t mib = DEFAULT_MIB;
+	int number_threads = DEFAULT_THREADS;
+	size_t length;
+	char *text;
+	word_counter expected;
+	word_count top[TOP_WORDS];
+	size_t number_top;
+	int error = 0;
+
+	if (argc > 1) {
+		mib = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		number_threads = atoi(argv[2]);
+		if (number_threads < 1) {
+			fprintf(stderr, "The number of threads must be positive!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	length = mib * 1024 * 1024;
+	text = (char *) malloc(length);
+	if (!text) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	generate_text(text, length, 1);
+
+	tokenizer_set_utf8(1);
+	tokenizer_set_normalization(TOKENIZER_FOLD_CASE | TOKENIZER_TRIM);
+
+	if (word_counter_init(&expected) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	feed(&expected, text, length, length);
+
+	printf("%-12s %12s %12s %8s\n", "span", "tokens", "MB/s", "check");
+
+	for (size_t s = 0; s < sizeof(spans) / sizeof(spans[0]); s++) {
+		word_counter counter;
+		double start;
+		double seconds;
+		bool check;
+
+		if (word_counter_init(&counter) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		start = now();
+		feed(&counter, text, length, spans[s]);
+		seconds = now() - start;
+
+		check = same_counts(&expected, &counter);
+		if (!check) {
+			error = 1;
+		}
+		printf("%-12zu %12llu %12.1f %8s\n", spans[s],
+				(unsigned long long) counter.tokens, length / seconds / 1e6,
+				check ? "ok" : "FAILED");
+		word_counter_free(&counter);
+	}
+
+	// counters of threads
+	{
+		word_counter merged;
+		bool check;
+
+		if (word_counter_init(&merged) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		count_threads(text, length, number_threads, &merged);
+		check = same_counts(&expected, &merged);
+		if (!check) {
+			error = 1;
+		}
+		printf("merged counters of %d threads: %s\n", number_threads,
+				check ? "ok" : "FAILED");
+		word_counter_free(&merged);
+	}
+
+	// serialized counter
+	{
+		size_t serialized_length = word_counter_serialized_length(&expected);
+		char *buffer = (char *) malloc(serialized_length);
+		word_counter copy;
+		bool check;
+
+		if (!buffer || (word_counter_init(&copy) != EXIT_SUCCESS)) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		word_counter_serialize(&expected, buffer);
+		check = (word_counter_merge_serialized(&copy, buffer,
+				serialized_length) == EXIT_SUCCESS)
+				&& same_counts(&expected, &copy)
+				&& (word_counter_merge_serialized(&copy, buffer,
+						serialized_length / 2) == EXIT_FAILURE);
+		if (!check) {
+			error = 1;
+		}
+		printf("serialized counter of %zu bytes: %s\n", serialized_length,
+				check ? "ok" : "FAILED");
+		word_counter_free(&copy);
+		free(buffer);
+	}
+
+	// the top words are ranked, and queries are normalized like the text
+	{
+		bool check = true;
+
+		number_top = word_counter_top(&expected, TOP_WORDS, top);
+		for (size_t i = 0; i < number_top; i++) {
+			char query[64];
+
+			snprintf(query, sizeof(query), "'%s'", top[i].word);
+			if (((i > 0) && !ranks_before(top[i - 1], top[i]))
+					|| (word_counter_count(&expected, query, strlen(query))
+							!= top[i].count)) {
+				check = false;
+			}
+		}
+		if (!check) {
+			error = 1;
+		}
+		printf("top %zu words: %s\n", number_top, check ? "ok" : "FAILED");
+	}
+
+	// counters with tokenizers of their own count side by side
+	{
+		tokenizer plain;
+		word_counter plain_expected;
+		word_counter counters[2];
+		std::vector<std::thread> threads;
+		bool check;
+
+		if ((tokenizer_init(&plain, TOKENIZER_AUTO, 0, 0) != EXIT_SUCCESS)
+				|| (word_counter_init_tokenizer(&plain_expected, &plain)
+						!= EXIT_SUCCESS)
+				|| (word_counter_init_tokenizer(&counters[0], &plain)
+						!= EXIT_SUCCESS)
+				|| (word_counter_init(&counters[1]) != EXIT_SUCCESS)) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		feed(&plain_expected, text, length, length);
+		for (int i = 0; i < 2; i++) {
+			threads.emplace_back(feed, &counters[i], text, length,
+					(size_t) 64 * 1024);
+		}
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+
+		check = same_counts(&plain_expected, &counters[0])
+				&& same_counts(&expected, &counters[1])
+				&& !same_counts(&expected, &counters[0]);
+		if (!check) {
+			error = 1;
+		}
+		printf("counters with their own tokenizers: %s\n",
+				check ? "ok" : "FAILED");
+		for (int i = 0; i < 2; i++) {
+			word_counter_free(&counters[i]);
+		}
+		word_counter_free(&plain_expected);
+	}
+
+	word_counter_free(&expected);
+	free(text);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/*
+ * bench_decompress.cpp
+ *
+ * Measures decompressing gzip inputs in memory with several numbers of
+ * threads and checks that the decompressed bytes equal the original text.
+ * The text is compressed once as a single member, which only one thread
+ * can decode, and once as a member per MiB, as written by appending to a
+ * compressed log, which all threads decode in parallel.
+ * The streaming decoder, which wfc uses with --stream, is checked with
+ * both inputs, too.
+ *
+ * Usage: bench_decompress [<MiB> [<threads> ...]]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <algorithm>
+#include "bench.h"
+#include "decompress.h"
+
+#define DEFAULT_MIB 64
+#define MAX_THREADS 256
+#define MEMBER_SIZE (1024 * 1024)
+
+/**
+ * Compresses text into gzip members of at most member_size bytes of text.
+ * Returns the compressed bytes, whose number is stored in compressed_length.
+ */
+static char *compress_members(const char *text, size_t length,
+		size_t member_size, size_t *compressed_length) {
+	size_t capacity = compressBound(length)
+			+ 64 * (length / member_size + 1);
+	char *compressed = (char *) malloc(capacity);
+
+	if (!compressed) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	*compressed_length = 0;
+	for (size_t offset = 0; offset < length; offset += member_size) {
+		z_stream z;
+
+		memset(&z, 0, sizeof(z));
+		if (deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY)
+				!= Z_OK) {
+			fprintf(stderr, "Could not compress!\n");
+			exit(EXIT_FAILURE);
+		}
+		z.next_in = (Bytef *) text + offset;
+		z.avail_in = (length - offset < member_size) ?
+				length - offset : member_size;
+		z.next_out = (Bytef *) compressed + *compressed_length;
+		z.avail_out = capacity - *compressed_length;
+		if (deflate(&z, Z_FINISH) != Z_STREAM_END) {
+			fprintf(stderr, "Could not compress!\n");
+			exit(EXIT_FAILURE);
+		}
+		*compressed_length += z.total_out;
+		deflateEnd(&z);
+	}
+
+	return compressed;
+}
+
+/**
+ * Returns true, iff the streaming decoder yields text from compressed.
+ */
+static bool check_stream(char *compressed, size_t compressed_length,
+		const char *text, size_t length) {
+	FILE *inputfd = fmemopen(compressed, compressed_length, "r");
+	FILE *decodedfd;
+	char *decoded = (char *) malloc(length + 1);
+	size_t decoded_length = 0;
+	size_t read;
+	bool check;
+
+	if (!inputfd || !decoded || !(decodedfd = decompress_open(inputfd))) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// read in odd sizes, which split the members
+	while ((decoded_length <= length) && ((read = fread(
+			decoded + decoded_length, sizeof(char),
+			std::min((size_t) 99991, length + 1 - decoded_length),
+			decodedfd)) > 0)) {
+		decoded_length += read;
+	}
+	check = !ferror(decodedfd) && (decoded_length == length)
+			&& (memcmp(decoded, text, length) == 0);
+
+	fclose(decodedfd);
+	fclose(inputfd);
+	free(decoded);
+
+	return check;
+}
+
+int main(int argc, char *argv[]) {
+	size_t mib = DEFAULT_MIB;
+	int default_threads[] = { 1, 2, 4, 8 };
+	int *threads = default_threads;
+	int number_threads = 4;
+	size_t length;
+	char *text;
+	int error = 0;
+
+	if (argc > 1) {
+		mib = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		threads = (int *) malloc((argc - 2) * sizeof(int));
+		number_threads = argc - 2;
+		for (int i = 2; i < argc; i++) {
+			threads[i - 2] = atoi(argv[i]);
+			if ((threads[i - 2] < 1) || (threads[i - 2] > MAX_THREADS)) {
+				fprintf(stderr, "The number of threads must be between 1 and %d!\n",
+						MAX_THREADS);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	length = mib * 1024 * 1024;
+	text = (char *) malloc(length);
+	if (!text) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	generate_text(text, length, 0);
+
+	printf("%-8s %-8s %12s %10s %8s\n", "members", "threads", "seconds",
+			"MB/s", "check");
+
+	for (int members = 0; members < 2; members++) {
+		size_t compressed_length;
+		char *compressed = compress_members(text, length,
+				members ? MEMBER_SIZE : length + 1, &compressed_length);
+		input_data input = { compressed, compressed_length, 0 };
+		bool check;
+
+		for (int t = 0; t < number_threads; t++) {
+			input_data output;
+			double start, seconds;
+
+			decompress_set_threads(threads[t]);
+			start = now();
+			if (decompress_input(&input, COMPRESSION_GZIP, &output)
+					!= EXIT_SUCCESS) {
+				exit(EXIT_FAILURE);
+			}
+			seconds = now() - start;
+
+			check = (output.length == length)
+					&& (memcmp(output.data, text, length) == 0);
+			if (!check) {
+				error = 1;
+			}
+			free((void *) output.data);
+
+			printf("%-8s %-8d %12.3f %10.1f %8s\n", members ? "many" : "one",
+					threads[t], seconds, length / seconds / 1e6,
+					check ? "ok" : "FAILED");
+		}
+
+		check = check_stream(compressed, compressed_length, text, length);
+		if (!check) {
+			error = 1;
+		}
+		printf("%-8s %-8s %12s %10s %8s\n", members ? "many" : "one", "stream",
+				"-", "-", check ? "ok" : "FAILED");
+
+		free(compressed);
+	}
+
+	free(text);
+	if (threads != default_threads) {
+		free(threads);
+	}
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+/*
+ * bench_output.cpp
+ *
+ * Measures writing the ranked words to the output file with several
+ * numbers of threads and checks that all of them write the same file.
+ *
+ * Usage: bench_output [<distinct words> [<threads> ...]]
+ * The output is written to bench_output.txt.
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "output.h"
+#include "ranking.h"
+
+#define DEFAULT_WORDS 4000000
+#define OUTPUT_FILE "bench_output.txt"
+#define REPETITIONS 3
+
+/**
+ * Reads the whole given file.
+ * Returns its content, whose length is stored in length, or NULL.
+ */
+static char *read_file(const char *fname, size_t *length) {
+	FILE *file = fopen(fname, "r");
+	char *content = NULL;
+	long size;
+
+	if (!file) {
+		return NULL;
+	}
+
+	if ((fseek(file, 0, SEEK_END) == 0) && ((size = ftell(file)) >= 0)) {
+		rewind(file);
+		content = (char *) malloc(size + 1);
+		if (content && (fread(content, 1, size, file) != (size_t) size)) {
+			free(content);
+			content = NULL;
+		}
+		*length = size;
+	}
+	fclose(file);
+
+	return content;
+}
+
+int main(int argc, char *argv[]) {
+	size_t number = DEFAULT_WORDS;
+	int default_threads[] = { 1, 2, 4, 8 };
+	int *threads = default_threads;
+	int number_threads = 4;
+	bench_corpus c;
+	char *expected = NULL;
+	size_t expected_length = 0;
+	word_count *words;
+	int error = 0;
+
+	if (argc > 1) {
+		number = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		threads = (int *) malloc((argc - 2) * sizeof(int));
+		number_threads = argc - 2;
+		for (int i = 2; i < argc; i++) {
+			threads[i - 2] = atoi(argv[i]);
+		}
+	}
+
+	words = make_words(&c, number);
+
+	printf("%-12s %-8s %12s %12s %8s\n", "words", "threads", "MB", "MB/s",
+			"check");
+
+	for (int t = 0; t < number_threads; t++) {
+		double best = 0;
+		char *content;
+		size_t length = 0;
+		int check;
+
+		for (int r = 0; r < REPETITIONS; r++) {
+			double start = now();
+			double seconds;
+
+			if (output_write(OUTPUT_FILE, words, number, threads[t])
+					!= EXIT_SUCCESS) {
+				exit(EXIT_FAILURE);
+			}
+			seconds = now() - start;
+			if ((best == 0) || (seconds < best)) {
+				best = seconds;
+			}
+		}
+
+		content = read_file(OUTPUT_FILE, &length);
+		if (!content) {
+			fprintf(stderr, "Could not read output file!\n");
+			exit(EXIT_FAILURE);
+		}
+		if (t == 0) {
+			expected = content;
+			expected_length = length;
+		}
+
+		check = (length == expected_length)
+				&& (memcmp(content, expected, length) == 0);
+		if (!check) {
+			error = 1;
+		}
+		if (content != expected) {
+			free(content);
+		}
+
+		printf("%-12zu %-8d %12.1f %12.1f %8s\n", number, threads[t],
+				length / 1e6, length / best / 1e6, check ? "ok" : "FAILED");
+	}
+
+	remove(OUTPUT_FILE);
+	free(expected);
+	free(words);
+	bench_corpus_free(&c);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+/*
+ * bench_rank.cpp
+ *
+ * Compares sorting the distinct words with qsort, which wfc used formerly,
+ * to sorting them with rank_words, and checks that both agree.
+ *
+ * Usage: bench_rank [<distinct words> [<threads> ...]]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "ranking.h"
+
+#define DEFAULT_WORDS 4000000
+
+static int cmp_rank(const void *p1, const void *p2) {
+	const word_count *wc1 = (const word_count *) p1;
+	const word_count *wc2 = (const word_count *) p2;
+
+	if (wc1->count != wc2->count) {
+		return (wc1->count < wc2->count) ? 1 : -1;
+	}
+
+	return strcmp(wc1->word, wc2->word);
+}
+
+int main(int argc, char *argv[]) {
+	size_t number = DEFAULT_WORDS;
+	int default_threads[] = { 1, 2, 4, 8 };
+	int *threads = default_threads;
+	int number_threads = 4;
+	bench_corpus c;
+	uint64_t state = CORPUS_SEED;
+	word_count *words, *expected, *sorted;
+	double start, qsort_seconds;
+	int error = 0;
+
+	if (argc > 1) {
+		number = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		threads = (int *) malloc((argc - 2) * sizeof(int));
+		number_threads = argc - 2;
+		for (int i = 2; i < argc; i++) {
+			threads[i - 2] = atoi(argv[i]);
+		}
+	}
+
+	words = make_words(&c, number);
+
+	// shuffle, as the reducers collect words in hash order
+	for (size_t i = number - 1; i > 0; i--) {
+		size_t j = bench_random(&state) % (i + 1);
+		word_count word = words[i];
+
+		words[i] = words[j];
+		words[j] = word;
+	}
+
+	expected = (word_count *) malloc(number * sizeof(word_count));
+	sorted = (word_count *) malloc(number * sizeof(word_count));
+	if (!expected || !sorted) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memcpy(expected, words, number * sizeof(word_count));
+	start = now();
+	qsort(expected, number, sizeof(word_count), cmp_rank);
+	qsort_seconds = now() - start;
+
+	printf("%-12s %-8s %12s %12s %8s %8s\n", "words", "threads",
+			"qsort Mw/s", "rank Mw/s", "speedup", "check");
+
+	for (int t = 0; t < number_threads; t++) {
+		double rank_seconds;
+		int check;
+
+		memcpy(sorted, words, number * sizeof(word_count));
+		start = now();
+		if (rank_words(sorted, number, threads[t]) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		rank_seconds = now() - start;
+
+		check = (memcmp(sorted, expected, number * sizeof(word_count)) == 0);
+		if (!check) {
+			error = 1;
+		}
+
+		printf("%-12zu %-8d %12.2f %12.2f %7.2fx %8s\n", number, threads[t],
+				number / qsort_seconds / 1e6, number / rank_seconds / 1e6,
+				qsort_seconds / rank_seconds, check ? "ok" : "FAILED");
+	}
+
+	free(sorted);
+	free(expected);
+	free(words);
+	bench_corpus_free(&c);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,321 @@
+/*
+ * bench_schedule.cpp
+ *
+ * Compares splitting the input into one static slice per worker, which
+ * wfc used formerly, to scheduling chunks with a work-stealing chunk_queue
+ * on a deliberately skewed input, and checks that both count the same words.
+ * The input starts with densely packed words, followed by mostly
+ * whitespace, so that the first static slice is much more expensive than
+ * the others.
+ * Since the machine may have fewer cores than workers, the critical path
+ * is estimated by the CPU time of the busiest worker rather than by the
+ * wall-clock time.
+ *
+ * Usage: bench_schedule [<MiB> [<threads> ...]]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+#include <vector>
+#include "counter.h"
+#include "schedule.h"
+
+#define DEFAULT_MIB 64
+#define MAX_THREADS 256
+
+/*
+ * Chunk size for the check that tiny chunks count each word exactly once.
+ */
+#define TINY_CHUNK_SIZE 7
+
+static double thread_seconds(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Fills buffer with the skewed input: the first quarter consists of short
+ * random words separated by single spaces, the rest of a word every few
+ * kilobytes of whitespace.
+ */
+static void generate_skewed(char *buffer, size_t length) {
+	size_t dense = length / 4;
+	size_t i = 0;
+
+	srand(42);
+	while (i < length) {
+		int word_length = 1 + rand() % 6;
+
+		for (int j = 0; (j < word_length) && (i < length); j++, i++) {
+			buffer[i] = 'a' + rand() % 26;
+		}
+		if (i < dense) {
+			buffer[i++] = ' ';
+		} else {
+			size_t gap = 1024 + rand() % 4096;
+
+			for (size_t j = 0; (j < gap) && (i < length); j++, i++) {
+				buffer[i] = (j % 64 == 63) ? '\n' : ' ';
+			}
+		}
+	}
+}
+
+/**
+ * Result of one worker.
+ */
+typedef struct worker_result_t {
+	word_table table;
+	double seconds;
+	int error;
+} worker_result;
+
+/**
+ * Counts the static slice of the given worker out of number_workers slices.
+ */
+static void count_slice(const input_data *input, int worker, int number_workers,
+		worker_result *result) {
+	size_t slice = input->length / number_workers;
+	size_t start = worker * slice;
+	size_t end = (worker == number_workers - 1) ?
+			input->length : start + slice;
+	double begin = thread_seconds();
+
+	result->error = count_range(tokenizer_default(), input, start, end,
+			&result->table, NULL);
+	result->seconds = thread_seconds() - begin;
+}
+
+/**
+ * Counts the chunks which the given worker claims from the queue.
+ */
+static void count_queue(const input_data *input, chunk_queue *queue,
+		int worker, worker_result *result) {
+	double begin = thread_seconds();
+	size_t start, end;
+
+	result->error = EXIT_SUCCESS;
+	while (chunk_queue_next(queue, worker, &start, &end)) {
+		if (count_range(tokenizer_default(), input, start, end,
+				&result->table, NULL) != EXIT_SUCCESS) {
+			result->error = EXIT_FAILURE;
+			break;
+		}
+	}
+	result->seconds = thread_seconds() - begin;
+}
+
+/**
+ * Merges the tables of the workers into merged and frees them.
+ * Stores the CPU time of the busiest worker in max_seconds and the total
+ * CPU time in sum_seconds.
+ */
+static void collect(worker_result *results, int number_workers,
+		word_table *merged, double *max_seconds, double *sum_seconds) {
+	*max_seconds = 0;
+	*sum_seconds = 0;
+	for (int i = 0; i < number_workers; i++) {
+		if ((results[i].error != EXIT_SUCCESS)
+				|| (word_table_merge(merged, &results[i].table)
+						!= EXIT_SUCCESS)) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		word_table_free(&results[i].table);
+		if (results[i].seconds > *max_seconds) {
+			*max_seconds = results[i].seconds;
+		}
+		*sum_seconds += results[i].seconds;
+	}
+}
+
+/**
+ * Returns true, iff both tables contain the same words with the same counts.
+ */
+static bool same_counts(const word_table *table1, const word_table *table2) {
+	if (table1->size != table2->size) {
+		return false;
+	}
+
+	for (size_t i = 0; i < table1->capacity; i++) {
+		const word_table_slot *slot = &table1->slots[i];
+
+		if (slot->word) {
+			size_t mask = table2->capacity - 1;
+			size_t j = slot->hash & mask;
+
+			while (table2->slots[j].word && (strcmp(table2->slots[j].word,
+					slot->word) != 0)) {
+				j = (j + 1) & mask;
+			}
+			if (!table2->slots[j].word
+					|| (table2->slots[j].count != slot->count)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Counts the input with the given number of workers, either in static
+ * slices or from a chunk queue with chunks of chunk_size bytes (zero
+ * chooses the size automatically), and merges the counts into merged.
+ */
+static void run(const input_data *input, int number_workers, bool queued,
+		size_t chunk_size, word_table *merged, double *max_seconds,
+		double *sum_seconds) {
+	worker_result results[MAX_THREADS];
+	std::vector<std::thread> threads;
+	void *memory = NULL;
+	chunk_queue *queue = NULL;
+
+	if (queued) {
+		memory = aligned_alloc(sizeof(work_deque),
+				chunk_queue_size(number_workers));
+		if (!memory) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		queue = chunk_queue_init(memory, 0, input->length, chunk_size,
+				number_workers);
+	}
+
+	for (int i = 0; i < number_workers; i++) {
+		if (word_table_init(&results[i].table, 0) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (int i = 0; i < number_workers; i++) {
+		if (queued) {
+			threads.emplace_back(count_queue, input, queue, i, &results[i]);
+		} else {
+			threads.emplace_back(count_slice, input, i, number_workers,
+					&results[i]);
+		}
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	collect(results, number_workers, merged, max_seconds, sum_seconds);
+	free(memory);
+}
+
+int main(int argc, char *argv[]) {
+	size_t mib = DEFAULT_MIB;
+	int default_threads[] = { 2, 4, 8 };
+	int *threads = default_threads;
+	int number_threads = 3;
+	input_data input;
+	char *buffer;
+	word_table expected;
+	double max_seconds, sum_seconds;
+	int error = 0;
+
+	if (argc > 1) {
+		mib = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		threads = (int *) malloc((argc - 2) * sizeof(int));
+		number_threads = argc - 2;
+		for (int i = 2; i < argc; i++) {
+			threads[i - 2] = atoi(argv[i]);
+			if ((threads[i - 2] < 1) || (threads[i - 2] > MAX_THREADS)) {
+				fprintf(stderr, "The number of threads must be between 1 and %d!\n",
+						MAX_THREADS);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	buffer = (char *) malloc(mib * 1024 * 1024);
+	if (!buffer) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	generate_skewed(buffer, mib * 1024 * 1024);
+	input.data = buffer;
+	input.length = mib * 1024 * 1024;
+	input.mapped = 0;
+
+	if (word_table_init(&expected, 0) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	run(&input, 1, false, 0, &expected, &max_seconds, &sum_seconds);
+
+	printf("%-8s %-10s %12s %12s %10s %10s %8s\n", "threads", "schedule",
+			"busiest s", "total s", "imbalance", "MB/s", "check");
+
+	for (int t = 0; t < number_threads; t++) {
+		for (int queued = 0; queued < 2; queued++) {
+			word_table counts;
+			bool check;
+
+			if (word_table_init(&counts, 0) != EXIT_SUCCESS) {
+				fprintf(stderr, "Not enough memory!\n");
+				exit(EXIT_FAILURE);
+			}
+			run(&input, threads[t], queued, 0, &counts, &max_seconds,
+					&sum_seconds);
+			check = same_counts(&expected, &counts);
+			if (!check) {
+				error = 1;
+			}
+			word_table_free(&counts);
+
+			/*
+			 * imbalance is the busiest worker's time relative to a fair
+			 * share, and the throughput is the one of the critical path
+			 */
+			printf("%-8d %-10s %12.3f %12.3f %9.2fx %10.1f %8s\n", threads[t],
+					queued ? "stealing" : "static", max_seconds, sum_seconds,
+					max_seconds * threads[t] / sum_seconds,
+					input.length / max_seconds / 1e6, check ? "ok" : "FAILED");
+		}
+	}
+
+	// tiny chunks exercise the word boundaries and stealing heavily
+	{
+		word_table counts;
+		size_t length = input.length;
+		bool check;
+
+		input.length = (length < 4 * 1024 * 1024) ? length : 4 * 1024 * 1024;
+		word_table_free(&expected);
+		if ((word_table_init(&expected, 0) != EXIT_SUCCESS)
+				|| (word_table_init(&counts, 0) != EXIT_SUCCESS)) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		run(&input, 1, false, 0, &expected, &max_seconds, &sum_seconds);
+		run(&input, 4, true, TINY_CHUNK_SIZE, &counts, &max_seconds,
+				&sum_seconds);
+		check = same_counts(&expected, &counts);
+		if (!check) {
+			error = 1;
+		}
+		printf("tiny chunks of %d bytes: %s\n", TINY_CHUNK_SIZE,
+				check ? "ok" : "FAILED");
+		word_table_free(&counts);
+		input.length = length;
+	}
+
+	word_table_free(&expected);
+	free(buffer);
+	if (threads != default_threads) {
+		free(threads);
+	}
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
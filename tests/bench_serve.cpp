@@ -0,0 +1,340 @@
+/*
+ * bench_serve.cpp
+ *
+ * Compares the latency of count jobs which a warm wfc server answers over
+ * its Unix domain socket to the latency of cold runs of wfc, which start
+ * a process and its workers for each job, and checks that both count the
+ * same words.
+ * The jobs count a generated text file, once by its path and once by
+ * sending its bytes.
+ * Run it from the directory of wfc.
+ *
+ * Usage: bench_serve [<KiB> [<jobs> [<workers>]]]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "serve.h"
+
+#define DEFAULT_KIB 1024
+#define DEFAULT_JOBS 50
+#define DEFAULT_WORKERS 4
+#define WFC "./wfc"
+
+/**
+ * Writes the given number of bytes of the corpus of gen_corpus to the
+ * given file.
+ */
+static void generate_file(const char *fname, size_t length) {
+	FILE *file = fopen(fname, "w");
+	char *text = (char *) malloc(length);
+
+	if (!file) {
+		perror("fopen");
+		exit(EXIT_FAILURE);
+	}
+	if (!text) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	generate_text(text, length, 0);
+	if ((fwrite(text, 1, length, file) != length) || (fclose(file) != 0)) {
+		perror("fwrite");
+		exit(EXIT_FAILURE);
+	}
+	free(text);
+}
+
+/**
+ * Reads the whole file into a string.
+ */
+static std::string read_file(const char *fname) {
+	std::string content;
+	char buffer[65536];
+	size_t received;
+	FILE *file = fopen(fname, "r");
+
+	if (!file) {
+		perror("fopen");
+		exit(EXIT_FAILURE);
+	}
+	while ((received = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		content.append(buffer, received);
+	}
+	fclose(file);
+
+	return content;
+}
+
+/**
+ * Starts the server on the given socket and connects to it.
+ * Returns the socket of the connection.
+ */
+static int start_server(const char *socketfname, const char *workers,
+		pid_t *server) {
+	struct sockaddr_un address;
+
+	*server = fork();
+	if (*server < 0) {
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (*server == 0) {
+		int null = open("/dev/null", O_WRONLY);
+
+		dup2(null, STDOUT_FILENO);
+		execl(WFC, WFC, "--serve", socketfname, "-p", workers, (char *) NULL);
+		perror("execl");
+		_exit(EXIT_FAILURE);
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socketfname, sizeof(address.sun_path) - 1);
+
+	// the server creates the socket after it has started
+	for (int attempt = 0; attempt < 1000; attempt++) {
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (fd < 0) {
+			perror("socket");
+			exit(EXIT_FAILURE);
+		}
+		if (connect(fd, (struct sockaddr *) &address, sizeof(address)) == 0) {
+			return fd;
+		}
+		close(fd);
+		usleep(10000);
+	}
+
+	fprintf(stderr, "Could not connect to the server!\n");
+	kill(*server, SIGTERM);
+	exit(EXIT_FAILURE);
+}
+
+static void send_fully(int fd, const char *data, size_t length) {
+	while (length > 0) {
+		ssize_t sent = write(fd, data, length);
+
+		if (sent <= 0) {
+			perror("write");
+			exit(EXIT_FAILURE);
+		}
+		data += sent;
+		length -= sent;
+	}
+}
+
+/**
+ * Receives a response of the server and returns its words in the format
+ * of the output file of wfc, or "ERROR" if the server failed.
+ * pending holds bytes which were received beyond the last response.
+ */
+static std::string receive(int fd, std::string *pending) {
+	std::string &buffer = *pending;
+	size_t newline, words, end;
+	char chunk[65536];
+
+	for (;;) {
+		newline = buffer.find('\n');
+		if (newline != std::string::npos) {
+			break;
+		}
+
+		ssize_t received = read(fd, chunk, sizeof(chunk));
+
+		if (received <= 0) {
+			fprintf(stderr, "The server closed the connection!\n");
+			exit(EXIT_FAILURE);
+		}
+		buffer.append(chunk, received);
+	}
+
+	if (buffer.compare(0, 3, "OK ") != 0) {
+		buffer.erase(0, newline + 1);
+		return "ERROR";
+	}
+
+	words = strtoull(buffer.c_str() + 3, NULL, 10);
+	end = newline + 1;
+	for (size_t i = 0; i < words; i++) {
+		size_t next;
+
+		while ((next = buffer.find('\n', end)) == std::string::npos) {
+			ssize_t received = read(fd, chunk, sizeof(chunk));
+
+			if (received <= 0) {
+				fprintf(stderr, "The server closed the connection!\n");
+				exit(EXIT_FAILURE);
+			}
+			buffer.append(chunk, received);
+		}
+		end = next + 1;
+	}
+
+	std::string body = buffer.substr(newline + 1, end - newline - 1);
+	buffer.erase(0, end);
+
+	return body;
+}
+
+/**
+ * Runs wfc on the given file, waits for it, and returns its output.
+ */
+static std::string run_cold(const char *fname, const char *outputfname,
+		const char *workers) {
+	pid_t pid = fork();
+	int status;
+
+	if (pid < 0) {
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		int null = open("/dev/null", O_WRONLY);
+
+		dup2(null, STDOUT_FILENO);
+		execl(WFC, WFC, "-i", fname, "-o", outputfname, "-p", workers,
+				(char *) NULL);
+		perror("execl");
+		_exit(EXIT_FAILURE);
+	}
+
+	if ((waitpid(pid, &status, 0) < 0) || !WIFEXITED(status)
+			|| (WEXITSTATUS(status) != EXIT_SUCCESS)) {
+		fprintf(stderr, "wfc failed!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return read_file(outputfname);
+}
+
+/**
+ * Prints the median, 99th percentile, and mean of the given latencies.
+ */
+static void report(const char *name, std::vector<double> latencies,
+		bool check) {
+	double sum = 0;
+
+	std::sort(latencies.begin(), latencies.end());
+	for (double latency : latencies) {
+		sum += latency;
+	}
+
+	printf("%-10s %10.3f %10.3f %10.3f %8s\n", name,
+			1e3 * latencies[latencies.size() / 2],
+			1e3 * latencies[(latencies.size() * 99) / 100],
+			1e3 * sum / latencies.size(), check ? "ok" : "FAILED");
+}
+
+int main(int argc, char *argv[]) {
+	size_t kib = DEFAULT_KIB;
+	int jobs = DEFAULT_JOBS;
+	char workers[16];
+	char directory[] = "/tmp/bench_serve.XXXXXX";
+	std::string socketfname, fname, outputfname;
+	std::string content, expected, request, pending;
+	std::vector<double> cold, file, data;
+	bool cold_check = true, file_check = true, data_check = true;
+	pid_t server;
+	int status;
+	int fd;
+
+	snprintf(workers, sizeof(workers), "%d", DEFAULT_WORKERS);
+	if (argc > 1) {
+		kib = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		jobs = atoi(argv[2]);
+	}
+	if (argc > 3) {
+		snprintf(workers, sizeof(workers), "%d", atoi(argv[3]));
+	}
+	if (jobs < 1) {
+		fprintf(stderr, "The number of jobs must be positive!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!mkdtemp(directory)) {
+		perror("mkdtemp");
+		exit(EXIT_FAILURE);
+	}
+	socketfname = std::string(directory) + "/wfc.sock";
+	fname = std::string(directory) + "/input.txt";
+	outputfname = std::string(directory) + "/output.txt";
+
+	generate_file(fname.c_str(), kib * 1024);
+	content = read_file(fname.c_str());
+
+	for (int i = 0; i < jobs; i++) {
+		double start = now();
+		std::string words = run_cold(fname.c_str(), outputfname.c_str(),
+				workers);
+
+		cold.push_back(now() - start);
+		if (i == 0) {
+			expected = words;
+		} else if (words != expected) {
+			cold_check = false;
+		}
+	}
+
+	fd = start_server(socketfname.c_str(), workers, &server);
+
+	request = std::string(SERVE_REQUEST_FILE) + " 0 " + fname + "\n";
+	for (int i = 0; i < jobs; i++) {
+		double start = now();
+
+		send_fully(fd, request.data(), request.length());
+		if (receive(fd, &pending) != expected) {
+			file_check = false;
+		}
+		file.push_back(now() - start);
+	}
+
+	request = std::string(SERVE_REQUEST_DATA) + " 0 "
+			+ std::to_string(content.length()) + "\n";
+	for (int i = 0; i < jobs; i++) {
+		double start = now();
+
+		send_fully(fd, request.data(), request.length());
+		send_fully(fd, content.data(), content.length());
+		if (receive(fd, &pending) != expected) {
+			data_check = false;
+		}
+		data.push_back(now() - start);
+	}
+
+	request = std::string(SERVE_REQUEST_QUIT) + "\n";
+	send_fully(fd, request.data(), request.length());
+	receive(fd, &pending);
+	close(fd);
+	waitpid(server, &status, 0);
+
+	printf("%zu KiB, %d jobs, %s workers\n", kib, jobs, workers);
+	printf("%-10s %10s %10s %10s %8s\n", "job", "p50 ms", "p99 ms", "mean ms",
+			"check");
+	report("cold", cold, cold_check);
+	report("warm file", file, file_check);
+	report("warm data", data, data_check);
+
+	unlink(fname.c_str());
+	unlink(outputfname.c_str());
+	rmdir(directory);
+
+	return (cold_check && file_check && data_check) ? EXIT_SUCCESS
+			: EXIT_FAILURE;
+}
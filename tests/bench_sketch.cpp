@@ -0,0 +1,261 @@
+/*
+ * bench_sketch.cpp
+ *
+ * Compares counting the top words of the corpus of gen_corpus, whose
+ * words follow Zipf's law, exactly with word tables to counting them
+ * approximately with the sketches of wfc --approximate for several memory
+ * budgets per thread.
+ * The words are drawn from a vocabulary of VOCABULARY words.
+ * Each thread counts a slice of the words and the tables or sketches of
+ * the threads are merged, as in wfc.
+ * The recall of the approximate top words and their largest error are
+ * reported, and the benchmark checks that no count is too low and that
+ * the errors stay within the bounds which the sketch reports.
+ *
+ * Usage: bench_sketch [<million tokens> [<threads> [<top words>]]]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "ranking.h"
+#include "sketch.h"
+#include "word_table.h"
+
+#define DEFAULT_MILLION_TOKENS 16
+#define DEFAULT_THREADS 4
+#define DEFAULT_TOP_WORDS 100
+#define VOCABULARY (1 << 20)
+
+/**
+ * Counts the given tokens exactly in table.
+ */
+static void count_exact(const bench_corpus *c, const uint32_t *tokens,
+		size_t number_tokens, word_table *table) {
+	for (size_t i = 0; i < number_tokens; i++) {
+		if (word_table_add(table, c->words[tokens[i]], c->lengths[tokens[i]],
+				1) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * Counts the given tokens approximately in sketch.
+ */
+static void count_sketch(const bench_corpus *c, const uint32_t *tokens,
+		size_t number_tokens, heavy_hitters *sketch) {
+	for (size_t i = 0; i < number_tokens; i++) {
+		if (heavy_hitters_add(sketch, c->words[tokens[i]],
+				c->lengths[tokens[i]], 0) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * Returns the count of the given word in table, which is zero if the word
+ * is not in it.
+ */
+static uint64_t table_count(const word_table *table, const char *word) {
+	const word_table_slot *slot = word_table_find(table, word, strlen(word));
+
+	return slot ? slot->count : 0;
+}
+
+int main(int argc, char *argv[]) {
+	const size_t budgets[] = { 64 * 1024, 256 * 1024, 1024 * 1024 };
+	size_t number_tokens = (size_t) DEFAULT_MILLION_TOKENS * 1000000;
+	int number_threads = DEFAULT_THREADS;
+	size_t top_k = DEFAULT_TOP_WORDS;
+	bench_corpus c;
+	uint32_t *tokens;
+	std::vector<word_table> tables;
+	std::vector<std::thread> threads;
+	word_table top;
+	std::vector<word_count> exact;
+	double start, seconds;
+	int error = 0;
+
+	if (argc > 1) {
+		number_tokens = strtoul(argv[1], NULL, 10) * 1000000;
+	}
+	if (argc > 2) {
+		number_threads = atoi(argv[2]);
+		if (number_threads < 1) {
+			fprintf(stderr, "The number of threads must be positive!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (argc > 3) {
+		top_k = strtoul(argv[3], NULL, 10);
+		if (top_k < 1) {
+			fprintf(stderr, "The number of top words must be positive!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	tokens = (uint32_t *) malloc(number_tokens * sizeof(uint32_t));
+	if (!tokens) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	bench_corpus_init(&c, CORPUS_SEED, VOCABULARY, CORPUS_SKEW,
+			CORPUS_MEAN_LENGTH, 0);
+	bench_corpus_tokens(&c, tokens, number_tokens);
+
+	printf("%-12s %12s %10s %10s %8s %10s %10s %8s\n", "budget", "words held",
+			"seconds", "Mtokens/s", "recall", "error", "bound", "check");
+
+	// exact counts, which the sketches are checked against
+	tables.resize(number_threads);
+	start = now();
+	for (int i = 0; i < number_threads; i++) {
+		size_t begin = number_tokens / number_threads * i;
+		size_t end = (i == number_threads - 1) ?
+				number_tokens : number_tokens / number_threads * (i + 1);
+
+		if (word_table_init(&tables[i], 0) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		threads.emplace_back(count_exact, &c, tokens + begin, end - begin,
+				&tables[i]);
+	}
+	for (int i = 0; i < number_threads; i++) {
+		threads[i].join();
+		if ((i > 0) && (word_table_merge(&tables[0], &tables[i])
+				!= EXIT_SUCCESS)) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	exact.resize(top_k);
+	exact.resize(top_k_table(&tables[0], top_k, exact.data()));
+	seconds = now() - start;
+
+	if (word_table_init(&top, top_k) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	for (const word_count &wc : exact) {
+		if (word_table_add(&top, wc.word, strlen(wc.word), 1)
+				!= EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	printf("%-12s %12zu %10.3f %10.1f %8s %10s %10s %8s\n", "exact",
+			tables[0].size, seconds, number_tokens / seconds / 1e6, "1.000",
+			"0", "-", "ok");
+
+	for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+		std::vector<heavy_hitters> sketches(number_threads);
+		std::vector<word_count> approximate;
+		heavy_hitters_bounds bounds;
+		size_t found = 0;
+		uint64_t max_error = 0;
+		bool check = true;
+		char name[32];
+
+		if (heavy_hitters_capacity(budgets[b]) < top_k) {
+			continue;
+		}
+
+		threads.clear();
+		start = now();
+		for (int i = 0; i < number_threads; i++) {
+			size_t begin = number_tokens / number_threads * i;
+			size_t end = (i == number_threads - 1) ?
+					number_tokens : number_tokens / number_threads * (i + 1);
+
+			if (heavy_hitters_init(&sketches[i], budgets[b]) != EXIT_SUCCESS) {
+				fprintf(stderr, "Not enough memory!\n");
+				exit(EXIT_FAILURE);
+			}
+			threads.emplace_back(count_sketch, &c, tokens + begin,
+					end - begin, &sketches[i]);
+		}
+		for (int i = 0; i < number_threads; i++) {
+			threads[i].join();
+			if ((i > 0) && (heavy_hitters_merge(&sketches[0], &sketches[i])
+					!= EXIT_SUCCESS)) {
+				fprintf(stderr, "Not enough memory!\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		approximate.resize(sketches[0].capacity);
+		approximate.resize(heavy_hitters_words(&sketches[0],
+				approximate.data()));
+		approximate.resize(top_k_words(approximate.data(), approximate.size(),
+				top_k));
+		seconds = now() - start;
+		heavy_hitters_bounds_of(&sketches[0], top_k, &bounds);
+
+		// counts may only be too high, and by at most the bound
+		for (const word_count &wc : approximate) {
+			uint64_t count = table_count(&tables[0], wc.word);
+
+			if (table_count(&top, wc.word)) {
+				found++;
+			}
+			if ((wc.count < count) || (wc.count - count > bounds.max_error)) {
+				check = false;
+			}
+			max_error = std::max(max_error, wc.count - count);
+		}
+
+		// and the words which are not counted are rare
+		for (const word_count &wc : exact) {
+			size_t length = strlen(wc.word);
+			bool monitored = false;
+
+			for (size_t i = 0; i < sketches[0].size; i++) {
+				const sketch_entry *entry = &sketches[0].entries[i];
+
+				if ((entry->length == length)
+						&& (memcmp(entry->word, wc.word, length) == 0)) {
+					monitored = true;
+					break;
+				}
+			}
+			if (!monitored && ((uint64_t) wc.count > bounds.missing_bound)) {
+				check = false;
+			}
+		}
+		if (!check) {
+			error = 1;
+		}
+
+		snprintf(name, sizeof(name), "%zuk x %d", budgets[b] / 1024,
+				number_threads);
+		printf("%-12s %12zu %10.3f %10.1f %8.3f %10llu %10llu %8s\n", name,
+				sketches[0].capacity * number_threads, seconds,
+				number_tokens / seconds / 1e6,
+				(double) found / std::max(exact.size(), (size_t) 1),
+				(unsigned long long) max_error,
+				(unsigned long long) bounds.max_error, check ? "ok" : "FAILED");
+
+		for (int i = 0; i < number_threads; i++) {
+			heavy_hitters_free(&sketches[i]);
+		}
+	}
+
+	// the exact top words point into the tables
+	for (int i = 0; i < number_threads; i++) {
+		word_table_free(&tables[i]);
+	}
+	word_table_free(&top);
+	bench_corpus_free(&c);
+	free(tokens);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/*
+ * bench_table.cpp
+ *
+ * Compares counting words with the strcmp-ordered std::map, which wfc
+ * used formerly, to counting them with the word table.
+ *
+ * Usage: bench_table [<tokens> [<vocabulary size> ...]]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include "bench.h"
+#include "word_table.h"
+
+#define DEFAULT_TOKENS 4000000
+
+static bool cmp_str(const char *lhs, const char *rhs) {
+	return (strcmp(lhs, rhs) < 0);
+}
+
+/**
+ * Fills buffer with tokens null-terminated words which are drawn from a
+ * vocabulary of the given size.
+ * Returns the offsets of the tokens in buffer.
+ */
+static size_t *make_tokens(char **buffer, size_t tokens, size_t vocabulary) {
+	char *words = (char *) malloc(vocabulary * 16);
+	size_t *offsets = (size_t *) malloc(tokens * sizeof(size_t));
+	char *out = (char *) malloc(tokens * 16);
+	size_t position = 0;
+
+	if (!words || !offsets || !out) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	srand(42);
+	for (size_t i = 0; i < vocabulary; i++) {
+		char *word = words + i * 16;
+		int length = 3 + rand() % 12;
+
+		for (int j = 0; j < length; j++) {
+			word[j] = 'a' + rand() % 26;
+		}
+		word[length] = 0;
+	}
+
+	for (size_t i = 0; i < tokens; i++) {
+		// square the random number to skew the distribution to few words
+		double r = (double) rand() / RAND_MAX;
+		const char *word = words + (size_t) (r * r * (vocabulary - 1)) * 16;
+		size_t length = strlen(word) + 1;
+
+		offsets[i] = position;
+		memcpy(out + position, word, length);
+		position += length;
+	}
+
+	free(words);
+	*buffer = out;
+	return offsets;
+}
+
+/**
+ * Checks that words which differ in the case of their letters, within and
+ * beyond ASCII, are counted as one folded word.
+ * Exits if they are not.
+ */
+static void check_fold(void) {
+	const char *words[] = { "\xc3\x89T\xc3\x89", "\xc3\xa9t\xc3\xa9",
+			"\xd0\x9c\xd0\x98\xd0\xa0", "\xd0\xbc\xd0\xb8\xd1\x80",
+			"\xce\x86\xce\x9b\xce\xa6\xce\x91LONGER",
+			"\xce\xac\xce\xbb\xcf\x86\xce\xb1longer",
+			"\xc5\x81\xc3\x93" "D\xc5\xb9", "\xc5\x82\xc3\xb3" "d\xc5\xba",
+			"ab\xe1\x82\xa0\xe1\x82\xa1" "cdefg",
+			"ab\xe2\xb4\x80\xe2\xb4\x81" "cdefg" };
+	word_table table;
+	int equal = 1;
+
+	word_table_init(&table, 0);
+	for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+		word_table_add_folded(&table, words[i], strlen(words[i]), 1);
+	}
+	for (size_t i = 1; i < sizeof(words) / sizeof(words[0]); i += 2) {
+		const word_table_slot *slot = word_table_find(&table, words[i],
+				strlen(words[i]));
+
+		equal = equal && slot && (slot->count == 2);
+	}
+
+	if ((table.size != sizeof(words) / sizeof(words[0]) / 2) || !equal) {
+		fprintf(stderr, "Folded words differ!\n");
+		exit(EXIT_FAILURE);
+	}
+	word_table_free(&table);
+}
+
+int main(int argc, char *argv[]) {
+	size_t tokens = DEFAULT_TOKENS;
+	size_t default_vocabularies[] = { 1000, 100000, 1000000 };
+	size_t *vocabularies = default_vocabularies;
+	int number_vocabularies = 3;
+
+	if (argc > 1) {
+		tokens = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		vocabularies = (size_t *) malloc((argc - 2) * sizeof(size_t));
+		number_vocabularies = argc - 2;
+		for (int i = 2; i < argc; i++) {
+			vocabularies[i - 2] = strtoul(argv[i], NULL, 10);
+		}
+	}
+
+	check_fold();
+
+	printf("%-12s %-12s %-12s %12s %12s %8s\n", "tokens", "vocabulary",
+			"distinct", "map Mtok/s", "table Mtok/s", "speedup");
+
+	for (int v = 0; v < number_vocabularies; v++) {
+		char *buffer = NULL;
+		size_t *offsets = make_tokens(&buffer, tokens, vocabularies[v]);
+		double start, map_seconds, table_seconds;
+		size_t distinct;
+
+		{
+			std::map<const char *, int, bool (*)(const char *, const char *)> map(
+					cmp_str);
+
+			start = now();
+			for (size_t i = 0; i < tokens; i++) {
+				map[buffer + offsets[i]]++;
+			}
+			map_seconds = now() - start;
+			distinct = map.size();
+		}
+
+		{
+			word_table table;
+
+			start = now();
+			word_table_init(&table, 0);
+			for (size_t i = 0; i < tokens; i++) {
+				const char *word = buffer + offsets[i];
+
+				word_table_add(&table, word, strlen(word), 1);
+			}
+			table_seconds = now() - start;
+
+			if (table.size != distinct) {
+				fprintf(stderr, "Distinct words differ: %zu != %zu\n",
+						table.size, distinct);
+				exit(EXIT_FAILURE);
+			}
+			word_table_free(&table);
+		}
+
+		printf("%-12zu %-12zu %-12zu %12.2f %12.2f %7.2fx\n", tokens,
+				vocabularies[v], distinct, tokens / map_seconds / 1e6,
+				tokens / table_seconds / 1e6, map_seconds / table_seconds);
+
+		free(offsets);
+		free(buffer);
+	}
+
+	return EXIT_SUCCESS;
+}
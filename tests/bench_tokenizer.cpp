@@ -0,0 +1,200 @@
+/*
+ * bench_tokenizer.cpp
+ *
+ * Measures the throughput of the tokenizer kernels, with and without UTF-8
+ * mode, and checks that they find the same words as the scalar kernel.
+ *
+ * Usage: bench_tokenizer [<input file>]
+ * Without an input file, 64 MiB of generated text are tokenized.
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "input.h"
+#include "tokenizer.h"
+#include "utf8.h"
+
+#define GENERATED_LENGTH (64 * 1024 * 1024)
+#define RANDOM_LENGTH (1024 * 1024)
+#define REPETITIONS 5
+
+/**
+ * Tokenizes the whole buffer with the selected kernel.
+ * Returns the number of words and stores their total length in characters.
+ */
+static size_t tokenize(const char *buffer, size_t length, size_t *characters) {
+	size_t words = 0;
+	size_t position = seek_next_nonskip(buffer, 0, length);
+
+	*characters = 0;
+	while (position < length) {
+		size_t end = seek_next_skip(buffer, position, length);
+
+		words++;
+		*characters += end - position;
+		position = seek_next_nonskip(buffer, end, length);
+	}
+
+	return words;
+}
+
+/**
+ * Returns the number of bytes of the word character at buffer[offset], or
+ * zero if it is skippable, by the scalar definitions of the tokenizer.
+ */
+static size_t word_char_length(const char *buffer, size_t offset,
+		size_t length, int utf8) {
+	if (!utf8 || !(buffer[offset] & 0x80)) {
+		return !isskip(buffer[offset]);
+	}
+
+	return utf8_letter_length(buffer, offset, length);
+}
+
+/**
+ * Compares the selected kernel to the scalar definition of the word
+ * characters at every offset of a buffer of random bytes, which contains
+ * multibyte letters, too.
+ */
+static int check_random_bytes(int utf8) {
+	static const char *const letters[] = { "\xc3\xa9", "\xd0\xb6",
+			"\xe4\xb8\x80", "\xf0\x90\x90\x80", "\xcc\x81" };
+	char *buffer = (char *) malloc(RANDOM_LENGTH);
+	size_t i = 0;
+
+	if (!buffer) {
+		return EXIT_FAILURE;
+	}
+
+	srand(7);
+	while (i < RANDOM_LENGTH) {
+		int choice = rand() % 4;
+
+		// favor word characters, so that words of all lengths occur
+		if (choice < 2) {
+			buffer[i++] = 'a' + rand() % 26;
+		} else if (choice == 2) {
+			buffer[i++] = (char) rand();
+		} else {
+			const char *letter = letters[rand()
+					% (sizeof(letters) / sizeof(letters[0]))];
+
+			for (size_t j = 0; letter[j] && (i < RANDOM_LENGTH); j++) {
+				buffer[i++] = letter[j];
+			}
+		}
+	}
+
+	for (i = 0; i < RANDOM_LENGTH; i++) {
+		size_t skip = i;
+		size_t nonskip = i;
+		size_t char_length;
+
+		while ((skip < RANDOM_LENGTH) && (char_length = word_char_length(
+				buffer, skip, RANDOM_LENGTH, utf8))) {
+			skip += char_length;
+		}
+		while ((nonskip < RANDOM_LENGTH)
+				&& !word_char_length(buffer, nonskip, RANDOM_LENGTH, utf8)) {
+			nonskip++;
+		}
+
+		if ((seek_next_skip(buffer, i, RANDOM_LENGTH) != skip)
+				|| (seek_next_nonskip(buffer, i, RANDOM_LENGTH) != nonskip)) {
+			free(buffer);
+			return EXIT_FAILURE;
+		}
+	}
+
+	free(buffer);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+	const tokenizer_kernel kernels[] = { TOKENIZER_SCALAR, TOKENIZER_SSE2,
+			TOKENIZER_AVX2 };
+	input_data input;
+	char *generated = NULL;
+	const char *buffer;
+	size_t length;
+	size_t expected_words = 0;
+	size_t expected_characters = 0;
+	int error = 0;
+
+	if (argc > 1) {
+		if (input_open(argv[1], &input) != EXIT_SUCCESS) {
+			exit(EXIT_FAILURE);
+		}
+		buffer = input.data;
+		length = input.length;
+	} else {
+		generated = (char *) malloc(GENERATED_LENGTH);
+		if (!generated) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		generate_text(generated, GENERATED_LENGTH, 0);
+		buffer = generated;
+		length = GENERATED_LENGTH;
+	}
+
+	printf("%-8s %-6s %12s %12s %8s\n", "kernel", "utf8", "words", "GB/s",
+			"check");
+
+	for (int utf8 = 0; utf8 < 2; utf8++) {
+		tokenizer_set_utf8(utf8);
+
+		for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+			double best = 0;
+			size_t words = 0;
+			size_t characters = 0;
+			int check;
+
+			if (tokenizer_select(kernels[k]) != EXIT_SUCCESS) {
+				printf("%-8s %-6s %12s\n", tokenizer_kernel_name(kernels[k]),
+						utf8 ? "yes" : "no", "unsupported");
+				continue;
+			}
+
+			for (int r = 0; r < REPETITIONS; r++) {
+				double start = now();
+				double seconds;
+
+				words = tokenize(buffer, length, &characters);
+				seconds = now() - start;
+				if ((best == 0) || (seconds < best)) {
+					best = seconds;
+				}
+			}
+
+			// the scalar kernel is the reference of each mode
+			if (k == 0) {
+				expected_words = words;
+				expected_characters = characters;
+			}
+
+			check = (words == expected_words)
+					&& (characters == expected_characters)
+					&& (check_random_bytes(utf8) == EXIT_SUCCESS);
+			if (!check) {
+				error = 1;
+			}
+
+			printf("%-8s %-6s %12zu %12.3f %8s\n",
+					tokenizer_kernel_name(kernels[k]), utf8 ? "yes" : "no",
+					words, length / best / 1e9, check ? "ok" : "FAILED");
+		}
+	}
+
+	if (generated) {
+		free(generated);
+	} else {
+		input_close(&input);
+	}
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+/*
+ * bench_vocabulary.cpp
+ *
+ * Compares counting the words of the corpus of gen_corpus, whose words
+ * follow Zipf's law, in word tables to counting them in the dense counts
+ * of the vocabulary engine of wfc --vocab, and merging the counters of
+ * several threads with word_table_merge to adding the arrays.
+ * The vocabulary consists of the most frequent half of the words which the
+ * corpus draws from, so that the rare words are outside of it, as in new
+ * data.
+ * The benchmark checks that both count the same words, and reports the
+ * time to build the perfect hash of the vocabulary.
+ *
+ * Usage: bench_vocabulary [<vocabulary size> [<million tokens> [<threads>]]]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "vocabulary.h"
+#include "word_table.h"
+
+#define DEFAULT_VOCABULARY 300000
+#define DEFAULT_MILLION_TOKENS 16
+#define DEFAULT_THREADS 4
+
+/**
+ * Counts the given tokens in table.
+ */
+static void count_table(const bench_corpus *c, const uint32_t *tokens,
+		size_t number_tokens, word_table *table) {
+	for (size_t i = 0; i < number_tokens; i++) {
+		if (word_table_add(table, c->words[tokens[i]], c->lengths[tokens[i]],
+				1) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * Counts the given tokens in the counts of a vocabulary.
+ */
+static void count_vocabulary(const bench_corpus *c, const uint32_t *tokens,
+		size_t number_tokens, vocabulary_counts *counts) {
+	for (size_t i = 0; i < number_tokens; i++) {
+		if (vocabulary_counts_add(counts, c->words[tokens[i]],
+				c->lengths[tokens[i]], 0) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * Returns true, iff the given counts hold the same words with the same
+ * counts as table.
+ */
+static bool same_counts(const vocabulary_counts *counts,
+		const word_table *table) {
+	size_t number_words = 0;
+
+	for (size_t i = 0; i < table->capacity; i++) {
+		const word_table_slot *slot = &table->slots[i];
+		size_t id;
+		uint64_t count;
+
+		if (!slot->word) {
+			continue;
+		}
+
+		id = vocabulary_find(counts->vocab, slot->word, slot->length, 0);
+		if (id != VOCABULARY_MISSING) {
+			count = counts->counts[id];
+		} else {
+			const word_table_slot *overflow = word_table_find(
+					&counts->overflow, slot->word, slot->length);
+
+			count = overflow ? overflow->count : 0;
+		}
+		if (count != slot->count) {
+			return false;
+		}
+		number_words++;
+	}
+
+	return number_words == vocabulary_counts_size(counts);
+}
+
+int main(int argc, char *argv[]) {
+	size_t vocabulary_size = DEFAULT_VOCABULARY;
+	size_t number_tokens = (size_t) DEFAULT_MILLION_TOKENS * 1000000;
+	int number_threads = DEFAULT_THREADS;
+	bench_corpus c;
+	char *text;
+	size_t text_length = 0;
+	uint32_t *tokens;
+	vocabulary vocab;
+	std::vector<word_table> tables;
+	std::vector<vocabulary_counts> counters;
+	std::vector<std::thread> threads;
+	double start, count_seconds, merge_seconds;
+	bool check;
+
+	if (argc > 1) {
+		vocabulary_size = strtoul(argv[1], NULL, 10);
+		if (vocabulary_size < 1) {
+			fprintf(stderr, "The vocabulary must not be empty!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (argc > 2) {
+		number_tokens = strtoul(argv[2], NULL, 10) * 1000000;
+	}
+	if (argc > 3) {
+		number_threads = atoi(argv[3]);
+		if (number_threads < 1) {
+			fprintf(stderr, "The number of threads must be positive!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// the words of the ranks after the vocabulary are outside of it
+	bench_corpus_init(&c, CORPUS_SEED, 2 * vocabulary_size, CORPUS_SKEW,
+			CORPUS_MEAN_LENGTH, 0);
+	for (size_t i = 0; i < vocabulary_size; i++) {
+		text_length += c.lengths[i] + 1;
+	}
+	text = (char *) malloc(text_length);
+	tokens = (uint32_t *) malloc(number_tokens * sizeof(uint32_t));
+	if (!text || !tokens) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	bench_corpus_tokens(&c, tokens, number_tokens);
+	text_length = 0;
+	for (size_t i = 0; i < vocabulary_size; i++) {
+		memcpy(text + text_length, c.words[i], c.lengths[i]);
+		text_length += c.lengths[i];
+		text[text_length++] = '\n';
+	}
+
+	start = now();
+	if (vocabulary_build(&vocab, text, text_length, 0) != EXIT_SUCCESS) {
+		exit(EXIT_FAILURE);
+	}
+	printf("Perfect hash of %zu words built in %.3f seconds\n\n", vocab.size,
+			now() - start);
+
+	printf("%-12s %10s %10s %12s %8s\n", "counter", "seconds", "Mtokens/s",
+			"merge ms", "check");
+
+	// word tables
+	tables.resize(number_threads);
+	start = now();
+	for (int i = 0; i < number_threads; i++) {
+		size_t begin = number_tokens / number_threads * i;
+		size_t end = (i == number_threads - 1) ?
+				number_tokens : number_tokens / number_threads * (i + 1);
+
+		if (word_table_init(&tables[i], 0) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		threads.emplace_back(count_table, &c, tokens + begin, end - begin,
+				&tables[i]);
+	}
+	for (int i = 0; i < number_threads; i++) {
+		threads[i].join();
+	}
+	count_seconds = now() - start;
+	start = now();
+	for (int i = 1; i < number_threads; i++) {
+		if (word_table_merge(&tables[0], &tables[i]) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	merge_seconds = now() - start;
+	printf("%-12s %10.3f %10.1f %12.3f %8s\n", "table", count_seconds,
+			number_tokens / count_seconds / 1e6, merge_seconds * 1e3, "ok");
+
+	// dense counts of the vocabulary
+	counters.resize(number_threads);
+	threads.clear();
+	start = now();
+	for (int i = 0; i < number_threads; i++) {
+		size_t begin = number_tokens / number_threads * i;
+		size_t end = (i == number_threads - 1) ?
+				number_tokens : number_tokens / number_threads * (i + 1);
+
+		if (vocabulary_counts_init(&counters[i], &vocab) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+		threads.emplace_back(count_vocabulary, &c, tokens + begin,
+				end - begin, &counters[i]);
+	}
+	for (int i = 0; i < number_threads; i++) {
+		threads[i].join();
+	}
+	count_seconds = now() - start;
+	start = now();
+	for (int i = 1; i < number_threads; i++) {
+		if (vocabulary_counts_merge(&counters[0], &counters[i])
+				!= EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	merge_seconds = now() - start;
+	check = same_counts(&counters[0], &tables[0]);
+	printf("%-12s %10.3f %10.1f %12.3f %8s\n", "vocabulary", count_seconds,
+			number_tokens / count_seconds / 1e6, merge_seconds * 1e3,
+			check ? "ok" : "FAILED");
+
+	for (int i = 0; i < number_threads; i++) {
+		word_table_free(&tables[i]);
+		vocabulary_counts_free(&counters[i]);
+	}
+	vocabulary_free(&vocab);
+	bench_corpus_free(&c);
+	free(text);
+	free(tokens);
+
+	return check ? EXIT_SUCCESS : EXIT_FAILURE;
+}
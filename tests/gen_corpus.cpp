@@ -0,0 +1,156 @@
+/*
+ * gen_corpus.cpp
+ *
+ * Generates a reproducible synthetic corpus for the benchmarks.
+ * The words are drawn from a vocabulary whose frequencies follow Zipf's
+ * law, i.e. the word of rank r occurs with a probability proportional to
+ * 1 / r^skew.
+ * The lengths of the vocabulary words follow a geometric distribution
+ * with the given mean.
+ * The same seed and parameters always yield the same bytes, since the
+ * generator does not depend on the random number generator of the C
+ * library.
+ * The microbenchmarks generate their text with the same generator (see
+ * bench.h).
+ *
+ * Usage: gen_corpus [-s <seed>] [-n <bytes>] [-v <vocabulary size>]
+ *                   [-z <skew>] [-l <mean word length>] [-o <output file>]
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define DEFAULT_BYTES (64 * 1024 * 1024)
+
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * Parses a size with an optional suffix K, M, or G.
+ * Returns zero if the size is invalid.
+ */
+static size_t parse_size(const char *size) {
+	char *end = NULL;
+	unsigned long long bytes = strtoull(size, &end, 10);
+
+	switch (*end) {
+	case 'k':
+	case 'K':
+		bytes <<= 10;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		bytes <<= 20;
+		end++;
+		break;
+	case 'g':
+	case 'G':
+		bytes <<= 30;
+		end++;
+		break;
+	}
+
+	return (*end == 0) ? (size_t) bytes : 0;
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t seed = CORPUS_SEED;
+	size_t bytes = DEFAULT_BYTES;
+	size_t vocabulary = CORPUS_VOCABULARY;
+	double skew = CORPUS_SKEW;
+	double mean = CORPUS_MEAN_LENGTH;
+	const char *outputfname = NULL;
+	FILE *output = stdout;
+	bench_corpus c;
+	char *buffer;
+	size_t used = 0;
+	size_t written = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:n:v:z:l:o:")) != -1) {
+		switch (opt) {
+		case 's':
+			seed = strtoull(optarg, NULL, 10);
+			break;
+
+		case 'n':
+			bytes = parse_size(optarg);
+			break;
+
+		case 'v':
+			vocabulary = strtoul(optarg, NULL, 10);
+			break;
+
+		case 'z':
+			skew = atof(optarg);
+			break;
+
+		case 'l':
+			mean = atof(optarg);
+			break;
+
+		case 'o':
+			outputfname = optarg;
+			break;
+
+		default: /* '?' */
+			vocabulary = 0;
+			break;
+		}
+	}
+
+	if ((vocabulary == 0) || (skew < 0) || (mean < 1)) {
+		fprintf(stderr,
+				"Usage: %s [-s <seed>] [-n <bytes>] [-v <vocabulary size>] [-z <skew>] [-l <mean word length>] [-o <output file>]\n"
+				"The vocabulary size must be positive, the skew must not be negative, and the mean word length must be at least 1.\n",
+				argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	if (outputfname) {
+		output = fopen(outputfname, "w");
+		if (!output) {
+			fprintf(stderr, "Could not open output file!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	bench_corpus_init(&c, seed, vocabulary, skew, mean, 0);
+	buffer = (char *) malloc(OUTPUT_BUFFER_SIZE + CORPUS_MAX_WORD_BYTES);
+	if (!buffer) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	while (written + used < bytes) {
+		used += bench_corpus_next(&c, buffer + used,
+				bytes - written - used);
+
+		if (used >= OUTPUT_BUFFER_SIZE) {
+			if (fwrite(buffer, 1, used, output) != used) {
+				fprintf(stderr, "Could not write output file!\n");
+				exit(EXIT_FAILURE);
+			}
+			written += used;
+			used = 0;
+		}
+	}
+
+	if ((fwrite(buffer, 1, used, output) != used) || (fflush(output) != 0)) {
+		fprintf(stderr, "Could not write output file!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (output != stdout) {
+		fclose(output);
+	}
+	free(buffer);
+	bench_corpus_free(&c);
+
+	return EXIT_SUCCESS;
+}
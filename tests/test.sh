@@ -1,5 +1,47 @@
 #!/bin/bash
 
+# generate the input files with the corpus generator if they are missing
+for size in 10kB:10K 1MB:1M 100MB:100M
+do
+  if [ ! -f file_${size%%:*}.txt ]
+  then
+    tests/gen_corpus -n ${size##*:} -o file_${size%%:*}.txt || exit 1
+  fi
+done
+
+echo "Partial counts"
+
+# the merged ranges of a file must count its words like a single run
+./wfc -i file_1MB.txt -o out_1MB.txt > /dev/null || exit 1
+./wfc -i file_1MB.txt --range 0:400000 -o out_part1.wfc > /dev/null || exit 1
+./wfc -i file_1MB.txt --range 400000: -o out_part2.wfc > /dev/null || exit 1
+./wfc merge -o out_merged.txt out_part1.wfc out_part2.wfc > /dev/null || exit 1
+if ! cmp -s out_1MB.txt out_merged.txt
+then
+  echo "Merged ranges differ from a single run!" >&2
+  exit 1
+fi
+
+# a corrupt partial-count file must be rejected, not crash the merge
+printf 'WFCPART2\x00\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01abcdefgh' > out_bad.wfc
+./wfc merge -o out_merged.txt out_bad.wfc > /dev/null 2>&1
+if [ $? -ne 1 ]
+then
+  echo "Corrupt partial-count file was not rejected!" >&2
+  exit 1
+fi
+# parts counted with different tokenizer options must not be merged
+./wfc -i file_1MB.txt --range 400000: --utf8 --fold-case -o out_part2.wfc \
+  > /dev/null || exit 1
+./wfc merge -o out_merged.txt out_part1.wfc out_part2.wfc > /dev/null 2>&1
+if [ $? -ne 1 ]
+then
+  echo "Parts with different tokenizer options were merged!" >&2
+  exit 1
+fi
+rm -f out_part1.wfc out_part2.wfc out_bad.wfc out_merged.txt
+echo "ok"
+
 echo "10 kB file"
 
 for p in 2 5 10
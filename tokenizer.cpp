@@ -0,0 +1,594 @@
+/*
+ * tokenizer.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <mutex>
+#include "tokenizer.h"
+#include "utf8.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+/*
+ * Tokenizer of the process, which is initialized once on first use.
+ */
+static tokenizer process_tokenizer;
+static std::once_flag process_tokenizer_once;
+
+/**
+ * Returns the index of the next skippable (if skip is not zero) or word character
+ * (if skip is zero) in the buffer, beginning at buffer offset 'offset'.
+ * If no such character is found, buffer_length, will be returned.
+ */
+static inline size_t seek_next_scalar(const char *buffer, size_t offset,
+		size_t buffer_length, int skip) {
+	size_t i;
+
+	for (i = offset; i < buffer_length; i++) {
+		int skip_char = isskip(buffer[i]);
+
+		if ((skip && skip_char) || (!skip && !skip_char)) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+static size_t seek_next_skip_scalar(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	return seek_next_scalar(buffer, offset, buffer_length, 1);
+}
+
+static size_t seek_next_nonskip_scalar(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	return seek_next_scalar(buffer, offset, buffer_length, 0);
+}
+
+/**
+ * Returns the number of bytes of the word character which begins at
+ * buffer[offset] in UTF-8 mode, or zero if it is skippable.
+ */
+static inline size_t word_char_length(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	if (!(buffer[offset] & 0x80)) {
+		return !isskip(buffer[offset]);
+	}
+
+	return utf8_letter_length(buffer, offset, buffer_length);
+}
+
+static size_t seek_next_skip_utf8_scalar(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	while (offset < buffer_length) {
+		size_t length = word_char_length(buffer, offset, buffer_length);
+
+		if (!length) {
+			break;
+		}
+		offset += length;
+	}
+
+	return offset;
+}
+
+static size_t seek_next_nonskip_utf8_scalar(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	/*
+	 * Continuation bytes never begin a character, so advancing byte by
+	 * byte cannot find a letter inside a skippable character.
+	 */
+	while ((offset < buffer_length)
+			&& !word_char_length(buffer, offset, buffer_length)) {
+		offset++;
+	}
+
+	return offset;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * A byte c is a word character, iff (c | 0x20) is in 'a'..'z', or c is '-'
+ * or '\''.
+ * The range check subtracts 'a' and flips the sign bit, which maps the
+ * range to the smallest 26 signed bytes, so that a single signed
+ * comparison decides it.
+ */
+#define LETTER_BOUND ((char) (26 - 128))
+
+/**
+ * Returns a bit mask with bit i set, iff p[i] is a word character.
+ */
+static inline uint32_t word_mask_sse2(const char *p) {
+	__m128i x = _mm_loadu_si128((const __m128i *) p);
+	__m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+	__m128i shifted = _mm_xor_si128(_mm_sub_epi8(lower, _mm_set1_epi8('a')),
+			_mm_set1_epi8((char) 0x80));
+	__m128i letter = _mm_cmplt_epi8(shifted, _mm_set1_epi8(LETTER_BOUND));
+	__m128i dash = _mm_cmpeq_epi8(x, _mm_set1_epi8('-'));
+	__m128i quote = _mm_cmpeq_epi8(x, _mm_set1_epi8('\''));
+
+	return (uint32_t) _mm_movemask_epi8(
+			_mm_or_si128(letter, _mm_or_si128(dash, quote)));
+}
+
+static size_t seek_next_skip_sse2(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	while (offset + 16 <= buffer_length) {
+		uint32_t skip = ~word_mask_sse2(buffer + offset) & 0xffff;
+
+		if (skip) {
+			return offset + __builtin_ctz(skip);
+		}
+		offset += 16;
+	}
+
+	return seek_next_scalar(buffer, offset, buffer_length, 1);
+}
+
+static size_t seek_next_nonskip_sse2(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	while (offset + 16 <= buffer_length) {
+		uint32_t word = word_mask_sse2(buffer + offset);
+
+		if (word) {
+			return offset + __builtin_ctz(word);
+		}
+		offset += 16;
+	}
+
+	return seek_next_scalar(buffer, offset, buffer_length, 0);
+}
+
+/**
+ * Returns a bit mask with bit i set, iff p[i] is a word character.
+ */
+__attribute__((target("avx2")))
+static inline uint32_t word_mask_avx2(const char *p) {
+	__m256i x = _mm256_loadu_si256((const __m256i *) p);
+	__m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+	__m256i shifted = _mm256_xor_si256(
+			_mm256_sub_epi8(lower, _mm256_set1_epi8('a')),
+			_mm256_set1_epi8((char) 0x80));
+	__m256i letter = _mm256_cmpgt_epi8(_mm256_set1_epi8(LETTER_BOUND),
+			shifted);
+	__m256i dash = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('-'));
+	__m256i quote = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\''));
+
+	return (uint32_t) _mm256_movemask_epi8(
+			_mm256_or_si256(letter, _mm256_or_si256(dash, quote)));
+}
+
+__attribute__((target("avx2")))
+static size_t seek_next_skip_avx2(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	// most words are short, so look at the first 16 bytes only
+	if (offset + 16 <= buffer_length) {
+		uint32_t skip = ~word_mask_sse2(buffer + offset) & 0xffff;
+
+		if (skip) {
+			return offset + __builtin_ctz(skip);
+		}
+		offset += 16;
+	}
+
+	while (offset + 32 <= buffer_length) {
+		uint32_t skip = ~word_mask_avx2(buffer + offset);
+
+		if (skip) {
+			return offset + __builtin_ctz(skip);
+		}
+		offset += 32;
+	}
+
+	return seek_next_skip_sse2(buffer, offset, buffer_length);
+}
+
+__attribute__((target("avx2")))
+static size_t seek_next_nonskip_avx2(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	// most gaps between words are short, so look at the first 16 bytes only
+	if (offset + 16 <= buffer_length) {
+		uint32_t word = word_mask_sse2(buffer + offset);
+
+		if (word) {
+			return offset + __builtin_ctz(word);
+		}
+		offset += 16;
+	}
+
+	while (offset + 32 <= buffer_length) {
+		uint32_t word = word_mask_avx2(buffer + offset);
+
+		if (word) {
+			return offset + __builtin_ctz(word);
+		}
+		offset += 32;
+	}
+
+	return seek_next_nonskip_sse2(buffer, offset, buffer_length);
+}
+
+/*
+ * The UTF-8 kernels take the masks of the ASCII word characters and of the
+ * bytes of at least 0x80 of a block, which movemask yields for free.
+ * Bytes of at least 0x80 are never in the mask of the word characters.
+ */
+
+/**
+ * Seeks the next skippable character in the block at *offset in UTF-8
+ * mode.
+ * Returns nonzero and stores its index in *offset, if the block contains
+ * one before its first non-ASCII character.
+ * Otherwise, the non-ASCII letters from the first non-ASCII character on
+ * are skipped and *offset is where the search continues; it returns
+ * nonzero then if it found a skippable non-ASCII character.
+ * If the block is ASCII only and contains word characters only, *offset
+ * is advanced by width.
+ */
+static inline int skip_block_utf8(const char *buffer, size_t *offset,
+		size_t buffer_length, uint32_t word, uint32_t high, uint32_t full,
+		unsigned int width) {
+	uint32_t skip = ~(word | high) & full;
+
+	if (!high) {
+		if (skip) {
+			*offset += __builtin_ctz(skip);
+			return 1;
+		}
+		*offset += width;
+		return 0;
+	}
+
+	if (skip & ((1u << __builtin_ctz(high)) - 1)) {
+		*offset += __builtin_ctz(skip);
+		return 1;
+	}
+
+	// decode the run of non-ASCII characters
+	*offset += __builtin_ctz(high);
+	do {
+		size_t length = utf8_letter_length(buffer, *offset, buffer_length);
+
+		if (!length) {
+			return 1;
+		}
+		*offset += length;
+	} while ((*offset < buffer_length) && (buffer[*offset] & 0x80));
+
+	return 0;
+}
+
+/**
+ * Seeks the next word character in the block at offset in UTF-8 mode.
+ * Returns the index of the first ASCII word character or non-ASCII letter
+ * of the block, or offset + width if there is none.
+ */
+static inline size_t nonskip_block_utf8(const char *buffer, size_t offset,
+		size_t buffer_length, uint32_t word, uint32_t high,
+		unsigned int width) {
+	uint32_t candidates = word | high;
+
+	while (candidates) {
+		unsigned int i = __builtin_ctz(candidates);
+
+		if (((word >> i) & 1)
+				|| utf8_letter_length(buffer, offset + i, buffer_length)) {
+			return offset + i;
+		}
+		candidates &= candidates - 1;
+	}
+
+	return offset + width;
+}
+
+/**
+ * Returns a bit mask with bit i set, iff p[i] is at least 0x80.
+ */
+static inline uint32_t high_mask_sse2(const char *p) {
+	return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) p));
+}
+
+static size_t seek_next_skip_utf8_sse2(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	while (offset + 16 <= buffer_length) {
+		if (skip_block_utf8(buffer, &offset, buffer_length,
+				word_mask_sse2(buffer + offset), high_mask_sse2(buffer + offset),
+				0xffff, 16)) {
+			return offset;
+		}
+	}
+
+	return seek_next_skip_utf8_scalar(buffer, offset, buffer_length);
+}
+
+static size_t seek_next_nonskip_utf8_sse2(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	while (offset + 16 <= buffer_length) {
+		size_t next = nonskip_block_utf8(buffer, offset, buffer_length,
+				word_mask_sse2(buffer + offset), high_mask_sse2(buffer + offset),
+				16);
+
+		if (next < offset + 16) {
+			return next;
+		}
+		offset = next;
+	}
+
+	return seek_next_nonskip_utf8_scalar(buffer, offset, buffer_length);
+}
+
+/**
+ * Returns a bit mask with bit i set, iff p[i] is at least 0x80.
+ */
+__attribute__((target("avx2")))
+static inline uint32_t high_mask_avx2(const char *p) {
+	return (uint32_t) _mm256_movemask_epi8(
+			_mm256_loadu_si256((const __m256i *) p));
+}
+
+__attribute__((target("avx2")))
+static size_t seek_next_skip_utf8_avx2(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	// most words are short, so look at the first 16 bytes only
+	if ((offset + 16 <= buffer_length)
+			&& skip_block_utf8(buffer, &offset, buffer_length,
+					word_mask_sse2(buffer + offset),
+					high_mask_sse2(buffer + offset), 0xffff, 16)) {
+		return offset;
+	}
+
+	while (offset + 32 <= buffer_length) {
+		if (skip_block_utf8(buffer, &offset, buffer_length,
+				word_mask_avx2(buffer + offset), high_mask_avx2(buffer + offset),
+				0xffffffff, 32)) {
+			return offset;
+		}
+	}
+
+	return seek_next_skip_utf8_sse2(buffer, offset, buffer_length);
+}
+
+__attribute__((target("avx2")))
+static size_t seek_next_nonskip_utf8_avx2(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	// most gaps between words are short, so look at the first 16 bytes only
+	if (offset + 16 <= buffer_length) {
+		size_t next = nonskip_block_utf8(buffer, offset, buffer_length,
+				word_mask_sse2(buffer + offset), high_mask_sse2(buffer + offset),
+				16);
+
+		if (next < offset + 16) {
+			return next;
+		}
+		offset = next;
+	}
+
+	while (offset + 32 <= buffer_length) {
+		size_t next = nonskip_block_utf8(buffer, offset, buffer_length,
+				word_mask_avx2(buffer + offset), high_mask_avx2(buffer + offset),
+				32);
+
+		if (next < offset + 32) {
+			return next;
+		}
+		offset = next;
+	}
+
+	return seek_next_nonskip_utf8_sse2(buffer, offset, buffer_length);
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+int tokenizer_init(tokenizer *tok, tokenizer_kernel kernel, int utf8,
+		int normalization) {
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init();
+
+	if (kernel == TOKENIZER_AUTO) {
+		kernel = __builtin_cpu_supports("avx2") ?
+				TOKENIZER_AVX2 : TOKENIZER_SSE2;
+	}
+#else
+	if (kernel == TOKENIZER_AUTO) {
+		kernel = TOKENIZER_SCALAR;
+	}
+#endif
+
+	switch (kernel) {
+	case TOKENIZER_SCALAR:
+		tok->seek_skip = utf8 ?
+				seek_next_skip_utf8_scalar : seek_next_skip_scalar;
+		tok->seek_nonskip = utf8 ?
+				seek_next_nonskip_utf8_scalar : seek_next_nonskip_scalar;
+		break;
+
+#ifdef HAVE_X86_KERNELS
+	case TOKENIZER_SSE2:
+		if (!__builtin_cpu_supports("sse2")) {
+			return EXIT_FAILURE;
+		}
+		tok->seek_skip = utf8 ? seek_next_skip_utf8_sse2 : seek_next_skip_sse2;
+		tok->seek_nonskip = utf8 ?
+				seek_next_nonskip_utf8_sse2 : seek_next_nonskip_sse2;
+		break;
+
+	case TOKENIZER_AVX2:
+		if (!__builtin_cpu_supports("avx2")) {
+			return EXIT_FAILURE;
+		}
+		tok->seek_skip = utf8 ? seek_next_skip_utf8_avx2 : seek_next_skip_avx2;
+		tok->seek_nonskip = utf8 ?
+				seek_next_nonskip_utf8_avx2 : seek_next_nonskip_avx2;
+		break;
+#endif
+
+	default:
+		return EXIT_FAILURE;
+	}
+
+	if (utf8) {
+		utf8_init();
+	}
+	tok->kernel = kernel;
+	tok->utf8 = utf8;
+	tok->normalization = normalization;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Initializes the tokenizer of the process with the default options.
+ */
+static void init_process_tokenizer(void) {
+	if (tokenizer_init(&process_tokenizer, TOKENIZER_AUTO, 0, 0)
+			!= EXIT_SUCCESS) {
+		tokenizer_init(&process_tokenizer, TOKENIZER_SCALAR, 0, 0);
+	}
+}
+
+/**
+ * Returns the tokenizer of the process, which may be changed.
+ */
+static tokenizer *mutable_tokenizer(void) {
+	std::call_once(process_tokenizer_once, init_process_tokenizer);
+	return &process_tokenizer;
+}
+
+const tokenizer *tokenizer_default(void) {
+	return mutable_tokenizer();
+}
+
+void tokenizer_set_utf8(int utf8) {
+	tokenizer *tok = mutable_tokenizer();
+
+	tokenizer_init(tok, tok->kernel, utf8, tok->normalization);
+}
+
+int tokenizer_utf8(void) {
+	return tokenizer_default()->utf8;
+}
+
+void tokenizer_set_normalization(int flags) {
+	mutable_tokenizer()->normalization = flags;
+}
+
+int tokenizer_normalization(void) {
+	return tokenizer_default()->normalization;
+}
+
+int tokenizer_select(tokenizer_kernel kernel) {
+	tokenizer *tok = mutable_tokenizer();
+
+	return tokenizer_init(tok, kernel, tok->utf8, tok->normalization);
+}
+
+const char *tokenizer_kernel_name(tokenizer_kernel kernel) {
+	switch (kernel) {
+	case TOKENIZER_AUTO:
+		return "auto";
+	case TOKENIZER_SCALAR:
+		return "scalar";
+	case TOKENIZER_SSE2:
+		return "sse2";
+	case TOKENIZER_AVX2:
+		return "avx2";
+	default:
+		return "unknown";
+	}
+}
+
+size_t seek_next_nonskip(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	return tokenizer_seek_nonskip(tokenizer_default(), buffer, offset,
+			buffer_length);
+}
+
+size_t seek_next_skip(const char *buffer, size_t offset, size_t buffer_length) {
+	return tokenizer_seek_skip(tokenizer_default(), buffer, offset,
+			buffer_length);
+}
+
+/**
+ * Returns the index of the first byte of the character which contains
+ * buffer[offset], or of buffer[offset] itself if it is not a continuation
+ * byte of a character.
+ */
+static size_t character_start(const char *buffer, size_t offset) {
+	size_t start = offset;
+
+	while ((start > 0) && (offset - start < 3)
+			&& utf8_is_continuation(buffer[start])) {
+		start--;
+	}
+
+	return utf8_is_continuation(buffer[start]) ? offset : start;
+}
+
+size_t tokenizer_skip_partial_word(const tokenizer *tok, const char *buffer,
+		size_t offset, size_t buffer_length) {
+	size_t start, length;
+
+	if (offset == 0) {
+		return offset;
+	}
+
+	if (!tok->utf8) {
+		return isskip(buffer[offset - 1]) ?
+				offset : tokenizer_seek_skip(tok, buffer, offset, buffer_length);
+	}
+
+	// offset may be inside the letter, so skip it as a whole
+	start = character_start(buffer, offset - 1);
+	length = word_char_length(buffer, start, buffer_length);
+	if (start + length < offset) {
+		return offset;
+	}
+
+	return tokenizer_seek_skip(tok, buffer, start + length, buffer_length);
+}
+
+size_t skip_partial_word(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	return tokenizer_skip_partial_word(tokenizer_default(), buffer, offset,
+			buffer_length);
+}
+
+size_t tokenizer_prev_boundary(const tokenizer *tok, const char *buffer,
+		size_t offset) {
+	if (!tok->utf8) {
+		while ((offset > 0) && !isskip(buffer[offset - 1])) {
+			offset--;
+		}
+		return offset;
+	}
+
+	while (offset > 0) {
+		size_t start = character_start(buffer, offset - 1);
+		size_t length = word_char_length(buffer, start, offset);
+
+		if (length == offset - start) {
+			// a complete letter
+			offset = start;
+		} else if ((length == 0)
+				&& (start + utf8_sequence_length(buffer[start]) > offset)) {
+			// a character, which the following bytes may complete
+			offset = start;
+		} else {
+			break;
+		}
+	}
+
+	return offset;
+}
+
+size_t seek_prev_boundary(const char *buffer, size_t offset) {
+	return tokenizer_prev_boundary(tokenizer_default(), buffer, offset);
+}
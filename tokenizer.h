@@ -0,0 +1,219 @@
+/*
+ * tokenizer.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef TOKENIZER_H_
+#define TOKENIZER_H_
+
+#include <stddef.h>
+
+/**
+ * Implementations of the tokenizer.
+ * The vectorized kernels classify 16 (SSE2) or 32 (AVX2) bytes at a time
+ * and find word boundaries with bit scans.
+ * All kernels yield the same words as the scalar kernel.
+ * In UTF-8 mode, the vectorized kernels take the same path for blocks of
+ * ASCII characters and decode only the characters which begin with a byte
+ * of at least 0x80.
+ */
+typedef enum tokenizer_kernel_t {
+	TOKENIZER_AUTO,
+	TOKENIZER_SCALAR,
+	TOKENIZER_SSE2,
+	TOKENIZER_AVX2
+} tokenizer_kernel;
+
+/*
+ * Normalizations of the words, which count_range applies as it adds the
+ * words to a table.
+ * TOKENIZER_FOLD_CASE turns upper case letters into lower case, in UTF-8
+ * mode by the simple case folding of Unicode (see word_fold).
+ * TOKENIZER_TRIM removes apostrophes and hyphens at the beginning and end
+ * of a word, so that quoted words and dashes between words do not count.
+ */
+#define TOKENIZER_FOLD_CASE 1
+#define TOKENIZER_TRIM 2
+
+/**
+ * Returns zero, iff the given character is skippable, i.e. the given
+ * character does not belong to a word.
+ */
+static inline int isskip(char c) {
+	return !((c >= 'a') && (c <= 'z')) && !((c >= 'A') && (c <= 'Z'))
+			&& (c != '-') && (c != '\'');
+}
+
+/**
+ * Function of a kernel, which returns the index of the next skippable or
+ * word character in the buffer, beginning at buffer offset 'offset', or
+ * buffer_length if there is none.
+ */
+typedef size_t (*tokenizer_seek)(const char *buffer, size_t offset,
+		size_t buffer_length);
+
+/**
+ * Tokenizer mode, kernel, and normalizations with which words are counted.
+ * A tokenizer is not changed once it is initialized, so any number of
+ * threads may use it at the same time.
+ * The functions below which take no tokenizer use the tokenizer of the
+ * process, which the functions tokenizer_set_utf8,
+ * tokenizer_set_normalization, and tokenizer_select change.
+ */
+typedef struct tokenizer_t {
+	tokenizer_kernel kernel;
+	tokenizer_seek seek_skip;
+	tokenizer_seek seek_nonskip;
+	int utf8;
+	int normalization;
+} tokenizer;
+
+/**
+ * Initializes the given tokenizer with the given kernel, with UTF-8 mode if
+ * utf8 is not zero, and with the given normalizations (TOKENIZER_FOLD_CASE
+ * and TOKENIZER_TRIM).
+ * In UTF-8 mode, words consist of Unicode letters and combining marks in
+ * addition to the ASCII word characters, and bytes which are not valid
+ * UTF-8 are skippable.
+ * TOKENIZER_AUTO selects the fastest kernel which the CPU supports.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the CPU does not support the
+ * kernel.
+ */
+int tokenizer_init(tokenizer *tok, tokenizer_kernel kernel, int utf8,
+		int normalization);
+
+/**
+ * Returns the tokenizer of the process, which is initialized with the
+ * fastest kernel and neither UTF-8 mode nor normalizations on first use.
+ */
+const tokenizer *tokenizer_default(void);
+
+/**
+ * Enables (if utf8 is not zero) or disables UTF-8 mode of the tokenizer of
+ * the process.
+ * Call this function before any thread is started.
+ */
+void tokenizer_set_utf8(int utf8);
+
+/**
+ * Returns nonzero, iff UTF-8 mode of the tokenizer of the process is
+ * enabled.
+ */
+int tokenizer_utf8(void);
+
+/**
+ * Sets the normalizations (TOKENIZER_FOLD_CASE and TOKENIZER_TRIM) of the
+ * tokenizer of the process.
+ * Call this function before any thread is started.
+ */
+void tokenizer_set_normalization(int flags);
+
+/**
+ * Returns the normalizations of the tokenizer of the process.
+ */
+int tokenizer_normalization(void);
+
+/**
+ * Returns nonzero, iff the given character is an apostrophe or a hyphen,
+ * which TOKENIZER_TRIM removes from the ends of words.
+ */
+static inline int istrimmed(char c) {
+	return (c == '-') || (c == '\'');
+}
+
+/**
+ * Removes the apostrophes and hyphens at the beginning and the end of the
+ * given word by moving its bounds.
+ */
+static inline void trim_word(const char **word, size_t *length) {
+	while (*length && istrimmed((*word)[0])) {
+		(*word)++;
+		(*length)--;
+	}
+	while (*length && istrimmed((*word)[*length - 1])) {
+		(*length)--;
+	}
+}
+
+/**
+ * Selects the given kernel for the tokenizer of the process.
+ * TOKENIZER_AUTO selects the fastest kernel which the CPU supports, which
+ * is also the default.
+ * Call this function before any thread is started.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the CPU does not support the
+ * kernel.
+ */
+int tokenizer_select(tokenizer_kernel kernel);
+
+/**
+ * Returns the name of the given kernel.
+ */
+const char *tokenizer_kernel_name(tokenizer_kernel kernel);
+
+/**
+ * Returns the index of the next word character in the buffer, beginning at buffer
+ * offset 'offset'.
+ * If no such character is found, buffer_length, will be returned.
+ */
+size_t seek_next_nonskip(const char *buffer, size_t offset,
+		size_t buffer_length);
+
+/**
+ * Returns the index of the next skippable character in the buffer, beginning at
+ * buffer offset 'offset'.
+ * If no such character is found, buffer_length, will be returned.
+ */
+size_t seek_next_skip(const char *buffer, size_t offset, size_t buffer_length);
+
+/**
+ * Returns the offset at which the words that begin at or after offset
+ * start is parsed, i.e. offset, or the end of the word which contains the
+ * byte before offset, if any.
+ * In UTF-8 mode, offset may be inside a character.
+ */
+size_t skip_partial_word(const char *buffer, size_t offset,
+		size_t buffer_length);
+
+/**
+ * Returns the smallest index, at most offset, such that the bytes before
+ * it end with a skippable character and the bytes from it to offset may
+ * belong to a word, which continues after offset.
+ * The words before the returned index are thus unaffected by any bytes
+ * after offset.
+ */
+size_t seek_prev_boundary(const char *buffer, size_t offset);
+
+/**
+ * Returns the index of the next word character like seek_next_nonskip,
+ * with the given tokenizer.
+ */
+static inline size_t tokenizer_seek_nonskip(const tokenizer *tok,
+		const char *buffer, size_t offset, size_t buffer_length) {
+	return tok->seek_nonskip(buffer, offset, buffer_length);
+}
+
+/**
+ * Returns the index of the next skippable character like seek_next_skip,
+ * with the given tokenizer.
+ */
+static inline size_t tokenizer_seek_skip(const tokenizer *tok,
+		const char *buffer, size_t offset, size_t buffer_length) {
+	return tok->seek_skip(buffer, offset, buffer_length);
+}
+
+/**
+ * Returns the offset at which the words that begin at or after offset
+ * start like skip_partial_word, with the given tokenizer.
+ */
+size_t tokenizer_skip_partial_word(const tokenizer *tok, const char *buffer,
+		size_t offset, size_t buffer_length);
+
+/**
+ * Returns the last boundary of words at or before offset like
+ * seek_prev_boundary, with the given tokenizer.
+ */
+size_t tokenizer_prev_boundary(const tokenizer *tok, const char *buffer,
+		size_t offset);
+
+#endif /* TOKENIZER_H_ */
@@ -0,0 +1,238 @@
+/*
+ * topology.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "topology.h"
+
+/*
+ * Largest number of NUMA nodes which are considered.
+ */
+#define MAX_NODES 64
+
+/*
+ * CPUs to which workers are pinned, ordered by node, and their nodes.
+ * number_pin_cpus is zero unless pinning is enabled.
+ */
+static int pin_cpus[CPU_SETSIZE];
+static int pin_nodes[CPU_SETSIZE];
+static int number_pin_cpus = 0;
+static int number_nodes = 1;
+
+/**
+ * Reads the first line of the given file into line.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read.
+ */
+static int read_line(const char *fname, char *line, int size) {
+	FILE *file = fopen(fname, "r");
+	int error;
+
+	if (!file) {
+		return EXIT_FAILURE;
+	}
+	error = !fgets(line, size, file);
+	fclose(file);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Returns the number of CPUs which the CPU quota of the cgroup of the
+ * process allows, rounded up, or zero if there is no quota.
+ * Both the unified hierarchy (cpu.max) and the cpu controller of the
+ * legacy hierarchy (cpu.cfs_quota_us) are supported.
+ */
+static int cgroup_cpus(void) {
+	char path[4096];
+	char line[256];
+	long quota = -1;
+	long period = 0;
+	FILE *cgroup = fopen("/proc/self/cgroup", "r");
+
+	// the cgroup of the process in the unified hierarchy, if it is mounted
+	if (cgroup) {
+		while (fgets(line, sizeof(line), cgroup)) {
+			if (strncmp(line, "0::", 3) == 0) {
+				line[strcspn(line, "\n")] = 0;
+				snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.max",
+						line + 3);
+				if (read_line(path, line, sizeof(line)) == EXIT_SUCCESS) {
+					if (sscanf(line, "%ld %ld", &quota, &period) != 2) {
+						quota = -1; // "max" means no quota
+					}
+				}
+				break;
+			}
+		}
+		fclose(cgroup);
+	}
+
+	if ((quota < 0) && (read_line("/sys/fs/cgroup/cpu.max", line,
+			sizeof(line)) == EXIT_SUCCESS)) {
+		if (sscanf(line, "%ld %ld", &quota, &period) != 2) {
+			quota = -1;
+		}
+	}
+
+	if ((quota < 0) && (read_line("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", line,
+			sizeof(line)) == EXIT_SUCCESS)) {
+		quota = strtol(line, NULL, 10);
+		if (read_line("/sys/fs/cgroup/cpu/cpu.cfs_period_us", line,
+				sizeof(line)) == EXIT_SUCCESS) {
+			period = strtol(line, NULL, 10);
+		}
+	}
+
+	if ((quota <= 0) || (period <= 0)) {
+		return 0;
+	}
+
+	return (int) ((quota + period - 1) / period);
+}
+
+int topology_cpus(void) {
+	cpu_set_t cpus;
+	int number = 1;
+	int quota;
+
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+		number = CPU_COUNT(&cpus);
+	} else {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if (online > 0) {
+			number = (int) online;
+		}
+	}
+
+	quota = cgroup_cpus();
+	if ((quota > 0) && (quota < number)) {
+		number = quota;
+	}
+
+	return (number > 0) ? number : 1;
+}
+
+/**
+ * Adds the CPUs of the given list, such as "0-3,8-11", to cpus.
+ */
+static void parse_cpu_list(const char *list, cpu_set_t *cpus) {
+	const char *p = list;
+
+	CPU_ZERO(cpus);
+	while (*p) {
+		char *end;
+		long first = strtol(p, &end, 10);
+		long last = first;
+
+		if (end == p) {
+			break;
+		}
+		p = end;
+		if (*p == '-') {
+			last = strtol(p + 1, &end, 10);
+			p = end;
+		}
+		for (long cpu = first; (cpu <= last) && (cpu < CPU_SETSIZE); cpu++) {
+			CPU_SET(cpu, cpus);
+		}
+		if (*p == ',') {
+			p++;
+		} else {
+			break;
+		}
+	}
+}
+
+int topology_pin_init(void) {
+	cpu_set_t allowed;
+	cpu_set_t listed;
+	char path[128];
+	char line[4096];
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		perror("sched_getaffinity");
+		return EXIT_FAILURE;
+	}
+
+	// order the allowed CPUs by node
+	CPU_ZERO(&listed);
+	number_pin_cpus = 0;
+	number_nodes = 0;
+	for (int node = 0; node < MAX_NODES; node++) {
+		cpu_set_t cpus;
+		int found = 0;
+
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+				node);
+		if (read_line(path, line, sizeof(line)) != EXIT_SUCCESS) {
+			continue;
+		}
+
+		parse_cpu_list(line, &cpus);
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &cpus) && CPU_ISSET(cpu, &allowed)
+					&& !CPU_ISSET(cpu, &listed)) {
+				CPU_SET(cpu, &listed);
+				pin_cpus[number_pin_cpus] = cpu;
+				pin_nodes[number_pin_cpus] = node;
+				number_pin_cpus++;
+				found = 1;
+			}
+		}
+		number_nodes += found;
+	}
+
+	// without NUMA information, the CPUs form a single node
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed) && !CPU_ISSET(cpu, &listed)) {
+			pin_cpus[number_pin_cpus] = cpu;
+			pin_nodes[number_pin_cpus] = -1;
+			number_pin_cpus++;
+		}
+	}
+	if (number_nodes == 0) {
+		number_nodes = 1;
+	}
+
+	return (number_pin_cpus > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void topology_pin(int worker) {
+	cpu_set_t cpus;
+	int i;
+
+	if (number_pin_cpus == 0) {
+		return;
+	}
+
+	i = worker % number_pin_cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(pin_cpus[i], &cpus);
+
+	// pinning is a hint, so the worker runs unpinned if it fails
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+		return;
+	}
+
+	/*
+	 * Prefer the node of the CPU for the memory the worker allocates from
+	 * now on, such as its word table, even if the process was started
+	 * with an interleaving policy.
+	 * A single node needs no policy.
+	 */
+	if ((number_nodes > 1) && (pin_nodes[i] >= 0)) {
+		unsigned long nodemask = 1UL << pin_nodes[i];
+
+		syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask,
+				sizeof(nodemask) * 8);
+	}
+}
@@ -0,0 +1,35 @@
+/*
+ * topology.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef TOPOLOGY_H_
+#define TOPOLOGY_H_
+
+/**
+ * Returns the number of CPUs which the process may use: the CPUs of its
+ * affinity mask, limited by the CPU quota of its cgroup, if any.
+ * Returns at least one.
+ */
+int topology_cpus(void);
+
+/**
+ * Enables pinning of workers for subsequent calls of topology_pin.
+ * The usable CPUs are ordered by NUMA node, so that consecutive workers
+ * share a node.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the affinity mask of the
+ * process cannot be determined.
+ */
+int topology_pin_init(void);
+
+/**
+ * Pins the calling thread (or process) to the CPU of the given worker and
+ * makes it allocate memory on the NUMA node of that CPU.
+ * Workers beyond the number of usable CPUs wrap around.
+ * Does nothing unless topology_pin_init succeeded, and only pins to the
+ * CPU on machines with a single node.
+ */
+void topology_pin(int worker);
+
+#endif /* TOPOLOGY_H_ */
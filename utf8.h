@@ -0,0 +1,70 @@
+/*
+ * utf8.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef UTF8_H_
+#define UTF8_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Builds the lookup table of the letters of the Basic Multilingual Plane
+ * on its first call.
+ * Call it before any other function of this module; any thread may call
+ * it any number of times.
+ */
+void utf8_init(void);
+
+/**
+ * Returns nonzero, iff the given code point is a Unicode letter (general
+ * category L) or a combining mark (general category M), which belong to
+ * words.
+ */
+int utf8_is_letter(uint32_t code_point);
+
+/**
+ * Returns the simple case folding of the given non-ASCII code point, e.g.
+ * the lower case of an upper case letter, or the code point itself.
+ * The folded code point takes as many bytes in UTF-8 as the given one.
+ */
+uint32_t utf8_fold(uint32_t code_point);
+
+/**
+ * Returns the number of bytes of a character which begins with the given
+ * byte, or zero if no character begins with it, e.g. a continuation byte.
+ */
+size_t utf8_sequence_length(char lead);
+
+/**
+ * Returns nonzero, iff the given byte continues a character.
+ */
+static inline int utf8_is_continuation(char c) {
+	return (c & 0xc0) == 0x80;
+}
+
+/**
+ * Decodes the UTF-8 character which begins at buffer[offset] and stores
+ * its code point in code_point.
+ * Returns the number of bytes of the character, or zero if the bytes are
+ * not a valid character, e.g. a continuation byte, an overlong encoding,
+ * a surrogate, or a character which is cut off by buffer_length.
+ */
+size_t utf8_decode(const char *buffer, size_t offset, size_t buffer_length,
+		uint32_t *code_point);
+
+/**
+ * Returns the number of bytes of the letter which begins at buffer[offset],
+ * or zero if the character there is not a letter or invalid.
+ */
+static inline size_t utf8_letter_length(const char *buffer, size_t offset,
+		size_t buffer_length) {
+	uint32_t code_point;
+	size_t length = utf8_decode(buffer, offset, buffer_length, &code_point);
+
+	return (length && utf8_is_letter(code_point)) ? length : 0;
+}
+
+#endif /* UTF8_H_ */
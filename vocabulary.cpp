@@ -0,0 +1,294 @@
+/*
+ * vocabulary.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "vocabulary.h"
+
+/*
+ * Mean number of words per bucket of the perfect hash.
+ * Larger buckets take less memory for the pilots, but longer to place.
+ */
+#define WORDS_PER_BUCKET 4
+
+/*
+ * Pilots which are tried for a bucket before the perfect hash is given up.
+ */
+#define MAX_PILOT (1U << 24)
+
+/**
+ * Returns the mixed value of the given pilot (finalizer of MurmurHash3),
+ * so that each pilot moves the words of a bucket to unrelated identifiers.
+ */
+static inline uint64_t mix_pilot(uint32_t pilot) {
+	uint64_t h = pilot * 0x9e3779b97f4a7c15ULL;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+/**
+ * Adds the words of the given text, one per line, to the table of the
+ * vocabulary, once each.
+ */
+static int add_lines(vocabulary *vocab, const char *text, size_t length,
+		int fold) {
+	size_t position = 0;
+
+	while (position < length) {
+		const char *line = text + position;
+		const char *newline = (const char *) memchr(line, '\n',
+				length - position);
+		size_t line_length = newline ? newline - line : length - position;
+		const char *tab = (const char *) memchr(line, '\t', line_length);
+		size_t word_length = tab ? tab - line : line_length;
+
+		position += line_length + 1;
+		if ((word_length > 0) && (line[word_length - 1] == '\r')) {
+			word_length--;
+		}
+		if ((word_length == 0) || (word_length > UINT32_MAX)) {
+			continue;
+		}
+
+		if ((fold ? word_table_find_folded(&vocab->words, line, word_length) :
+				word_table_find(&vocab->words, line, word_length))) {
+			continue;
+		}
+		if ((fold ? word_table_add_folded(&vocab->words, line, word_length, 1) :
+				word_table_add(&vocab->words, line, word_length, 1))
+				!= EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Places the words of the table of the vocabulary at the identifiers of
+ * the perfect hash.
+ * The buckets are placed from the largest to the smallest, each with the
+ * first pilot which moves all of its words to free identifiers.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if a bucket cannot be placed.
+ */
+static int place_words(vocabulary *vocab) {
+	const word_table *table = &vocab->words;
+	std::vector<vocabulary_term> words;
+	std::vector<size_t> bucket_start(vocab->number_buckets + 1, 0);
+	std::vector<vocabulary_term> sorted(vocab->size);
+	std::vector<size_t> order(vocab->number_buckets);
+	std::vector<bool> taken(vocab->size, false);
+	size_t positions[64];
+
+	words.reserve(vocab->size);
+	for (size_t i = 0; i < table->capacity; i++) {
+		const word_table_slot *slot = &table->slots[i];
+
+		if (slot->word) {
+			vocabulary_term term;
+
+			term.word = slot->word;
+			term.length = slot->length;
+			term.hash = word_hash64(slot->word, slot->length, 0);
+			words.push_back(term);
+		}
+	}
+
+	// group the words by bucket
+	for (const vocabulary_term &term : words) {
+		bucket_start[vocabulary_bucket(vocab, term.hash) + 1]++;
+	}
+	for (size_t b = 0; b < vocab->number_buckets; b++) {
+		bucket_start[b + 1] += bucket_start[b];
+		order[b] = b;
+	}
+	{
+		std::vector<size_t> next(bucket_start.begin(), bucket_start.end() - 1);
+
+		for (const vocabulary_term &term : words) {
+			sorted[next[vocabulary_bucket(vocab, term.hash)]++] = term;
+		}
+	}
+	std::stable_sort(order.begin(), order.end(),
+			[&bucket_start](size_t lhs, size_t rhs) {
+				return bucket_start[lhs + 1] - bucket_start[lhs]
+						> bucket_start[rhs + 1] - bucket_start[rhs];
+			});
+
+	for (size_t b : order) {
+		size_t begin = bucket_start[b];
+		size_t size = bucket_start[b + 1] - begin;
+		uint32_t pilot = 0;
+		uint64_t mixed = 0;
+
+		if (size == 0) {
+			break;
+		}
+		if (size > sizeof(positions) / sizeof(positions[0])) {
+			return EXIT_FAILURE;
+		}
+
+		for (; pilot < MAX_PILOT; pilot++) {
+			size_t i = 0;
+
+			mixed = mix_pilot(pilot);
+			for (; i < size; i++) {
+				positions[i] = vocabulary_position(vocab,
+						sorted[begin + i].hash, mixed);
+				if (taken[positions[i]] || (std::find(positions,
+						positions + i, positions[i]) != positions + i)) {
+					break;
+				}
+			}
+			if (i == size) {
+				break;
+			}
+		}
+		if (pilot == MAX_PILOT) {
+			return EXIT_FAILURE;
+		}
+
+		vocab->pilots[b] = mixed;
+		for (size_t i = 0; i < size; i++) {
+			taken[positions[i]] = true;
+			vocab->terms[positions[i]] = sorted[begin + i];
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int vocabulary_build(vocabulary *vocab, const char *text, size_t length,
+		int fold) {
+	vocab->size = 0;
+	vocab->number_buckets = 0;
+	vocab->pilots = NULL;
+	vocab->terms = NULL;
+
+	if (word_table_init(&vocab->words, 0) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+	if (add_lines(vocab, text, length, fold) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		vocabulary_free(vocab);
+		return EXIT_FAILURE;
+	}
+
+	vocab->size = vocab->words.size;
+	vocab->number_buckets = std::max(
+			(vocab->size + WORDS_PER_BUCKET - 1) / WORDS_PER_BUCKET,
+			(size_t) 1);
+	vocab->pilots = (uint64_t *) calloc(vocab->number_buckets,
+			sizeof(uint64_t));
+	vocab->terms = (vocabulary_term *) calloc(std::max(vocab->size,
+			(size_t) 1), sizeof(vocabulary_term));
+	if (!vocab->pilots || !vocab->terms) {
+		fprintf(stderr, "Not enough memory!\n");
+		vocabulary_free(vocab);
+		return EXIT_FAILURE;
+	}
+
+	if (place_words(vocab) != EXIT_SUCCESS) {
+		fprintf(stderr, "Could not build a perfect hash of the vocabulary!\n");
+		vocabulary_free(vocab);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void vocabulary_free(vocabulary *vocab) {
+	word_table_free(&vocab->words);
+	free(vocab->pilots);
+	free(vocab->terms);
+	vocab->pilots = NULL;
+	vocab->terms = NULL;
+	vocab->size = 0;
+}
+
+int vocabulary_counts_init(vocabulary_counts *counts, const vocabulary *vocab) {
+	counts->vocab = vocab;
+	counts->counts = (uint64_t *) calloc(std::max(vocab->size, (size_t) 1),
+			sizeof(uint64_t));
+	if (!counts->counts) {
+		return EXIT_FAILURE;
+	}
+	if (word_table_init(&counts->overflow, 0) != EXIT_SUCCESS) {
+		free(counts->counts);
+		counts->counts = NULL;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void vocabulary_counts_free(vocabulary_counts *counts) {
+	free(counts->counts);
+	counts->counts = NULL;
+	word_table_free(&counts->overflow);
+}
+
+void vocabulary_counts_add_range(vocabulary_counts *destination,
+		const vocabulary_counts *source, size_t begin, size_t end) {
+	uint64_t *counts = destination->counts;
+	const uint64_t *source_counts = source->counts;
+
+	// the compiler vectorizes the loop
+	for (size_t i = begin; i < end; i++) {
+		counts[i] += source_counts[i];
+	}
+}
+
+int vocabulary_counts_merge(vocabulary_counts *destination,
+		const vocabulary_counts *source) {
+	vocabulary_counts_add_range(destination, source, 0,
+			destination->vocab->size);
+
+	return word_table_merge(&destination->overflow, &source->overflow);
+}
+
+size_t vocabulary_counts_size(const vocabulary_counts *counts) {
+	size_t size = counts->overflow.size;
+
+	for (size_t i = 0; i < counts->vocab->size; i++) {
+		size += (counts->counts[i] > 0);
+	}
+
+	return size;
+}
+
+size_t vocabulary_counts_words(const vocabulary_counts *counts,
+		word_count *words) {
+	const word_table *overflow = &counts->overflow;
+	size_t number_words = 0;
+
+	for (size_t i = 0; i < counts->vocab->size; i++) {
+		if (counts->counts[i] > 0) {
+			words[number_words].word = counts->vocab->terms[i].word;
+			words[number_words].count = counts->counts[i];
+			number_words++;
+		}
+	}
+	for (size_t i = 0; i < overflow->capacity; i++) {
+		if (overflow->slots[i].word) {
+			words[number_words].word = overflow->slots[i].word;
+			words[number_words].count = overflow->slots[i].count;
+			number_words++;
+		}
+	}
+
+	return number_words;
+}
@@ -0,0 +1,193 @@
+/*
+ * vocabulary.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef VOCABULARY_H_
+#define VOCABULARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ranking.h"
+#include "word_table.h"
+
+/*
+ * Identifier of a word which is not in the vocabulary.
+ */
+#define VOCABULARY_MISSING SIZE_MAX
+
+/**
+ * Term of a vocabulary.
+ * The word points into the table of the vocabulary.
+ */
+typedef struct vocabulary_term_t {
+	const char *word;
+	uint64_t hash;
+	uint32_t length;
+} vocabulary_term;
+
+/**
+ * Fixed set of words, each of which has a dense identifier below the size
+ * of the vocabulary.
+ * The identifiers are given by a minimal perfect hash (compress, hash, and
+ * displace): the words are hashed into buckets of about four words, and
+ * each bucket has a pilot value which displaces its words to identifiers
+ * which no other word takes.
+ * The pilots are stored mixed, so that a lookup does not mix them again.
+ * Looking up a word takes one hash, a pilot, and one comparison with the
+ * term of the identifier, which tells words outside of the vocabulary
+ * apart.
+ * The words are kept in a word table, which removes duplicates.
+ */
+typedef struct vocabulary_t {
+	size_t size;
+	size_t number_buckets;
+	uint64_t *pilots;
+	vocabulary_term *terms;
+	word_table words;
+} vocabulary;
+
+/**
+ * Counts of the words of a vocabulary, indexed by their identifiers, and
+ * a word table of the words outside of the vocabulary.
+ * Counts of the same vocabulary are merged by adding the arrays.
+ */
+typedef struct vocabulary_counts_t {
+	const vocabulary *vocab;
+	uint64_t *counts;
+	word_table overflow;
+} vocabulary_counts;
+
+/**
+ * Builds the vocabulary of the words in the given text, one per line.
+ * Anything after a tab is ignored, so that an output file of wfc may serve
+ * as the vocabulary, and empty lines are skipped.
+ * The words are stored with their case folded like by word_fold if fold is
+ * not zero.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory or
+ * no perfect hash is found.
+ */
+int vocabulary_build(vocabulary *vocab, const char *text, size_t length,
+		int fold);
+
+/**
+ * Frees the given vocabulary.
+ */
+void vocabulary_free(vocabulary *vocab);
+
+/**
+ * Returns the bucket of the word with the given hash.
+ */
+static inline size_t vocabulary_bucket(const vocabulary *vocab,
+		uint64_t hash) {
+	return (size_t) (((hash >> 32) * vocab->number_buckets) >> 32);
+}
+
+/**
+ * Returns the identifier of the word with the given hash, if its bucket has
+ * the given mixed pilot.
+ * The multiplication carries each bit of the hash into the high bits of
+ * the product, so that words whose hashes differ in any bits are moved
+ * apart.
+ */
+static inline size_t vocabulary_position(const vocabulary *vocab,
+		uint64_t hash, uint64_t pilot) {
+	uint64_t h = ((hash ^ pilot) * 0x9e3779b97f4a7c15ULL) >> 32;
+
+	return (size_t) ((h * vocab->size) >> 32);
+}
+
+/**
+ * Returns the identifier of the given word, whose case is folded like by
+ * word_fold if fold is not zero, or VOCABULARY_MISSING if the word
+ * is not in the vocabulary.
+ * A word outside of the vocabulary takes the identifier of another word,
+ * which tells them apart.
+ */
+static inline size_t vocabulary_find(const vocabulary *vocab,
+		const char *word, size_t length, int fold) {
+	uint64_t hash;
+	size_t id;
+	const vocabulary_term *term;
+
+	if (vocab->size == 0) {
+		return VOCABULARY_MISSING;
+	}
+
+	hash = word_hash64(word, length, fold);
+	id = vocabulary_position(vocab, hash,
+			vocab->pilots[vocabulary_bucket(vocab, hash)]);
+	term = &vocab->terms[id];
+	if ((term->hash != hash) || (term->length != length)
+			|| !(fold ? word_equal(term->word, word, length, fold) :
+					(memcmp(term->word, word, length) == 0))) {
+		return VOCABULARY_MISSING;
+	}
+
+	return id;
+}
+
+/**
+ * Initializes zero counts of the given vocabulary.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int vocabulary_counts_init(vocabulary_counts *counts, const vocabulary *vocab);
+
+/**
+ * Frees the given counts.
+ */
+void vocabulary_counts_free(vocabulary_counts *counts);
+
+/**
+ * Counts one occurrence of the given word, whose case is folded like by
+ * word_fold if fold is not zero.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static inline int vocabulary_counts_add(vocabulary_counts *counts,
+		const char *word, size_t length, int fold) {
+	size_t id = vocabulary_find(counts->vocab, word, length, fold);
+
+	if (id != VOCABULARY_MISSING) {
+		counts->counts[id]++;
+		return EXIT_SUCCESS;
+	}
+
+	return fold ? word_table_add_folded(&counts->overflow, word, length, 1) :
+			word_table_add(&counts->overflow, word, length, 1);
+}
+
+/**
+ * Adds the counts of the identifiers in [begin, end) of source to those of
+ * destination, which count the same vocabulary.
+ */
+void vocabulary_counts_add_range(vocabulary_counts *destination,
+		const vocabulary_counts *source, size_t begin, size_t end);
+
+/**
+ * Adds the counts of source, including the words outside of the
+ * vocabulary, to destination, which counts the same vocabulary.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int vocabulary_counts_merge(vocabulary_counts *destination,
+		const vocabulary_counts *source);
+
+/**
+ * Returns the number of distinct words which the given counts counted.
+ */
+size_t vocabulary_counts_size(const vocabulary_counts *counts);
+
+/**
+ * Stores the counted words and their counts in words, which must hold
+ * vocabulary_counts_size words: the words of the vocabulary which occurred
+ * and the words outside of it.
+ * The words are not sorted and stay valid until the vocabulary or the
+ * counts are freed.
+ * Returns the number of words stored.
+ */
+size_t vocabulary_counts_words(const vocabulary_counts *counts,
+		word_count *words);
+
+#endif /* VOCABULARY_H_ */
@@ -10,420 +10,662 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <errno.h>
 #include <getopt.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "checkpoint.h"
+#include "corpus.h"
+#include "counter.h"
+#include "decompress.h"
+#include "input.h"
+#include "output.h"
+#include "partial.h"
+#include "progress.h"
+#include "ranking.h"
+#include "schedule.h"
+#include "serve.h"
+#include "sketch.h"
+#include "stats.h"
+#include "stream.h"
+#include "tokenizer.h"
+#include "topology.h"
+#include "vocabulary.h"
+#include "word_table.h"
 
-#define DEFAULT_NUMBER_CHILDS 4
 #define DEFAULT_INPUT_FILE "test_in.txt"
 #define DEFAULT_OUTPUT_FILE "test_out.txt"
-#define MAX_WORD_LENGTH 64
 
-/**
- * Pair of word and its frequency.
+#define ENGINE_PROCESSES 0
+#define ENGINE_THREADS 1
+#define ENGINE_APPROXIMATE 2
+#define ENGINE_VOCABULARY 3
+
+/*
+ * Values of long options without a short option.
+ */
+#define OPTION_PROCESSES 256
+#define OPTION_THREADS 257
+#define OPTION_STREAM 258
+#define OPTION_CHUNK_SIZE 259
+#define OPTION_RANGE 260
+#define OPTION_CHECKPOINT 261
+#define OPTION_FILE_LIST 262
+#define OPTION_PIN 263
+#define OPTION_STATS 264
+#define OPTION_PROGRESS 265
+#define OPTION_UTF8 266
+#define OPTION_FOLD_CASE 267
+#define OPTION_TRIM 268
+#define OPTION_SERVE 269
+#define OPTION_APPROXIMATE 270
+#define OPTION_VOCABULARY 271
+
+/*
+ * Number of chunks per thread which may be in flight in streaming mode.
+ */
+#define CHUNKS_PER_THREAD 2
+
+/*
+ * Bytes at the beginning of the shared memory of the process engine which
+ * hold the head of the queue of tasks.
+ * The children share it as a lock-free atomic, which works across
+ * processes.
  */
-typedef struct word_count_t {
-	int count;
-	const char *word;
-} word_count;
+#define TASK_QUEUE_SIZE 16
+static_assert(std::atomic<size_t>::is_always_lock_free,
+		"the queue of tasks needs lock-free atomics");
 
 /**
- * Comparator function for map from strings.
+ * Location of the serialized word table which a child process published
+ * in its result segment.
+ * The parent process allocates one of these per child in shared memory.
  */
-static bool cmp_str(const char *lhs, const char *rhs) {
-	return (strcmp(lhs, rhs) < 0);
-}
+typedef struct child_result_t {
+	int shmid;
+	size_t length;
+	size_t number_words;
+} child_result;
 
 /**
- * Comparison method for two word_count objects.
- * Returns an integer less than, equal to, or greater to zero,
- * if the first argument count is lexicographically smaller than,
- * equal to, or less than the second argument count.
+ * Words and their frequencies which an engine counted.
+ * The words point into the word tables or the attached result segments
+ * of the reducers, into the merged sketch in approximate mode, or into
+ * the vocabulary and the merged counts of the vocabulary engine, which
+ * are released along with the words (except for the vocabulary).
  */
-static int cmp_int_desc(const void *p1, const void *p2) {
-	word_count *wc1 = (word_count *) p1;
-	word_count *wc2 = (word_count *) p2;
+typedef struct count_result_t {
+	word_count *words;
+	size_t different_words;
+	int number_reducers;
+	word_table *tables;
+	char **segments;
+	heavy_hitters *sketch;
+	vocabulary_counts *counts;
+} count_result;
 
-	return wc2->count - wc1->count;
-}
+/**
+ * Function which a worker (child process or thread) executes.
+ * Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+typedef int (*worker_function)(int worker, void *arg);
 
 /**
- * Returns zero, iff the given character is skippable, i.e. the given
- * character does not belong to a word.
+ * Prunes the resources which were dynamically allocated by the parent
+ * process.
  */
-static int isskip(char c) {
-	return !((c >= 'a') && (c <= 'z')) && !((c >= 'A') && (c <= 'Z'))
-			&& (c != '-') && (c != '\'');
+static void prune_parent_mem(void *shm, int shmid) {
+	if (shm) {
+		shmdt(shm);
+		shmctl(shmid, IPC_RMID, NULL);
+	}
 }
 
 /**
- * Returns the index of the next skippable (if skip is not zero) or word character
- * (if skip is zero) in the buffer, beginning at buffer offset 'offset'.
- * If no such character is found, buffer_length, will be returned.
+ * Publishes the given word table of a child process in a new shared
+ * memory segment, the result segment.
+ * The segment holds the table in its serialized form, which groups the
+ * words into the given number of partitions.
+ * The identifier, length, and number of words of the result segment are
+ * stored in result.
  */
-static long int seek_next(char *buffer, size_t offset, size_t buffer_length,
-		int skip) {
-	size_t i;
+static int publish_table(word_table *table, size_t partitions,
+		child_result *result) {
+	size_t length = word_table_serialized_length(table, partitions);
+	int shmid = -1;
+	char *shm = NULL;
 
-	for (i = offset; i < buffer_length; i++) {
-		int skip_char = isskip(buffer[i]);
+	result->shmid = -1;
+	result->length = length;
+	result->number_words = table->size;
 
-		if ((skip && skip_char) || (!skip && !skip_char)) {
-			break;
-		}
+	shmid = shmget(IPC_PRIVATE, length, S_IRUSR | S_IWUSR);
+	if (shmid < 0) {
+		perror("shmget");
+		return EXIT_FAILURE;
+	}
+
+	shm = (char *) shmat(shmid, NULL, 0);
+	if (shm == (char *) -1) {
+		perror("shmat");
+		shmctl(shmid, IPC_RMID, NULL);
+		return EXIT_FAILURE;
 	}
 
-	return i;
+	word_table_serialize(table, shm, partitions);
+
+	shmdt(shm);
+	result->shmid = shmid;
+
+	return EXIT_SUCCESS;
 }
 
 /**
- * Returns the index of the next word character in the buffer, beginning at buffer
- * offset 'offset'.
- * If no such character is found, buffer_length, will be returned.
+ * Removes the result segments of the given children.
  */
-static long int seek_next_nonskip(char *buffer, size_t offset,
-		size_t buffer_length) {
-	return seek_next(buffer, offset, buffer_length, 0);
+static void remove_results(child_result *results, int no_childs) {
+	for (int i = 0; i < no_childs; i++) {
+		if (results[i].shmid >= 0) {
+			shmctl(results[i].shmid, IPC_RMID, NULL);
+			results[i].shmid = -1;
+		}
+	}
 }
 
 /**
- * Returns the index of the next skippable character in the buffer, beginning at
- * buffer offset 'offset'.
- * If no such character is found, buffer_length, will be returned.
+ * Counter into which a mapper counts the words it parses: a word table,
+ * a sketch in approximate mode, or the counts of a vocabulary.
  */
-static long int seek_next_skip(char *buffer, size_t offset,
-		size_t buffer_length) {
-	return seek_next(buffer, offset, buffer_length, 1);
-}
+typedef struct count_target_t {
+	word_table *table;
+	heavy_hitters *sketch;
+	vocabulary_counts *counts;
+} count_target;
 
 /**
- * Prunes the resources which were dynamically allocated by the parent
- * process.
+ * Counts the words which start in the byte range [start, end) of input in
+ * the given target (see count_range) with the tokenizer of the process.
  */
-static void prune_parent_mem(void *shm, int shmid,
-		char **child_word_buffer_offsets, size_t **child_number_words_offsets) {
-	if (shm) {
-		shmdt(shm);
-		shmctl(shmid, IPC_RMID, NULL);
-	}
-	if (child_word_buffer_offsets) {
-		free(child_word_buffer_offsets);
+static inline int count_into(const count_target *target,
+		const input_data *input, size_t start, size_t end, size_t *tokens) {
+	const tokenizer *tok = tokenizer_default();
+
+	if (target->sketch) {
+		return count_range_sketch(tok, input, start, end, target->sketch,
+				tokens);
 	}
-	if (child_number_words_offsets) {
-		free(child_number_words_offsets);
+	if (target->counts) {
+		return count_range_vocabulary(tok, input, start, end, target->counts,
+				tokens);
 	}
+
+	return count_range(tok, input, start, end, target->table, tokens);
 }
 
 /**
- * Prunes the resources which were dynamically allocated by a child
- * process.
+ * Counts the words of the chunks of the byte range of the given queue,
+ * which the given worker claims or steals until none is left, in target.
+ * The bytes of the chunks are added to stats and progress, unless they are
+ * NULL.
  */
-static void prune_child_mem(FILE *inputfd, char *buffer) {
-	if (inputfd) {
-		fclose(inputfd);
-	}
-	if (buffer) {
-		free(buffer);
+static int count_chunks(const input_data *input, chunk_queue *chunks,
+		int worker, const count_target *target, worker_stats *stats,
+		progress_counters *progress) {
+	size_t chunk_start, chunk_end;
+	int status = EXIT_SUCCESS;
+
+	while ((status == EXIT_SUCCESS)
+			&& chunk_queue_next(chunks, worker, &chunk_start, &chunk_end)) {
+		size_t tokens = 0;
+
+		status = count_into(target, input, chunk_start, chunk_end, &tokens);
+		progress_add(progress, chunk_end - chunk_start, tokens);
+		if (stats) {
+			stats->bytes += chunk_end - chunk_start;
+		}
 	}
+
+	return status;
 }
 
 /**
- * The child process parses the input file and writes each word followed
- * by a null byte into shared memory, starting at word_buffer.
- * It also saves the number of words written at number_words.
- * It looks for the first complete word in the file, beginning at file_offset.
- * Words which do not begin at file_offset are ignored.
- * Words that start before or at end - 1 are parsed and written into shared memory.
+ * Counts the words of the chunks of the given stream, which the thread
+ * takes as they become available, in target.
+ * The bytes of the chunks are added to stats and progress, unless they are
+ * NULL.
  */
-static int child_parse(const char * inputfname, size_t file_offset, size_t end,
-		char *word_buffer, size_t *number_words) {
-	/*
-	 * Leave space for characters between file_offset (inclusive) and end (exclusive).
-	 * Additionally, leave space for previous byte (the byte before file_offset) and
-	 * last word.
-	 * Note that space for skip character is available, if last word starts before or
-	 * at end - 1, as specified.
-	 */
-	const size_t buffer_size = end - file_offset + MAX_WORD_LENGTH + 1;
-	char *buffer = NULL;
-	size_t buffer_end = 0;
-	size_t parse_position = 0;
-	size_t parse_bound = end - file_offset;
-	char *shm_offset = word_buffer;
-	size_t word_counter = 0;
-	FILE *inputfd = NULL;
-
-	inputfd = fopen(inputfname, "r");
-	if (!inputfd) {
-		fprintf(stderr, "Could not open input file!\n");
-		exit(EXIT_FAILURE);
-	}
+static int count_stream(chunk_stream *stream, const count_target *target,
+		worker_stats *stats, progress_counters *progress) {
+	int status = EXIT_SUCCESS;
+	int chunk;
 
-	buffer = (char *) malloc(sizeof(char) * buffer_size);
-	if (!buffer) {
-		fprintf(stderr, "Not enough memory!\n");
-		prune_child_mem(inputfd, buffer);
-		return EXIT_FAILURE;
-	}
+	while ((chunk = chunk_stream_next(stream)) >= 0) {
+		input_data input;
+		size_t tokens = 0;
 
-	if (file_offset > 0) {
-		fseek(inputfd, file_offset - 1, SEEK_SET);
-	} else {
-		fseek(inputfd, 0, SEEK_SET);
-	}
+		input.data = stream->chunks[chunk].data;
+		input.length = stream->chunks[chunk].length;
+		input.mapped = 0;
 
-	// fill the buffer with file content
-	if ((buffer_end = fread(buffer, sizeof(char), buffer_size, inputfd)) < 0) {
-		prune_child_mem(inputfd, buffer);
-		return EXIT_FAILURE;
+		if (status == EXIT_SUCCESS) {
+			status = count_into(target, &input, 0, input.length, &tokens);
+		}
+		progress_add(progress, input.length, tokens);
+		if (stats) {
+			stats->bytes += input.length;
+		}
+
+		chunk_stream_release(stream, chunk);
 	}
 
-	// prepare parsing of words in buffer
-	if (file_offset > 0) {
-		// take a look at the previous character
+	return status;
+}
 
-		if (isskip(buffer[0])) {
-			// seek for the next word
-			parse_position = seek_next_nonskip(buffer, 1, buffer_end);
-		} else {
-			// previous character belongs to a word
-
-			if ((end - file_offset) > 1) {
-				// we have at least one character to parse
-				if (isskip(buffer[1])) {
-					// seek for the next word
-					parse_position = seek_next_nonskip(buffer, 2, buffer_end);
-				} else {
-					// skip current word and proceed with next one
-					parse_position = seek_next_skip(buffer, 2, buffer_end);
-					parse_position = seek_next_nonskip(buffer, parse_position,
-							buffer_end);
-				}
-			} else {
-				// we do not have content to parse
-				parse_position = 1;
+/**
+ * Counts the words of the tasks of the given corpus in target.
+ * The worker takes tasks from the queue, whose head is next_task, until
+ * none is left.
+ * It keeps the file of its last task open, as consecutive tasks are often
+ * chunks of the same file.
+ * The bytes of the tasks are added to stats and progress, unless they are
+ * NULL.
+ */
+static int count_corpus(const corpus *files, std::atomic<size_t> *next_task,
+		const count_target *target, worker_stats *stats,
+		progress_counters *progress) {
+	input_data input = { NULL, 0, 0 };
+	size_t input_file = SIZE_MAX;
+	size_t task_number;
+	int status = EXIT_SUCCESS;
+
+	while ((status == EXIT_SUCCESS) && ((task_number = next_task->fetch_add(1,
+			std::memory_order_relaxed)) < files->number_tasks)) {
+		const corpus_task *task = &files->tasks[task_number];
+		size_t tokens = 0;
+
+		if (task->file != input_file) {
+			input_close(&input);
+			input_file = SIZE_MAX;
+			if (input_open(files->files[task->file].name, &input)
+					!= EXIT_SUCCESS) {
+				status = EXIT_FAILURE;
+				break;
 			}
+			input_file = task->file;
 		}
 
-		/*
-		 * We have a previous byte in buffer.
-		 * This shifts our bound forward.
-		 */
-		parse_bound++;
-	} else {
-		// we are at the beginning of the document
-		parse_position = 0;
+		status = count_into(target, &input, std::min(task->start, input.length),
+				std::min(task->end, input.length), &tokens);
+		progress_add(progress, std::min(task->end, input.length)
+				- std::min(task->start, input.length), tokens);
+		if (stats) {
+			stats->bytes += std::min(task->end, input.length)
+					- std::min(task->start, input.length);
+		}
 	}
 
-	// start parsing words
-	while ((parse_position < buffer_end) && (parse_position < parse_bound)) {
-		long int next_parse_position = seek_next_skip(buffer, parse_position,
-				buffer_end);
-		long int word_length = next_parse_position - parse_position;
+	input_close(&input);
+
+	return status;
+}
 
-		// copy word to shared memory
-		memcpy(shm_offset, &buffer[parse_position], sizeof(char) * word_length);
-		shm_offset += word_length;
+/**
+ * Input which the mappers of an engine count.
+ * This is either the byte range [start, end) of input, which is split into
+ * chunks that the mappers claim or steal, or the tasks of files, which the
+ * mappers take from a shared queue, or the chunks of stream (thread engine
+ * only).
+ */
+typedef struct count_input_t {
+	const input_data *input;
+	size_t start;
+	size_t end;
+	const corpus *files;
+	chunk_stream *stream;
+} count_input;
 
-		// write terminating null byte
-		*shm_offset = 0;
-		shm_offset++;
+/**
+ * Counts the words of the share of the given mapper of source in target.
+ * The mappers share next_task, the head of the queue of tasks of a corpus,
+ * and chunks, the queue of chunks of a byte range.
+ * The bytes which the mapper counts are added to its statistics and
+ * progress counters, if any.
+ */
+static int count_source(const count_input *source, int mapper,
+		std::atomic<size_t> *next_task, chunk_queue *chunks,
+		const count_target *target) {
+	worker_stats *stats = stats_mapper(mapper);
+	progress_counters *progress = progress_mapper(mapper);
+
+	if (source->files) {
+		return count_corpus(source->files, next_task, target, stats, progress);
+	}
+	if (source->stream) {
+		return count_stream(source->stream, target, stats, progress);
+	}
 
-		word_counter++;
+	return count_chunks(source->input, chunks, mapper, target, stats,
+			progress);
+}
 
-		parse_position = seek_next_nonskip(buffer, next_parse_position,
-				buffer_end);
+/**
+ * Returns the number of bytes of the given source, or zero if it is
+ * unknown, as for a stream.
+ */
+static size_t source_length(const count_input *source) {
+	if (source->files) {
+		return source->files->length;
+	}
+	if (source->stream) {
+		return 0;
 	}
 
-	*number_words = word_counter;
+	return source->end - source->start;
+}
 
-	// free resources
-	prune_child_mem(inputfd, buffer);
+/**
+ * Merges the given partition of each of the given serialized word tables
+ * into table.
+ * This is the reduce step, which a worker performs for the partition it
+ * owns.
+ * If top_k is not zero, only the top_k most frequent words of the partition
+ * are kept. As partitions are disjoint, the overall top_k words are among
+ * those of the partitions.
+ * The table of the whole partition is recorded in the statistics of the
+ * reducer, if any.
+ */
+static int reduce_partition(const char **buffers, int number_buffers,
+		size_t partition, size_t top_k, word_table *table) {
+	for (int i = 0; i < number_buffers; i++) {
+		if (word_table_merge_serialized(table, buffers[i], partition)
+				!= EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			return EXIT_FAILURE;
+		}
+	}
+	stats_table(stats_reducer(partition), table);
+
+	if (top_k && (top_k_keep(table, top_k) != EXIT_SUCCESS)) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
 
 	return EXIT_SUCCESS;
 }
 
 /**
- * Fills a given word to frequency map with the given words from the child.
- *
- * This function reads the parsed words from the given shared memory location.
- * The child processes must have filled the shared memory with file content
- * beforehand.
- * Each word in shared memory must be separated by exactly one null byte.
- * This function stores the parsed words in a map which uses the word as the
- * key and the frequency as the value.
- */
-static void fill_table(
-		std::map<const char *, int, bool (*)(const char *, const char *)> &word_table,
-		const char *child_word_buffer_offset, size_t child_number_words) {
-	const char *word_offset = child_word_buffer_offset;
-
-	// fill map from word to count
-	for (size_t i = 0; i < child_number_words; i++) {
-		std::map<const char *, int>::iterator it = word_table.find(word_offset);
-
-		if (it != word_table.end()) {
-			it->second++;
-		} else {
-			word_table.insert(std::pair<const char *, int>(word_offset, 1));
-		}
+ * Appends the words of the given table to the word array of result.
+ */
+static void collect_table(count_result *result, const word_table *table) {
+	for (size_t i = 0; i < table->capacity; i++) {
+		if (table->slots[i].word) {
+			word_count *word = &result->words[result->different_words++];
 
-		word_offset += strlen(word_offset) + 1;
+			word->word = table->slots[i].word;
+			word->count = table->slots[i].count;
+		}
 	}
 }
 
 /**
- * Parent process aggregates results, after child processes had finished.
- * The given table maps from words to their frequency.
- * The parent process builds an array from the map that it sorts in descending frequency order.
- * Finally, the parent process writes the results into a file.
+ * Appends the words of the given serialized table, which has a single
+ * partition, to the word array of result.
  */
-static int aggregate_results(const char *outputfname,
-		std::map<const char *, int, bool (*)(const char *, const char *)> &word_table) {
-	word_count *words = NULL;
-	size_t different_words = word_table.size();
-	FILE *outputfd = NULL;
+static void collect_serialized(count_result *result, const char *buffer) {
+	const word_partition *index = word_serialized_partition(buffer, 0);
+	const word_record *record = (const word_record *) (buffer + index->offset);
 
-	// create word array
-	words = (word_count *) malloc(sizeof(word_count) * different_words);
+	for (uint64_t i = 0; i < index->number_words; i++) {
+		word_count *word = &result->words[result->different_words++];
 
-	// fill word array
-	{
-		size_t i;
-		std::map<const char *, int>::iterator it;
+		word->word = word_record_word(record);
+		word->count = record->count;
+		record = word_record_next(record);
+	}
+}
 
-		for (i = 0, it = word_table.begin(); i < different_words; i++, it++) {
-			words[i].word = it->first;
-			words[i].count = it->second;
+/**
+ * Releases the words of the given result along with the tables or result
+ * segments they point into.
+ */
+static void count_result_free(count_result *result) {
+	for (int i = 0; i < result->number_reducers; i++) {
+		if (result->tables) {
+			word_table_free(&result->tables[i]);
+		}
+		if (result->segments && result->segments[i]) {
+			shmdt(result->segments[i]);
 		}
 	}
 
-	// sort words according to count in descending order
-	qsort(words, different_words, sizeof(word_count), cmp_int_desc);
+	if (result->sketch) {
+		heavy_hitters_free(result->sketch);
+	}
+	if (result->counts) {
+		vocabulary_counts_free(result->counts);
+	}
 
-	// write output file
-	outputfd = fopen(outputfname, "w");
+	free(result->tables);
+	free(result->segments);
+	free(result->words);
+	free(result->sketch);
+	free(result->counts);
+	result->tables = NULL;
+	result->segments = NULL;
+	result->words = NULL;
+	result->sketch = NULL;
+	result->counts = NULL;
+	result->different_words = 0;
+	result->number_reducers = 0;
+}
 
-	for (size_t i = 0; i < different_words; i++) {
-		int written = fprintf(outputfd, "%s\t%d\n", words[i].word,
-				words[i].count);
+/**
+ * Forks no_childs child processes, each of which executes function, and
+ * waits for them to terminate.
+ * Returns EXIT_SUCCESS, iff all child processes terminated successfully.
+ */
+static int run_children(int no_childs, worker_function function, void *arg) {
+	int forked = 0;
+	int error = 0;
 
-		if (written < 0) {
-			fclose(outputfd);
-			free(words);
-			return EXIT_FAILURE;
+	// create child processes
+	for (int i = 0; i < no_childs; i++) {
+		pid_t cpid = fork();
+
+		if (cpid == -1) {
+			perror("fork");
+			error = 1;
+			break;
+		}
+
+		if (cpid == 0) {
+			// child code
+			int status;
+
+			topology_pin(i);
+			status = function(i, arg);
+
+			// break loop: child must not fork child processes.
+			_exit(status);
 		}
+
+		forked++;
 	}
 
-	// free resources
-	fclose(outputfd);
-	free(words);
+	/*
+	 * Child processes forked.
+	 * Wait for child processes to finish.
+	 */
+	for (int i = 0; i < forked; i++) {
+		int status;
 
-	return EXIT_SUCCESS;
+		wait(&status);
+
+		if (!WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS)) {
+			fprintf(stderr, "Child exited with an error!\n");
+			error = 1;
+		}
+	}
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 /**
- * Main program. Let child processes parse the input file.
- * Parent process aggregates results and writes them to an output file.
+ * Arguments of the children of the process engine.
  */
-int main(int argc, char *argv[]) {
-	int no_childs = -1;
-	FILE * inputfd = NULL;
-	const char * inputfname = NULL;
-	const char * outputfname = NULL;
-	long int inputfs = -1;
-	size_t chars_per_child = 0;
-	int shmid = -1;
-	char *shm = NULL;
-	char **child_word_buffer_offsets = NULL;
-	size_t **child_number_words_offsets = NULL;
-	size_t child_word_buffer_length = 0;
-	int error = 0;
-	int opt = -1;
-	std::map<pid_t, int> cpid_table;
+typedef struct process_work_t {
+	const count_input *source;
+	int no_childs;
+	size_t top_k;
+	std::atomic<size_t> *next_task;
+	chunk_queue *chunks;
+	child_result *mapper_results;
+	child_result *reducer_results;
+} process_work;
 
-	// set arguments to default values
-	no_childs = DEFAULT_NUMBER_CHILDS;
-	inputfname = DEFAULT_INPUT_FILE;
-	outputfname = DEFAULT_OUTPUT_FILE;
+/**
+ * Map step of a child process.
+ * The child process counts the words which start in its part of the input
+ * in a local word table.
+ * Afterwards, it publishes the table partitioned by hash in a result
+ * segment, which is described by its mapper result.
+ */
+static int child_parse(int child, void *arg) {
+	process_work *work = (process_work *) arg;
+	worker_stats *stats = stats_mapper(child);
+	word_table table;
+	count_target target = { &table, NULL, NULL };
+	int status;
+
+	stats_worker_begin(stats);
+	if (word_table_init(&table, 0) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
 
-	// argument parsing
-	while ((opt = getopt(argc, argv, "p:i:o:")) != -1) {
-		switch (opt) {
-		case 'p':
-			no_childs = atoi(optarg);
-			if (no_childs < 1) {
-				fprintf(stderr, "parallelism must be at least one!\n");
-				exit(EXIT_FAILURE);
-			}
-			break;
+	status = count_source(work->source, child, work->next_task, work->chunks,
+			&target);
+	stats_table(stats, &table);
+	if (status == EXIT_SUCCESS) {
+		double start = stats ? stats_now() : 0;
 
-		case 'i':
-			inputfname = optarg;
-			break;
+		status = publish_table(&table, work->no_childs,
+				&work->mapper_results[child]);
+		if (stats) {
+			stats->publish_seconds = stats_now() - start;
+		}
+	}
 
-		case 'o':
-			outputfname = optarg;
-			break;
+	// free resources
+	word_table_free(&table);
+	stats_worker_end(stats);
 
-		default: /* '?' */
-			fprintf(stderr,
-					"Usage: %s [-p <parallelism>] [-i <input file>] [-o <output file>]\n",
-					argv[0]);
-			exit(EXIT_FAILURE);
-			break;
+	return status;
+}
+
+/**
+ * Reduce step of a child process.
+ * The child process owns the partition with its number.
+ * It merges this partition of the result segments of all mappers and
+ * publishes the merged table in a result segment, which is described by
+ * its reducer result.
+ */
+static int child_reduce(int child, void *arg) {
+	process_work *work = (process_work *) arg;
+	worker_stats *stats = stats_reducer(child);
+	const char **buffers = (const char **) calloc(work->no_childs,
+			sizeof(char *));
+	word_table table;
+	int status = EXIT_SUCCESS;
+
+	stats_worker_begin(stats);
+	if (!buffers || (word_table_init(&table, 0) != EXIT_SUCCESS)) {
+		fprintf(stderr, "Not enough memory!\n");
+		free(buffers);
+		return EXIT_FAILURE;
+	}
+
+	// attach the result segments of the mappers
+	for (int i = 0; (i < work->no_childs) && (status == EXIT_SUCCESS); i++) {
+		char *buffer = (char *) shmat(work->mapper_results[i].shmid, NULL,
+				SHM_RDONLY);
+
+		if (buffer == (char *) -1) {
+			perror("shmat");
+			status = EXIT_FAILURE;
+		} else {
+			buffers[i] = buffer;
 		}
 	}
 
-	// get file size
-	inputfd = fopen(inputfname, "r");
-	if (!inputfd) {
-		fprintf(stderr, "Could not open input file!\n");
-		exit(EXIT_FAILURE);
+	if (status == EXIT_SUCCESS) {
+		status = reduce_partition(buffers, work->no_childs, child,
+				work->top_k, &table);
 	}
-	fseek(inputfd, 0, SEEK_END);
-	inputfs = ftell(inputfd);
-	fclose(inputfd);
+	if (status == EXIT_SUCCESS) {
+		double start = stats ? stats_now() : 0;
 
-	if (inputfs < 0) {
-		fprintf(stderr, "Cannot obtain input file size!\n");
-		exit(EXIT_FAILURE);
-	} else if (inputfs == 0) {
-		fprintf(stdout, "Input file is empty. We are done.\n");
-		exit(EXIT_SUCCESS);
-	} else {
-		// inputfs > 0
-		if (inputfs < no_childs) {
-			no_childs = inputfs;
+		status = publish_table(&table, 1, &work->reducer_results[child]);
+		if (stats) {
+			stats->publish_seconds = stats_now() - start;
 		}
 	}
 
-	fprintf(stdout,
-			"Starting word frequency count using the following options:\n\nParallelism: %d\nInput file: %s\nOutput file: %s\n",
-			no_childs, inputfname, outputfname);
+	// free resources
+	for (int i = 0; i < work->no_childs; i++) {
+		if (buffers[i]) {
+			shmdt(buffers[i]);
+		}
+	}
+	free(buffers);
+	word_table_free(&table);
+	stats_worker_end(stats);
+
+	return status;
+}
 
-	chars_per_child = (size_t) (inputfs / no_childs + 1);
+/**
+ * Process engine.
+ * Forks no_childs child processes which parse the chunks or tasks of the
+ * source, which they take from a queue in shared memory, and partition
+ * their words by hash (map).
+ * Then, forks no_childs child processes, the i-th of which merges the
+ * i-th partition of all mappers (reduce).
+ * As the partitions are disjoint, the parent only collects the words of
+ * the reducers into result.
+ * If top_k is not zero, each reducer only publishes its top_k most
+ * frequent words.
+ */
+static int count_with_processes(const count_input *source, int no_childs,
+		size_t top_k, count_result *result) {
+	int shmid = -1;
+	char *shm = NULL;
+	process_work work;
+	int error = 0;
 
 	/*
 	 * Allocate shared memory.
-	 * Leave space for chars to parse per + MAX_WORD_LENGTH per child.
-	 * As a child parses the last word only if the last word starts before
-	 * or at the chars_per_child - 1, we have a space for an ending null
-	 * byte.
-	 * Additionally, leave space for number of parsed words per child.
+	 * Each child publishes its table in a result segment of its own,
+	 * which is sized to the child's vocabulary.
+	 * Hence, the shared memory which the parent allocates only holds the
+	 * queues of chunks and tasks and describes the result segment of each
+	 * mapper and reducer.
 	 */
-	child_word_buffer_length = sizeof(char)
-			* (chars_per_child + MAX_WORD_LENGTH);
-	shmid = shmget(IPC_PRIVATE,
-			no_childs * (child_word_buffer_length + sizeof(size_t)),
-			S_IRUSR | S_IWUSR);
+	shmid = shmget(IPC_PRIVATE, chunk_queue_size(no_childs) + TASK_QUEUE_SIZE
+			+ 2 * no_childs * sizeof(child_result), S_IRUSR | S_IWUSR);
 
 	if (shmid < 0) {
 		perror("shmget");
-		exit(EXIT_FAILURE);
+		return EXIT_FAILURE;
 	}
 
 	// attach the shared memory
@@ -431,108 +673,1470 @@ int main(int argc, char *argv[]) {
 
 	if (shm == (char *) -1) {
 		perror("shmat");
-		exit(EXIT_FAILURE);
+		shmctl(shmid, IPC_RMID, NULL);
+		return EXIT_FAILURE;
 	}
 
-	// compute offsets
-	child_word_buffer_offsets = (char **) malloc(sizeof(char *) * no_childs);
-	child_number_words_offsets = (size_t **) malloc(
-			sizeof(size_t *) * no_childs);
-
-	if (!child_word_buffer_offsets || !child_number_words_offsets) {
-		fprintf(stdout, "Not enough memory!\n");
-		prune_parent_mem(shm, shmid, child_word_buffer_offsets,
-				child_number_words_offsets);
-		exit(EXIT_FAILURE);
+	work.source = source;
+	work.no_childs = no_childs;
+	work.top_k = top_k;
+	work.chunks = chunk_queue_init(shm, source->start, source->end, 0,
+			no_childs);
+	work.next_task = new (shm + chunk_queue_size(no_childs))
+			std::atomic<size_t>(0);
+	work.mapper_results = (child_result *) (shm + chunk_queue_size(no_childs)
+			+ TASK_QUEUE_SIZE);
+	work.reducer_results = work.mapper_results + no_childs;
+
+	for (int i = 0; i < 2 * no_childs; i++) {
+		work.mapper_results[i].shmid = -1;
 	}
-
-	for (int i = 0; i < no_childs; i++) {
-		child_word_buffer_offsets[i] = shm + i * child_word_buffer_length;
-		child_number_words_offsets[i] = ((size_t *) (shm
-				+ no_childs * child_word_buffer_length)) + i;
+	stats_set_workers(no_childs);
+	progress_begin(no_childs, source_length(source));
+
+	// map
+	stats_phase_begin("map");
+	error = run_children(no_childs, child_parse, &work);
+	stats_phase_end();
+
+	// reduce
+	if (!error) {
+		progress_phase("reduce");
+		stats_phase_begin("reduce");
+		error = run_children(no_childs, child_reduce, &work);
+		stats_phase_end();
 	}
+	remove_results(work.mapper_results, no_childs);
 
-	// create child processes
-	for (int i = 0; i < no_childs; i++) {
-		pid_t cpid = fork();
+	// collect the words of the reducers
+	if (!error) {
+		size_t different_words = 0;
 
-		if (cpid == -1) {
-			perror("fork");
-			prune_parent_mem(shm, shmid, child_word_buffer_offsets,
-					child_number_words_offsets);
-			exit(EXIT_FAILURE);
+		progress_phase("collect");
+		stats_phase_begin("collect");
+		for (int i = 0; i < no_childs; i++) {
+			different_words += work.reducer_results[i].number_words;
 		}
 
-		if (cpid == 0) {
-			// child code
-			int status;
-			char *word_buffer_offset = child_word_buffer_offsets[i];
-			size_t *number_words_offset = child_number_words_offsets[i];
-
-			// free unused memory inherited from parent
-			free(child_word_buffer_offsets);
-			free(child_number_words_offsets);
+		result->number_reducers = no_childs;
+		result->segments = (char **) calloc(no_childs, sizeof(char *));
+		result->words = (word_count *) malloc(
+				sizeof(word_count) * (different_words + 1));
+		if (!result->segments || !result->words) {
+			fprintf(stderr, "Not enough memory!\n");
+			error = 1;
+		}
 
-			status = child_parse(inputfname, i * chars_per_child,
-					(i + 1) * chars_per_child, word_buffer_offset,
-					number_words_offset);
+		for (int i = 0; (i < no_childs) && !error; i++) {
+			char *buffer = (char *) shmat(work.reducer_results[i].shmid, NULL,
+					SHM_RDONLY);
 
-			// break loop: child must not fork child processes.
-			_exit(status);
-		} else {
-			// parent code
-			cpid_table.insert(std::pair<pid_t, int>(cpid, i));
+			if (buffer == (char *) -1) {
+				perror("shmat");
+				error = 1;
+			} else {
+				result->segments[i] = buffer;
+				collect_serialized(result, buffer);
+			}
 		}
+		stats_phase_end();
 	}
 
-	// parent code
-	{
-		std::map<const char *, int, bool (*)(const char *, const char *)> word_table(
-				cmp_str);
+	if (error) {
+		fprintf(stderr,
+				"At least one child did not terminate properly. Exiting!\n");
+	}
 
-		/*
-		 * Child processes forked.
-		 * Wait for child processes to finish.
-		 */
-		for (int i = 0; i < no_childs; i++) {
-			int status;
-			pid_t cpid;
+	// the attached result segments vanish as soon as they are detached
+	remove_results(work.reducer_results, no_childs);
+	prune_parent_mem(shm, shmid);
 
-			cpid = wait(&status);
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-			if (!WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS)) {
-				fprintf(stderr, "Child exited with an error!\n");
-				error = 1;
-			} else if (!error) {
-				/*
-				 * Current child and all previous children terminated
-				 * successfully thus far.
-				 * Fill word table with parsed words.
-				 */
-				int i = cpid_table.find(cpid)->second;
-
-				fill_table(word_table, child_word_buffer_offsets[i],
-						*child_number_words_offsets[i]);
-			}
-		}
+/**
+ * Entry point of a thread, which stores the status of function.
+ */
+static void thread_main(worker_function function, int worker, void *arg,
+		int *status) {
+	topology_pin(worker);
+	*status = function(worker, arg);
+}
 
-		if (error) {
-			fprintf(stderr,
-					"At least one child did not terminate properly. Exiting!\n");
-			prune_parent_mem(shm, shmid, child_word_buffer_offsets,
-					child_number_words_offsets);
-			exit(EXIT_FAILURE);
+/**
+ * Starts no_threads threads, each of which executes function, and waits for
+ * them to terminate.
+ * Returns EXIT_SUCCESS, iff all threads terminated successfully.
+ */
+static int run_threads(int no_threads, worker_function function, void *arg) {
+	std::vector<std::thread> threads;
+	std::vector<int> statuses(no_threads, EXIT_SUCCESS);
+	int error = 0;
+
+	try {
+		for (int i = 0; i < no_threads; i++) {
+			threads.push_back(
+					std::thread(thread_main, function, i, arg, &statuses[i]));
 		}
+	} catch (const std::system_error &e) {
+		fprintf(stderr, "Could not create thread: %s\n", e.what());
+		error = 1;
+	}
 
-		/*
-		 * Aggregate results.
-		 */
-		error = aggregate_results(outputfname, word_table);
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+
+		if (statuses[i] != EXIT_SUCCESS) {
+			fprintf(stderr, "Thread exited with an error!\n");
+			error = 1;
+		}
 	}
 
-	// free memory
-	prune_parent_mem(shm, shmid, child_word_buffer_offsets,
-			child_number_words_offsets);
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Arguments of the threads of the thread engine.
+ */
+typedef struct thread_work_t {
+	const count_input *source;
+	int no_threads;
+	size_t top_k;
+	std::atomic<size_t> next_task;
+	chunk_queue *chunks;
+	char **mapper_buffers;
+	word_table *reducer_tables;
+	heavy_hitters *sketches;
+	vocabulary_counts *counters;
+} thread_work;
+
+/**
+ * Map step of a thread.
+ * The thread counts the words which start in its part of the input (or
+ * the chunks of the stream it takes) in a local word table, which it
+ * serializes partitioned by hash.
+ */
+static int thread_parse(int thread, void *arg) {
+	thread_work *work = (thread_work *) arg;
+	worker_stats *stats = stats_mapper(thread);
+	word_table table;
+	count_target target = { &table, NULL, NULL };
+	int status;
+
+	stats_worker_begin(stats);
+	if (word_table_init(&table, 0) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	status = count_source(work->source, thread, &work->next_task,
+			work->chunks, &target);
+	stats_table(stats, &table);
+	if (status == EXIT_SUCCESS) {
+		double start = stats ? stats_now() : 0;
+		char *buffer = (char *) malloc(
+				word_table_serialized_length(&table, work->no_threads));
+
+		if (buffer) {
+			word_table_serialize(&table, buffer, work->no_threads);
+			work->mapper_buffers[thread] = buffer;
+		} else {
+			fprintf(stderr, "Not enough memory!\n");
+			status = EXIT_FAILURE;
+		}
+		if (stats) {
+			stats->publish_seconds = stats_now() - start;
+		}
+	}
+
+	word_table_free(&table);
+	stats_worker_end(stats);
+
+	return status;
+}
+
+/**
+ * Reduce step of a thread.
+ * The thread merges the partition with its number of all mappers.
+ * It allocates its table itself, so that the table resides on the node of
+ * the thread if it is pinned.
+ */
+static int thread_reduce(int thread, void *arg) {
+	thread_work *work = (thread_work *) arg;
+	worker_stats *stats = stats_reducer(thread);
+	int status;
+
+	stats_worker_begin(stats);
+	if (word_table_init(&work->reducer_tables[thread], 0) != EXIT_SUCCESS) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	status = reduce_partition((const char **) work->mapper_buffers,
+			work->no_threads, thread, work->top_k,
+			&work->reducer_tables[thread]);
+	stats_worker_end(stats);
+
+	return status;
+}
+
+/**
+ * Map step of a thread in approximate mode.
+ * The thread counts the words which start in its part of the input (or
+ * the chunks of the stream it takes) in its sketch, which the parent
+ * merges.
+ */
+static int thread_sketch(int thread, void *arg) {
+	thread_work *work = (thread_work *) arg;
+	worker_stats *stats = stats_mapper(thread);
+	count_target target = { NULL, &work->sketches[thread], NULL };
+	int status;
+
+	stats_worker_begin(stats);
+	status = count_source(work->source, thread, &work->next_task,
+			work->chunks, &target);
+	if (stats) {
+		stats->tokens = work->sketches[thread].tokens;
+		stats->distinct_words = work->sketches[thread].size;
+	}
+	stats_worker_end(stats);
+
+	return status;
+}
+
+/**
+ * Map step of a thread of the vocabulary engine.
+ * The thread counts the words which start in its part of the input (or
+ * the chunks of the stream it takes) in its counts of the vocabulary.
+ */
+static int thread_vocabulary(int thread, void *arg) {
+	thread_work *work = (thread_work *) arg;
+	worker_stats *stats = stats_mapper(thread);
+	vocabulary_counts *counts = &work->counters[thread];
+	count_target target = { NULL, NULL, counts };
+	int status;
+
+	stats_worker_begin(stats);
+	status = count_source(work->source, thread, &work->next_task,
+			work->chunks, &target);
+	stats_table(stats, &counts->overflow);
+	if (stats) {
+		for (size_t i = 0; i < counts->vocab->size; i++) {
+			stats->tokens += counts->counts[i];
+			stats->distinct_words += (counts->counts[i] > 0);
+		}
+	}
+	stats_worker_end(stats);
+
+	return status;
+}
+
+/**
+ * Merge step of a thread of the vocabulary engine.
+ * The thread adds the counts of its part of the identifiers of all
+ * threads to the counts of the first thread.
+ */
+static int thread_add_counts(int thread, void *arg) {
+	thread_work *work = (thread_work *) arg;
+	size_t size = work->counters[0].vocab->size;
+	size_t begin = size * thread / work->no_threads;
+	size_t end = size * (thread + 1) / work->no_threads;
+
+	for (int i = 1; i < work->no_threads; i++) {
+		vocabulary_counts_add_range(&work->counters[0], &work->counters[i],
+				begin, end);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Reader thread of the streaming mode, which stores the status of the
+ * reader in error.
+ */
+static void stream_main(chunk_stream *stream, int *error) {
+	*error = (chunk_stream_read(stream) != EXIT_SUCCESS);
+}
+
+/**
+ * Runs the map step of the thread engine: starts no_threads threads which
+ * execute function, along with the reader thread if the source is a
+ * stream, and waits for them.
+ * Returns EXIT_SUCCESS, iff all threads terminated successfully.
+ */
+static int run_mappers(const count_input *source, int no_threads,
+		worker_function function, void *arg) {
+	int read_error = 0;
+	int error;
+
+	if (!source->stream) {
+		return run_threads(no_threads, function, arg);
+	}
+
+	try {
+		std::thread reader(stream_main, source->stream, &read_error);
+
+		error = run_threads(no_threads, function, arg);
+		chunk_stream_cancel(source->stream);
+		reader.join();
+		error = error || read_error;
+	} catch (const std::system_error &e) {
+		fprintf(stderr, "Could not create thread: %s\n", e.what());
+		error = 1;
+	}
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Thread engine.
+ * Starts no_threads threads which parse the chunks or tasks of the source,
+ * which they take from a queue, in the address space of the process and
+ * partition their words by hash (map).
+ * In streaming mode, the input is given by stream instead and the threads
+ * parse the chunks which a reader thread hands to them.
+ * Then, starts no_threads threads, the i-th of which merges the i-th
+ * partition of all mappers (reduce).
+ * Unlike the process engine, it needs neither fork nor shared memory.
+ * If top_k is not zero, each reducer only keeps its top_k most frequent
+ * words.
+ */
+static int count_with_threads(const count_input *source, int no_threads,
+		size_t top_k, count_result *result) {
+	thread_work work;
+	int error = 0;
+
+	work.source = source;
+	work.no_threads = no_threads;
+	work.next_task = 0;
+	work.top_k = top_k;
+	work.chunks = (chunk_queue *) aligned_alloc(sizeof(work_deque),
+			chunk_queue_size(no_threads));
+	work.mapper_buffers = (char **) calloc(no_threads, sizeof(char *));
+	work.reducer_tables = (word_table *) calloc(no_threads,
+			sizeof(word_table));
+	work.sketches = NULL;
+	work.counters = NULL;
+
+	result->number_reducers = no_threads;
+	result->tables = work.reducer_tables;
+
+	if (!work.chunks || !work.mapper_buffers || !work.reducer_tables) {
+		fprintf(stderr, "Not enough memory!\n");
+		free(work.chunks);
+		free(work.mapper_buffers);
+		return EXIT_FAILURE;
+	}
+	chunk_queue_init(work.chunks, source->start, source->end, 0, no_threads);
+	stats_set_workers(no_threads);
+	progress_begin(no_threads, source_length(source));
+
+	// map
+	stats_phase_begin("map");
+	error = (run_mappers(source, no_threads, thread_parse, &work)
+			!= EXIT_SUCCESS);
+	stats_phase_end();
+
+	// reduce
+	if (!error) {
+		progress_phase("reduce");
+		stats_phase_begin("reduce");
+		error = run_threads(no_threads, thread_reduce, &work);
+		stats_phase_end();
+	}
+
+	for (int i = 0; i < no_threads; i++) {
+		free(work.mapper_buffers[i]);
+	}
+	free(work.mapper_buffers);
+	free(work.chunks);
+
+	// collect the words of the reducers
+	if (!error) {
+		size_t different_words = 0;
+
+		progress_phase("collect");
+		stats_phase_begin("collect");
+		for (int i = 0; i < no_threads; i++) {
+			different_words += work.reducer_tables[i].size;
+		}
+
+		result->words = (word_count *) malloc(
+				sizeof(word_count) * (different_words + 1));
+		if (!result->words) {
+			fprintf(stderr, "Not enough memory!\n");
+			error = 1;
+		}
+
+		for (int i = 0; (i < no_threads) && !error; i++) {
+			collect_table(result, &work.reducer_tables[i]);
+		}
+		stats_phase_end();
+	}
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Records the given number of distinct words of the merged counts of an
+ * engine without reducers as those of the first reducer, so that the
+ * statistics report them.
+ */
+static void record_merged_words(size_t different_words) {
+	worker_stats *stats = stats_reducer(0);
+
+	if (stats) {
+		stats->distinct_words = different_words;
+	}
+}
+
+/**
+ * Approximate engine.
+ * Starts no_threads threads which count the chunks or tasks of the source
+ * (or the chunks of stream) in sketches of budget bytes each, which bound
+ * the memory regardless of the number of distinct words, and merges the
+ * sketches of the threads in the calling thread.
+ * There is no reduce step, as merging a sketch takes the same time for
+ * any input.
+ * The words of the merged sketch are stored in result, and the error
+ * bounds of the top_k most frequent of them are written to the standard
+ * output.
+ */
+static int count_approximate(const count_input *source, int no_threads,
+		size_t top_k, size_t budget, count_result *result) {
+	thread_work work;
+	heavy_hitters_bounds bounds;
+	heavy_hitters *merged;
+	int error = 0;
+
+	work.source = source;
+	work.no_threads = no_threads;
+	work.next_task = 0;
+	work.top_k = top_k;
+	work.mapper_buffers = NULL;
+	work.reducer_tables = NULL;
+	work.counters = NULL;
+	work.chunks = (chunk_queue *) aligned_alloc(sizeof(work_deque),
+			chunk_queue_size(no_threads));
+	work.sketches = (heavy_hitters *) calloc(no_threads,
+			sizeof(heavy_hitters));
+
+	if (!work.chunks || !work.sketches) {
+		fprintf(stderr, "Not enough memory!\n");
+		free(work.chunks);
+		free(work.sketches);
+		return EXIT_FAILURE;
+	}
+	for (int i = 0; (i < no_threads) && !error; i++) {
+		if (heavy_hitters_init(&work.sketches[i], budget) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			error = 1;
+		}
+	}
+	chunk_queue_init(work.chunks, source->start, source->end, 0, no_threads);
+	stats_set_workers(no_threads);
+	progress_begin(no_threads, source_length(source));
+
+	// map
+	if (!error) {
+		stats_phase_begin("map");
+		error = (run_mappers(source, no_threads, thread_sketch, &work)
+				!= EXIT_SUCCESS);
+		stats_phase_end();
+	}
+
+	// merge the sketches into the first one
+	progress_phase("merge");
+	stats_phase_begin("merge");
+	for (int i = 1; (i < no_threads) && !error; i++) {
+		if (heavy_hitters_merge(&work.sketches[0], &work.sketches[i])
+				!= EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			error = 1;
+		}
+	}
+	stats_phase_end();
+
+	for (int i = 1; i < no_threads; i++) {
+		heavy_hitters_free(&work.sketches[i]);
+	}
+	free(work.chunks);
+
+	// the merged sketch is released along with the words
+	merged = (heavy_hitters *) realloc(work.sketches, sizeof(heavy_hitters));
+	result->sketch = merged ? merged : work.sketches;
+	if (error) {
+		return EXIT_FAILURE;
+	}
+
+	result->words = (word_count *) malloc(
+			sizeof(word_count) * (result->sketch->capacity + 1));
+	if (!result->words) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+	result->different_words = heavy_hitters_words(result->sketch,
+			result->words);
+	record_merged_words(result->sketch->size);
+
+	heavy_hitters_bounds_of(result->sketch, top_k, &bounds);
+	fprintf(stdout,
+			"Approximate counts of %llu tokens: the counts of the %zu top words are at most %llu too high, and each count is at most %llu too high with probability %.2f; words which are not counted occur at most %llu times; %zu of the %zu top words are certain\n",
+			(unsigned long long) bounds.tokens,
+			std::min(top_k, result->different_words),
+			(unsigned long long) bounds.max_error,
+			(unsigned long long) bounds.count_min_error,
+			bounds.count_min_confidence,
+			(unsigned long long) bounds.missing_bound, bounds.certain,
+			std::min(top_k, result->different_words));
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Vocabulary engine.
+ * Starts no_threads threads which count the chunks or tasks of the source
+ * (or the chunks of stream) into dense counts of the words of vocab, and
+ * into word tables for the words outside of it.
+ * The counts of the threads are merged by adding the arrays, each thread
+ * a part of the identifiers, and the words outside of the vocabulary are
+ * merged into the table of the first thread.
+ * The words which occurred are stored in result.
+ */
+static int count_with_vocabulary(const count_input *source, int no_threads,
+		const vocabulary *vocab, count_result *result) {
+	thread_work work;
+	vocabulary_counts *merged;
+	int error = 0;
+
+	work.source = source;
+	work.no_threads = no_threads;
+	work.next_task = 0;
+	work.top_k = 0;
+	work.mapper_buffers = NULL;
+	work.reducer_tables = NULL;
+	work.sketches = NULL;
+	work.chunks = (chunk_queue *) aligned_alloc(sizeof(work_deque),
+			chunk_queue_size(no_threads));
+	work.counters = (vocabulary_counts *) calloc(no_threads,
+			sizeof(vocabulary_counts));
+
+	if (!work.chunks || !work.counters) {
+		fprintf(stderr, "Not enough memory!\n");
+		free(work.chunks);
+		free(work.counters);
+		return EXIT_FAILURE;
+	}
+	for (int i = 0; (i < no_threads) && !error; i++) {
+		if (vocabulary_counts_init(&work.counters[i], vocab) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			error = 1;
+		}
+	}
+	chunk_queue_init(work.chunks, source->start, source->end, 0, no_threads);
+	stats_set_workers(no_threads);
+	progress_begin(no_threads, source_length(source));
+
+	// map
+	if (!error) {
+		stats_phase_begin("map");
+		error = (run_mappers(source, no_threads, thread_vocabulary, &work)
+				!= EXIT_SUCCESS);
+		stats_phase_end();
+	}
+
+	// merge the counts into those of the first thread
+	progress_phase("merge");
+	stats_phase_begin("merge");
+	if (!error && (no_threads > 1)) {
+		error = (run_threads(no_threads, thread_add_counts, &work)
+				!= EXIT_SUCCESS);
+	}
+	for (int i = 1; (i < no_threads) && !error; i++) {
+		if (word_table_merge(&work.counters[0].overflow,
+				&work.counters[i].overflow) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			error = 1;
+		}
+	}
+	stats_phase_end();
+
+	for (int i = 1; i < no_threads; i++) {
+		vocabulary_counts_free(&work.counters[i]);
+	}
+	free(work.chunks);
+
+	// the merged counts are released along with the words
+	merged = (vocabulary_counts *) realloc(work.counters,
+			sizeof(vocabulary_counts));
+	result->counts = merged ? merged : work.counters;
+	if (error) {
+		return EXIT_FAILURE;
+	}
+
+	result->words = (word_count *) malloc(sizeof(word_count)
+			* (vocabulary_counts_size(result->counts) + 1));
+	if (!result->words) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+	result->different_words = vocabulary_counts_words(result->counts,
+			result->words);
+	record_merged_words(result->different_words);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the name of the given engine.
+ */
+static const char *engine_name(int engine) {
+	switch (engine) {
+	case ENGINE_THREADS:
+		return "threads";
+	case ENGINE_APPROXIMATE:
+		return "approximate";
+	case ENGINE_VOCABULARY:
+		return "vocabulary";
+	default:
+		return "processes";
+	}
+}
+
+/**
+ * Counts the words of source with the given engine and no_childs workers.
+ * The approximate engine counts in sketches of budget bytes per worker,
+ * and the vocabulary engine counts the words of vocab in dense arrays.
+ */
+static int count_with_engine(const count_input *source, int engine,
+		int no_childs, size_t top_k, size_t budget, const vocabulary *vocab,
+		count_result *result) {
+	switch (engine) {
+	case ENGINE_THREADS:
+		return count_with_threads(source, no_childs, top_k, result);
+	case ENGINE_APPROXIMATE:
+		return count_approximate(source, no_childs, top_k, budget, result);
+	case ENGINE_VOCABULARY:
+		return count_with_vocabulary(source, no_childs, vocab, result);
+	default:
+		return count_with_processes(source, no_childs, top_k, result);
+	}
+}
+
+/**
+ * Counts the words of the input after the given checkpoint file with the
+ * given engine and adds them to the counts of the checkpoint.
+ * Only the bytes appended since the checkpoint are parsed.
+ * The checkpoint file is updated to cover the input up to its trailing
+ * word, which bytes appended later may continue.
+ * The trailing word is counted in result, though.
+ */
+static int count_with_checkpoint(const input_data *input,
+		const char *checkpointfname, int engine, int no_childs,
+		const vocabulary *vocab, count_result *result) {
+	checkpoint cp;
+	count_input source = { input, 0, 0, NULL, NULL };
+	count_result delta = { NULL, 0, 0, NULL, NULL, NULL, NULL };
+	size_t tail_offset = checkpoint_tail_offset(input);
+	int error = 0;
+
+	if (checkpoint_load(checkpointfname, input, &cp) != EXIT_SUCCESS) {
+		checkpoint_free(&cp);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stdout, "Checkpoint: %zu bytes counted, %zu bytes new\n",
+			cp.offset, input->length - cp.offset);
+
+	// count the complete words after the checkpoint
+	if (tail_offset > cp.offset) {
+		no_childs = std::min((size_t) no_childs, tail_offset - cp.offset);
+		source.start = cp.offset;
+		source.end = tail_offset;
+
+		error = count_with_engine(&source, engine, no_childs, 0, 0, vocab,
+				&delta);
+	}
+
+	for (size_t i = 0; (i < delta.different_words) && !error; i++) {
+		if (word_table_add(&cp.table, delta.words[i].word,
+				strlen(delta.words[i].word), delta.words[i].count)
+				!= EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			error = 1;
+		}
+	}
+	count_result_free(&delta);
+
+	if (!error) {
+		cp.offset = tail_offset;
+		error = checkpoint_save(checkpointfname, input, &cp);
+	}
+
+	// the trailing words are complete as far as this run is concerned
+	if (!error && (count_range(tokenizer_default(), input, tail_offset,
+			input->length, &cp.table, NULL) != EXIT_SUCCESS)) {
+		error = 1;
+	}
+
+	// the result owns the table of the checkpoint from now on
+	if (!error) {
+		result->tables = (word_table *) malloc(sizeof(word_table));
+		result->words = (word_count *) malloc(
+				sizeof(word_count) * (cp.table.size + 1));
+		if (!result->tables || !result->words) {
+			fprintf(stderr, "Not enough memory!\n");
+			free(result->tables);
+			free(result->words);
+			result->tables = NULL;
+			result->words = NULL;
+			error = 1;
+		}
+	}
+
+	if (error) {
+		checkpoint_free(&cp);
+		return EXIT_FAILURE;
+	}
+
+	result->tables[0] = cp.table;
+	result->number_reducers = 1;
+	collect_table(result, &result->tables[0]);
+
+	// the reducers hold the words after the checkpoint only
+	stats_set_distinct_words(result->different_words);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Parent process aggregates results, after child processes had finished.
+ * The given array holds the distinct words along with their frequency.
+ * If top_k is not zero, the parent process selects the top_k most frequent
+ * words first, so that only those are sorted and written.
+ * The parent process sorts the array in descending frequency order, and
+ * words of equal frequency in lexicographical order, with no_threads
+ * threads.
+ * Finally, the parent process writes the results into a file, formatting
+ * disjoint parts of the array in parallel.
+ */
+static int aggregate_results(const char *outputfname, word_count *words,
+		size_t different_words, size_t top_k, int no_threads) {
+	int error;
+
+	progress_phase("rank");
+	stats_phase_begin("rank");
+	if (top_k) {
+		different_words = top_k_words(words, different_words, top_k);
+	}
+
+	// sort words according to count in descending order
+	error = (rank_words(words, different_words, no_threads) != EXIT_SUCCESS);
+	stats_phase_end();
+	if (error) {
+		fprintf(stderr, "Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	// write output file
+	progress_phase("write");
+	stats_phase_begin("write");
+	error = output_write(outputfname, words, different_words, no_threads);
+	stats_phase_end();
+
+	return error;
+}
+
+/**
+ * Parses the unsigned decimal number at the beginning of value into number
+ * and stores the end of its digits in end.
+ * strtoull takes "-1" as a huge number, so value must begin with a digit.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is no number or it is
+ * too large.
+ */
+static int parse_unsigned(const char *value, char **end,
+		unsigned long long *number) {
+	if (!isdigit((unsigned char) *value)) {
+		return EXIT_FAILURE;
+	}
+
+	errno = 0;
+	*number = strtoull(value, end, 10);
+
+	return (errno == ERANGE) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Returns the number of bytes given by the string size, which may end
+ * with one of the suffixes k, M, or G, or zero if size is invalid.
+ */
+static size_t parse_size(const char *size) {
+	char *end = NULL;
+	unsigned long long bytes;
+	int shift = 0;
+
+	if (parse_unsigned(size, &end, &bytes) != EXIT_SUCCESS) {
+		return 0;
+	}
+
+	switch (*end) {
+	case 'k':
+	case 'K':
+		shift = 10;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		shift = 20;
+		end++;
+		break;
+	case 'g':
+	case 'G':
+		shift = 30;
+		end++;
+		break;
+	}
+
+	if ((*end != 0) || (bytes > (SIZE_MAX >> shift))) {
+		return 0;
+	}
+
+	return (size_t) bytes << shift;
+}
+
+/**
+ * Parses the byte range "start:end" of the input into start and end.
+ * If end is omitted, the range extends to the end of the input.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the range is invalid.
+ */
+static int parse_range(const char *range, size_t *start, size_t *end) {
+	char *colon = NULL;
+	char *rest = NULL;
+	unsigned long long number;
+
+	if ((parse_unsigned(range, &colon, &number) != EXIT_SUCCESS)
+			|| (*colon != ':')) {
+		return EXIT_FAILURE;
+	}
+	*start = number;
+
+	if (colon[1] == 0) {
+		*end = SIZE_MAX;
+		return EXIT_SUCCESS;
+	}
+
+	if ((parse_unsigned(colon + 1, &rest, &number) != EXIT_SUCCESS)
+			|| (*rest != 0) || (number < *start)) {
+		return EXIT_FAILURE;
+	}
+	*end = number;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the number given by the string value, or exits with an error
+ * which names the option if it is not at least one.
+ */
+static long parse_positive(const char *value, const char *name) {
+	long number = atol(value);
+
+	if (number < 1) {
+		fprintf(stderr, "%s must be at least one!\n", name);
+		exit(EXIT_FAILURE);
+	}
+
+	return number;
+}
+
+/**
+ * Builds the vocabulary of the words in the given file, one per line,
+ * which may be compressed.
+ * The words are stored in lower case if fold is not zero.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or the
+ * vocabulary cannot be built.
+ */
+static int load_vocabulary(const char *vocabularyfname, int fold,
+		vocabulary *vocab) {
+	input_data text;
+	int error;
+
+	if (input_open(vocabularyfname, &text) != EXIT_SUCCESS) {
+		fprintf(stderr, "Could not read the vocabulary file!\n");
+		return EXIT_FAILURE;
+	}
+	error = vocabulary_build(vocab, text.data, text.length, fold);
+	input_close(&text);
+
+	return error;
+}
+
+/**
+ * Returns true, iff the given path is a directory.
+ */
+static bool is_directory(const char *path) {
+	struct stat st;
+
+	return (stat(path, &st) == 0) && S_ISDIR(st.st_mode);
+}
+
+/**
+ * Counts the words of the given input files and directories and of those
+ * listed in the file filelistfname, if it is not NULL, together with the
+ * given engine, and writes the combined counts to the output file.
+ * Large files are split into chunks of chunk_size bytes, which the workers
+ * take from a shared queue along with the small files, so that a fixed pool
+ * of workers counts any number of files.
+ */
+static int count_files(const char **inputfnames, int number_inputs,
+		const char *filelistfname, const char *outputfname, int engine,
+		int no_childs, size_t chunk_size, size_t top_k, size_t budget,
+		const vocabulary *vocab) {
+	corpus files;
+	count_input source = { NULL, 0, 0, &files, NULL };
+	count_result result = { NULL, 0, 0, NULL, NULL, NULL, NULL };
+	int error = 0;
+
+	corpus_init(&files);
+	// the workers decompress whole files, so each decodes its own file
+	decompress_set_threads(1);
+
+	for (int i = 0; (i < number_inputs) && !error; i++) {
+		error = (corpus_add_path(&files, inputfnames[i]) != EXIT_SUCCESS);
+	}
+	if (!error && filelistfname) {
+		error = (corpus_add_list(&files, filelistfname) != EXIT_SUCCESS);
+	}
+	if (!error && (corpus_plan(&files, chunk_size) != EXIT_SUCCESS)) {
+		fprintf(stderr, "Not enough memory!\n");
+		error = 1;
+	}
+
+	if (!error && (files.number_tasks == 0)) {
+		fprintf(stdout, "Input files are empty. We are done.\n");
+	} else if (!error) {
+		no_childs = std::min((size_t) no_childs, files.number_tasks);
+
+		fprintf(stdout,
+				"Starting word frequency count using the following options:\n\nParallelism: %d\nEngine: %s\nInput files: %zu (%zu bytes in %zu tasks)\nOutput file: %s\n",
+				no_childs, engine_name(engine), files.number_files,
+				files.length, files.number_tasks, outputfname);
+
+		error = count_with_engine(&source, engine, no_childs, top_k, budget,
+				vocab, &result);
+
+		if (!error) {
+			error = aggregate_results(outputfname, result.words,
+					result.different_words, top_k, no_childs);
+		}
+		count_result_free(&result);
+	}
+
+	corpus_free(&files);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Merge subcommand.
+ * Merges the partial-count files of several runs with --range, which may
+ * run on different hosts, and writes the merged counts to an output file
+ * exactly like a single run over the whole input.
+ */
+static int merge_main(int argc, char *argv[]) {
+	int no_threads = topology_cpus();
+	const char *outputfname = DEFAULT_OUTPUT_FILE;
+	size_t top_k = 0;
+	partial_result merged;
+	int error = 0;
+	int opt = -1;
+
+	while ((opt = getopt(argc, argv, "p:o:k:")) != -1) {
+		switch (opt) {
+		case 'p':
+			no_threads = parse_positive(optarg, "parallelism");
+			break;
+
+		case 'o':
+			outputfname = optarg;
+			break;
+
+		case 'k':
+			top_k = parse_positive(optarg, "number of top words");
+			break;
+
+		default: /* '?' */
+			optind = argc;
+			break;
+		}
+	}
+
+	if (optind >= argc) {
+		fprintf(stderr,
+				"Usage: wfc merge [-p <parallelism>] [-o <output file>] [-k <top words>] <partial-count file>...\n");
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(stdout,
+			"Merging %d partial-count files using the following options:\n\nParallelism: %d\nOutput file: %s\n",
+			argc - optind, no_threads, outputfname);
+
+	error = partial_merge(argv + optind, argc - optind, &merged);
+	if (!error) {
+		error = aggregate_results(outputfname, merged.words,
+				merged.different_words, top_k, no_threads);
+	}
+	partial_result_free(&merged);
+
+	return error;
+}
+
+/**
+ * Main program. Let child processes (or threads) parse the input file.
+ * Parent process aggregates results and writes them to an output file.
+ * With --range, only the given byte range of the input file is counted and
+ * the counts are written to a partial-count file, which the merge
+ * subcommand combines with those of the other ranges.
+ */
+int main(int argc, char *argv[]) {
+	int no_childs = -1;
+	const char * inputfname = NULL;
+	const char **inputfnames = (const char **) calloc(argc, sizeof(char *));
+	int number_inputs = 0;
+	const char *filelistfname = NULL;
+	const char * outputfname = NULL;
+	input_data input;
+	size_t inputfs = 0;
+	count_result result = { NULL, 0, 0, NULL, NULL, NULL, NULL };
+	int engine = ENGINE_PROCESSES;
+	int engine_chosen = 0;
+	int approximate = 0;
+	int streaming = 0;
+	int pin = 0;
+	size_t chunk_size = DEFAULT_CHUNK_SIZE;
+	size_t top_k = 0;
+	size_t budget = 0;
+	const char *vocabularyfname = NULL;
+	vocabulary vocab;
+	const char *range = NULL;
+	const char *checkpointfname = NULL;
+	const char *statsfname = NULL;
+	double progress_interval = 0;
+	int utf8 = 0;
+	int normalization = 0;
+	const char *servefname = NULL;
+	size_t range_start = 0;
+	size_t range_end = 0;
+	int error = 0;
+	int opt = -1;
+	static const struct option long_options[] = {
+			{ "processes", no_argument, NULL, OPTION_PROCESSES },
+			{ "threads", no_argument, NULL, OPTION_THREADS },
+			{ "stream", no_argument, NULL, OPTION_STREAM },
+			{ "chunk-size", required_argument, NULL, OPTION_CHUNK_SIZE },
+			{ "range", required_argument, NULL, OPTION_RANGE },
+			{ "checkpoint", required_argument, NULL, OPTION_CHECKPOINT },
+			{ "file-list", required_argument, NULL, OPTION_FILE_LIST },
+			{ "pin", no_argument, NULL, OPTION_PIN },
+			{ "stats", required_argument, NULL, OPTION_STATS },
+			{ "progress", required_argument, NULL, OPTION_PROGRESS },
+			{ "utf8", no_argument, NULL, OPTION_UTF8 },
+			{ "fold-case", no_argument, NULL, OPTION_FOLD_CASE },
+			{ "trim", no_argument, NULL, OPTION_TRIM },
+			{ "serve", required_argument, NULL, OPTION_SERVE },
+			{ "approximate", required_argument, NULL, OPTION_APPROXIMATE },
+			{ "vocab", required_argument, NULL, OPTION_VOCABULARY },
+			{ NULL, 0, NULL, 0 } };
+
+	if ((argc > 1) && (strcmp(argv[1], "merge") == 0)) {
+		return merge_main(argc - 1, argv + 1);
+	}
+
+	// set arguments to default values
+	no_childs = topology_cpus();
+	inputfname = DEFAULT_INPUT_FILE;
+	outputfname = DEFAULT_OUTPUT_FILE;
+
+	// argument parsing
+	while ((opt = getopt_long(argc, argv, "p:i:o:k:", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'p':
+			no_childs = parse_positive(optarg, "parallelism");
+			break;
+
+		case 'i':
+			inputfname = optarg;
+			inputfnames[number_inputs++] = optarg;
+			break;
+
+		case 'o':
+			outputfname = optarg;
+			break;
+
+		case 'k':
+			top_k = parse_positive(optarg, "number of top words");
+			break;
+
+		case OPTION_PROCESSES:
+			engine = ENGINE_PROCESSES;
+			engine_chosen = 1;
+			break;
+
+		case OPTION_THREADS:
+			engine = ENGINE_THREADS;
+			engine_chosen = 1;
+			break;
+
+		case OPTION_STREAM:
+			streaming = 1;
+			break;
+
+		case OPTION_CHUNK_SIZE:
+			chunk_size = parse_size(optarg);
+			if (chunk_size == 0) {
+				fprintf(stderr, "chunk size must be at least one byte!\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case OPTION_RANGE:
+			range = optarg;
+			if (parse_range(range, &range_start, &range_end) != EXIT_SUCCESS) {
+				fprintf(stderr, "range must be <start>:[<end>] with start <= end!\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case OPTION_CHECKPOINT:
+			checkpointfname = optarg;
+			break;
+
+		case OPTION_FILE_LIST:
+			filelistfname = optarg;
+			break;
+
+		case OPTION_PIN:
+			pin = 1;
+			break;
+
+		case OPTION_STATS:
+			statsfname = optarg;
+			break;
+
+		case OPTION_PROGRESS:
+			progress_interval = atof(optarg);
+			if (progress_interval <= 0) {
+				fprintf(stderr, "progress interval must be positive!\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case OPTION_UTF8:
+			utf8 = 1;
+			break;
+
+		case OPTION_FOLD_CASE:
+			normalization |= TOKENIZER_FOLD_CASE;
+			break;
+
+		case OPTION_TRIM:
+			normalization |= TOKENIZER_TRIM;
+			break;
+
+		case OPTION_SERVE:
+			servefname = optarg;
+			break;
+
+		case OPTION_APPROXIMATE:
+			approximate = 1;
+			budget = parse_size(optarg);
+			if (budget == 0) {
+				fprintf(stderr, "memory budget must be at least one byte!\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case OPTION_VOCABULARY:
+			vocabularyfname = optarg;
+			break;
+
+		default: /* '?' */
+			fprintf(stderr,
+					"Usage: %s [-p <parallelism>] [-i <input file or directory>... | -i -] [--file-list <file>] [-o <output file>] [-k <top words>] [--processes | --threads] [--pin] [--stats <file>] [--progress <seconds>] [--utf8] [--fold-case] [--trim] [--serve <socket>] [--approximate <bytes per worker> | --vocab <vocabulary file>] [--stream [--chunk-size <bytes>]] [--range <start>:[<end>] | --checkpoint <checkpoint file>]\n"
+					"       %s merge [-p <parallelism>] [-o <output file>] [-k <top words>] <partial-count file>...\n",
+					argv[0], argv[0]);
+			exit(EXIT_FAILURE);
+			break;
+		}
+	}
+
+	if (!inputfnames) {
+		fprintf(stderr, "Not enough memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	tokenizer_set_utf8(utf8);
+	tokenizer_set_normalization(normalization);
+	tokenizer_select(TOKENIZER_AUTO);
+	// compressed inputs are decoded by as many threads as there are workers
+	decompress_set_threads(no_childs);
+
+	// pinning is a hint, so the workers float if it is not possible
+	if (pin && (topology_pin_init() != EXIT_SUCCESS)) {
+		fprintf(stderr, "Could not pin the workers to CPUs!\n");
+	}
+
+	// the server counts the inputs of its clients instead
+	if (servefname) {
+		if (engine_chosen || approximate || vocabularyfname || statsfname
+				|| progress_interval || range || checkpointfname || streaming
+				|| number_inputs || filelistfname) {
+			fprintf(stderr,
+					"The server cannot be combined with -i, --file-list, --stream, --processes, --threads, --approximate, --vocab, --stats, --progress, --range, or --checkpoint!\n");
+			exit(EXIT_FAILURE);
+		}
+		return serve(servefname, no_childs);
+	}
+
+	if (statsfname && (stats_enable(no_childs) != EXIT_SUCCESS)) {
+		exit(EXIT_FAILURE);
+	}
+
+	/*
+	 * Report the progress on SIGUSR1 and, with --progress, periodically.
+	 * The reporter is started before any other thread or child, which
+	 * must not take SIGUSR1.
+	 */
+	if (progress_start(no_childs, progress_interval) != EXIT_SUCCESS) {
+		exit(EXIT_FAILURE);
+	}
+
+	// the standard input can only be streamed
+	if (strcmp(inputfname, "-") == 0) {
+		streaming = 1;
+	}
+
+	if (approximate) {
+		if (engine_chosen) {
+			fprintf(stderr,
+					"The approximate engine cannot be combined with --processes or --threads!\n");
+			exit(EXIT_FAILURE);
+		}
+		engine = ENGINE_APPROXIMATE;
+		if (!top_k) {
+			fprintf(stderr, "The approximate engine needs the number of top words!\n");
+			exit(EXIT_FAILURE);
+		}
+		if (heavy_hitters_capacity(budget) < top_k) {
+			fprintf(stderr,
+					"The memory budget holds only %zu words, which is less than the number of top words!\n",
+					heavy_hitters_capacity(budget));
+			exit(EXIT_FAILURE);
+		}
+		if (range || checkpointfname) {
+			fprintf(stderr,
+					"Approximate counts can neither be merged nor checkpointed!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/*
+	 * Build the perfect hash of the vocabulary once, before any worker
+	 * starts, so that the workers share it read-only.
+	 * The words of the vocabulary are normalized like the words counted.
+	 */
+	if (vocabularyfname) {
+		if (engine == ENGINE_APPROXIMATE) {
+			fprintf(stderr,
+					"Approximate counts cannot be counted with a vocabulary!\n");
+			exit(EXIT_FAILURE);
+		}
+		if (engine_chosen) {
+			fprintf(stderr,
+					"The vocabulary engine cannot be combined with --processes or --threads!\n");
+			exit(EXIT_FAILURE);
+		}
+		engine = ENGINE_VOCABULARY;
+		if (load_vocabulary(vocabularyfname,
+				normalization & TOKENIZER_FOLD_CASE, &vocab) != EXIT_SUCCESS) {
+			exit(EXIT_FAILURE);
+		}
+		fprintf(stdout, "Vocabulary: %zu words\n", vocab.size);
+	}
+
+	if ((number_inputs > 1) || filelistfname || is_directory(inputfname)) {
+		if (streaming || range || checkpointfname) {
+			fprintf(stderr,
+					"Streaming, ranges, and checkpoints need a single input file!\n");
+			exit(EXIT_FAILURE);
+		}
+
+		error = count_files(inputfnames, number_inputs, filelistfname,
+				outputfname, engine, no_childs, chunk_size, top_k, budget,
+				&vocab);
+		free(inputfnames);
+		if (vocabularyfname) {
+			vocabulary_free(&vocab);
+		}
+		progress_stop();
+		if (statsfname) {
+			error = stats_write(statsfname) || error;
+		}
+
+		return error;
+	}
+	free(inputfnames);
+
+	if (range && streaming) {
+		fprintf(stderr, "A range can only be counted in a mapped input file!\n");
+		exit(EXIT_FAILURE);
+	}
+	if (checkpointfname && (streaming || range)) {
+		fprintf(stderr,
+				"A checkpoint can only cover a whole mapped input file!\n");
+		exit(EXIT_FAILURE);
+	}
+	if (range && top_k) {
+		fprintf(stderr, "The top words of a range are not exact when merged!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (streaming) {
+		/*
+		 * Stream the input file in chunks to worker threads.
+		 * The memory is bounded by the chunks in flight, so the input may
+		 * be larger than the memory or a pipe.
+		 */
+		FILE *inputfd = stdin;
+		FILE *decodedfd;
+		chunk_stream stream;
+
+		if (strcmp(inputfname, "-") != 0) {
+			inputfd = fopen(inputfname, "r");
+			if (!inputfd) {
+				fprintf(stderr, "Could not open input file!\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		// a compressed input is decoded by the reader as it is read
+		decodedfd = decompress_open(inputfd);
+		if (!decodedfd) {
+			fprintf(stderr, "Could not decompress input file!\n");
+			exit(EXIT_FAILURE);
+		}
+
+		// the processes stream with threads instead
+		if (engine == ENGINE_PROCESSES) {
+			engine = ENGINE_THREADS;
+		}
+
+		fprintf(stdout,
+				"Starting word frequency count using the following options:\n\nParallelism: %d\nEngine: %s (streaming, %zu byte chunks)\nInput file: %s\nOutput file: %s\n",
+				no_childs, engine_name(engine), chunk_size, inputfname,
+				outputfname);
+
+		if (chunk_stream_init(&stream, decodedfd, chunk_size,
+				CHUNKS_PER_THREAD * no_childs) != EXIT_SUCCESS) {
+			fprintf(stderr, "Not enough memory!\n");
+			exit(EXIT_FAILURE);
+		}
+
+		count_input source = { NULL, 0, 0, NULL, &stream };
+
+		error = count_with_engine(&source, engine, no_childs, top_k, budget,
+				&vocab, &result);
+
+		chunk_stream_free(&stream);
+		fclose(decodedfd);
+		if (inputfd != stdin) {
+			fclose(inputfd);
+		}
+
+		if (!error) {
+			error = aggregate_results(outputfname, result.words,
+					result.different_words, top_k, no_childs);
+		}
+		count_result_free(&result);
+		if (vocabularyfname) {
+			vocabulary_free(&vocab);
+		}
+		progress_stop();
+		if (statsfname) {
+			error = stats_write(statsfname) || error;
+		}
+
+		return error;
+	}
+
+	/*
+	 * Map the input file.
+	 * The children inherit the mapping, so they parse the input without
+	 * reading or copying it.
+	 */
+	if (input_open(inputfname, &input) != EXIT_SUCCESS) {
+		exit(EXIT_FAILURE);
+	}
+	inputfs = input.length;
+
+	if (range) {
+		range_start = std::min(range_start, inputfs);
+		range_end = std::min(range_end, inputfs);
+	} else {
+		range_end = inputfs;
+	}
+
+	// the partial-count file of an empty range is needed for the merge
+	if ((inputfs == 0) && !range && !checkpointfname) {
+		fprintf(stdout, "Input file is empty. We are done.\n");
+		input_close(&input);
+		exit(EXIT_SUCCESS);
+	} else if (range_end - range_start < (size_t) no_childs) {
+		no_childs = std::max(range_end - range_start, (size_t) 1);
+	}
+
+	fprintf(stdout,
+			"Starting word frequency count using the following options:\n\nParallelism: %d\nEngine: %s\nInput file: %s\nOutput file: %s\n",
+			no_childs, engine_name(engine), inputfname, outputfname);
+	if (range) {
+		fprintf(stdout, "Range: %zu:%zu (partial-count file)\n", range_start,
+				range_end);
+	}
+
+	count_input source = { &input, range_start, range_end, NULL, NULL };
+
+	if (checkpointfname) {
+		error = count_with_checkpoint(&input, checkpointfname, engine,
+				no_childs, &vocab, &result);
+	} else {
+		error = count_with_engine(&source, engine, no_childs, top_k, budget,
+				&vocab, &result);
+	}
+
+	/*
+	 * Aggregate results.
+	 */
+	if (!error && range) {
+		progress_phase("write");
+		stats_phase_begin("write");
+		error = partial_write(outputfname, result.words,
+				result.different_words);
+		stats_phase_end();
+	} else if (!error) {
+		error = aggregate_results(outputfname, result.words,
+				result.different_words, top_k, no_childs);
+	}
+
+	// free memory
+	count_result_free(&result);
+	if (vocabularyfname) {
+		vocabulary_free(&vocab);
+	}
+	input_close(&input);
+	progress_stop();
+	if (statsfname) {
+		error = stats_write(statsfname) || error;
+	}
 
 	return error;
 }
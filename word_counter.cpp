@@ -0,0 +1,187 @@
+/*
+ * word_counter.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "counter.h"
+#include "word_counter.h"
+
+/**
+ * Returns nonzero, iff the given byte ends any word in every tokenizer
+ * mode, i.e. it is a skippable ASCII character.
+ */
+static inline int ends_words(char c) {
+	return !(c & 0x80) && isskip(c);
+}
+
+/**
+ * Counts the words of the given complete buffer.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int count_buffer(word_counter *counter, const char *data,
+		size_t length) {
+	input_data input = { data, length, 0 };
+	size_t tokens = 0;
+	int status = count_range(&counter->tok, &input, 0, length,
+			&counter->table, &tokens);
+
+	counter->tokens += tokens;
+	return status;
+}
+
+/**
+ * Appends the given bytes to the carried word of the counter.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static int carry(word_counter *counter, const char *data, size_t length) {
+	size_t needed = counter->carry_length + length;
+
+	if (needed > counter->carry_capacity) {
+		size_t capacity = std::max(needed, 2 * counter->carry_capacity);
+		char *larger = (char *) realloc(counter->carry, capacity);
+
+		if (!larger) {
+			return EXIT_FAILURE;
+		}
+		counter->carry = larger;
+		counter->carry_capacity = capacity;
+	}
+
+	memcpy(counter->carry + counter->carry_length, data, length);
+	counter->carry_length = needed;
+
+	return EXIT_SUCCESS;
+}
+
+int word_counter_init(word_counter *counter) {
+	return word_counter_init_tokenizer(counter, tokenizer_default());
+}
+
+int word_counter_init_tokenizer(word_counter *counter, const tokenizer *tok) {
+	counter->tok = *tok;
+	counter->carry = NULL;
+	counter->carry_length = 0;
+	counter->carry_capacity = 0;
+	counter->tokens = 0;
+
+	return word_table_init(&counter->table, 0);
+}
+
+void word_counter_free(word_counter *counter) {
+	word_table_free(&counter->table);
+	free(counter->carry);
+	counter->carry = NULL;
+	counter->carry_length = 0;
+	counter->carry_capacity = 0;
+}
+
+int word_counter_feed(word_counter *counter, const char *data, size_t length) {
+	size_t start = 0;
+	size_t cut;
+
+	if (counter->carry_length) {
+		/*
+		 * The carried word continues up to the next byte which ends words,
+		 * so only that prefix of the span is copied.
+		 */
+		while ((start < length) && !ends_words(data[start])) {
+			start++;
+		}
+		if (start == length) {
+			return carry(counter, data, length);
+		}
+
+		start++;
+		if ((carry(counter, data, start) != EXIT_SUCCESS)
+				|| (count_buffer(counter, counter->carry,
+						counter->carry_length) != EXIT_SUCCESS)) {
+			return EXIT_FAILURE;
+		}
+		counter->carry_length = 0;
+	}
+
+	// the rest of the span is counted in place, except for its last word
+	cut = start + tokenizer_prev_boundary(&counter->tok, data + start,
+			length - start);
+	if (count_buffer(counter, data + start, cut - start) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	return carry(counter, data + cut, length - cut);
+}
+
+int word_counter_finish(word_counter *counter) {
+	int status = count_buffer(counter, counter->carry, counter->carry_length);
+
+	counter->carry_length = 0;
+	return status;
+}
+
+int word_counter_merge(word_counter *destination, const word_counter *source) {
+	destination->tokens += source->tokens;
+
+	return word_table_merge(&destination->table, &source->table);
+}
+
+uint64_t word_counter_count(const word_counter *counter, const char *word,
+		size_t length) {
+	int normalization = counter->tok.normalization;
+	const word_table_slot *slot;
+
+	if (normalization & TOKENIZER_TRIM) {
+		trim_word(&word, &length);
+	}
+	if (!length) {
+		return 0;
+	}
+
+	slot = (normalization & TOKENIZER_FOLD_CASE) ?
+			word_table_find_folded(&counter->table, word, length) :
+			word_table_find(&counter->table, word, length);
+
+	return slot ? slot->count : 0;
+}
+
+size_t word_counter_top(const word_counter *counter, size_t k,
+		word_count *top) {
+	size_t number_words = top_k_table(&counter->table, k, top);
+
+	std::sort(top, top + number_words, ranks_before);
+	return number_words;
+}
+
+size_t word_counter_serialized_length(const word_counter *counter) {
+	return word_table_serialized_length(&counter->table, 1);
+}
+
+void word_counter_serialize(const word_counter *counter, char *buffer) {
+	word_table_serialize(&counter->table, buffer, 1);
+}
+
+int word_counter_merge_serialized(word_counter *counter, const char *buffer,
+		size_t length) {
+	const word_partition *partition;
+	const word_record *record;
+
+	// the buffer may come from anywhere, so its records are checked first
+	if (word_table_check_serialized(buffer, length, 1) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	partition = word_serialized_partition(buffer, 0);
+	record = (const word_record *) (buffer + partition->offset);
+	for (uint64_t i = 0; i < partition->number_words; i++) {
+		if (word_table_add_hashed(&counter->table, word_record_word(record),
+				record->length, record->hash, record->count) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+		counter->tokens += record->count;
+		record = word_record_next(record);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/*
+ * word_counter.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef WORD_COUNTER_H_
+#define WORD_COUNTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ranking.h"
+#include "tokenizer.h"
+#include "word_table.h"
+
+/**
+ * Counter of the words of a stream of bytes, which is fed in spans of any
+ * size, for programs that link libwfc instead of running wfc.
+ * A word which spans the end of a span is carried over to the next span,
+ * so the counts do not depend on how the stream is split.
+ * The counter neither reads files nor starts threads or processes.
+ * Counters are not thread-safe, so each thread counts in a counter of its
+ * own, and the counters are merged afterwards.
+ * Each counter keeps its own tokenizer, so counters with different
+ * tokenizer modes and normalizations may be used side by side.
+ */
+typedef struct word_counter_t {
+	tokenizer tok;
+	word_table table;
+	char *carry;
+	size_t carry_length;
+	size_t carry_capacity;
+	uint64_t tokens;
+} word_counter;
+
+/**
+ * Initializes an empty counter, which counts with a copy of the tokenizer
+ * of the process as it is now.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_counter_init(word_counter *counter);
+
+/**
+ * Initializes an empty counter, which counts with a copy of the given
+ * tokenizer (see tokenizer_init).
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_counter_init_tokenizer(word_counter *counter, const tokenizer *tok);
+
+/**
+ * Frees the words and counts of the given counter.
+ */
+void word_counter_free(word_counter *counter);
+
+/**
+ * Counts the words of the next span of the stream.
+ * The trailing word of the span is counted by a later call of
+ * word_counter_feed or word_counter_finish, as the next span may continue
+ * it.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_counter_feed(word_counter *counter, const char *data, size_t length);
+
+/**
+ * Ends the stream and counts its trailing word.
+ * Spans fed afterwards begin a new stream.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_counter_finish(word_counter *counter);
+
+/**
+ * Adds the counts of the counter source to the counter destination.
+ * The stream of source must be finished, and both counters should count
+ * with the same normalizations.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_counter_merge(word_counter *destination, const word_counter *source);
+
+/**
+ * Returns the count of the given word, which is normalized by the
+ * tokenizer of the counter like the words of the stream first.
+ */
+uint64_t word_counter_count(const word_counter *counter, const char *word,
+		size_t length);
+
+/**
+ * Returns the number of distinct words of the given counter.
+ */
+static inline size_t word_counter_size(const word_counter *counter) {
+	return counter->table.size;
+}
+
+/**
+ * Stores the k most frequent words of the given counter in top, which
+ * must hold k words, sorted by rank (see ranks_before).
+ * The words stay valid until the counter is freed.
+ * Returns the number of words stored, which is less than k if the counter
+ * holds less words.
+ */
+size_t word_counter_top(const word_counter *counter, size_t k,
+		word_count *top);
+
+/**
+ * Returns the number of bytes word_counter_serialize writes for the given
+ * counter.
+ */
+size_t word_counter_serialized_length(const word_counter *counter);
+
+/**
+ * Writes the words and counts of the given counter into buffer, which
+ * must hold word_counter_serialized_length bytes.
+ * The serialized form is the one of a word table with a single partition,
+ * which other processes or hosts can merge.
+ */
+void word_counter_serialize(const word_counter *counter, char *buffer);
+
+/**
+ * Adds the words and counts of the given serialized counter of length
+ * bytes to the given counter.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the buffer is not a serialized
+ * counter or there is not enough memory.
+ */
+int word_counter_merge_serialized(word_counter *counter, const char *buffer,
+		size_t length);
+
+#endif /* WORD_COUNTER_H_ */
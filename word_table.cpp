@@ -0,0 +1,614 @@
+/*
+ * word_table.cpp
+ *
+ *      Author: Fabian Foerg
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "utf8.h"
+#include "word_table.h"
+
+#define MIN_CAPACITY 16
+#define ARENA_BLOCK_SIZE (256 * 1024)
+
+/**
+ * Reads eight bytes from an arbitrarily aligned address.
+ */
+static inline uint64_t load64(const char *p) {
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/**
+ * Turns the ASCII upper case letters among the eight bytes of v into lower
+ * case letters, all at once.
+ * Adding 0x3f (0x25) to the low seven bits of a byte sets its high bit,
+ * iff the byte is at least 'A' (greater than 'Z'), so the difference of
+ * both sums flags the letters; bytes of at least 0x80 are left alone.
+ */
+static inline uint64_t fold64(uint64_t v) {
+	uint64_t low = v & 0x7f7f7f7f7f7f7f7fULL;
+	uint64_t upper = ((low + 0x3f3f3f3f3f3f3f3fULL)
+			^ (low + 0x2525252525252525ULL)) & ~v & 0x8080808080808080ULL;
+
+	return v | (upper >> 2);
+}
+
+/**
+ * Reads the last length (less than eight) bytes of a word into the low
+ * bytes of a word and folds their case if fold is not zero.
+ */
+static inline uint64_t load_tail(const char *p, size_t length, int fold) {
+	uint64_t tail = 0;
+
+	memcpy(&tail, p, length);
+	return fold ? fold64(tail) : tail;
+}
+
+/**
+ * Writes the given code point with the given number of bytes in UTF-8 to
+ * bytes.
+ */
+static inline void encode_code_point(uint32_t c, size_t length, char *bytes) {
+	switch (length) {
+	case 2:
+		bytes[0] = (char) (0xc0 | (c >> 6));
+		break;
+	case 3:
+		bytes[0] = (char) (0xe0 | (c >> 12));
+		bytes[1] = (char) (0x80 | ((c >> 6) & 0x3f));
+		break;
+	default:
+		bytes[0] = (char) (0xf0 | (c >> 18));
+		bytes[1] = (char) (0x80 | ((c >> 12) & 0x3f));
+		bytes[2] = (char) (0x80 | ((c >> 6) & 0x3f));
+		break;
+	}
+	bytes[length - 1] = (char) (0x80 | (c & 0x3f));
+}
+
+/**
+ * Writes the count bytes at the given index of the given word with their
+ * case folded to folded.
+ * Folding may change every byte of a character, so the characters which
+ * contain these bytes are decoded whole, beginning at the character which
+ * contains the byte at the index.
+ * Bytes which are not valid UTF-8 are copied unchanged.
+ */
+static void fold_bytes(const char *word, size_t length, size_t i,
+		size_t count, char *folded) {
+	size_t start = i;
+	size_t end = i + count;
+
+	// a character spans at most three continuation bytes
+	while ((start > 0) && (i - start < 3) && utf8_is_continuation(word[start])) {
+		start--;
+	}
+	if (utf8_is_continuation(word[start])) {
+		start = i;
+	}
+
+	for (size_t p = start; p < end;) {
+		uint32_t c;
+		size_t n = utf8_decode(word, p, length, &c);
+		char bytes[4];
+
+		if (n == 0) {
+			bytes[0] = word[p];
+			n = 1;
+		} else if (n == 1) {
+			bytes[0] = ((c >= 'A') && (c <= 'Z')) ? c | 0x20 : c;
+		} else {
+			encode_code_point(utf8_fold(c), n, bytes);
+		}
+
+		for (size_t j = 0; j < n; j++) {
+			if ((p + j >= i) && (p + j < end)) {
+				folded[p + j - i] = bytes[j];
+			}
+		}
+		p += n;
+	}
+}
+
+/**
+ * Reads the count (at most eight) bytes at the given index of the given
+ * word into the low bytes of a word with their case folded.
+ * Blocks of ASCII characters are folded all at once, only blocks with
+ * UTF-8 characters beyond ASCII character by character.
+ */
+static inline uint64_t load_folded(const char *word, size_t length, size_t i,
+		size_t count) {
+	uint64_t v = (count == 8) ? load64(word + i) : load_tail(word + i, count, 0);
+	char bytes[8] = { 0 };
+
+	if (!(v & 0x8080808080808080ULL)) {
+		return fold64(v);
+	}
+
+	fold_bytes(word, length, i, count, bytes);
+	memcpy(&v, bytes, sizeof(v));
+
+	return v;
+}
+
+void word_fold(const char *word, size_t length, char *folded) {
+	fold_bytes(word, length, 0, length, folded);
+}
+
+/**
+ * Mixes the bits of the given value (finalizer of MurmurHash3).
+ */
+static inline uint64_t mix64(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * Returns the 64-bit hash of the given word, whose case is folded first if
+ * fold is not zero.
+ */
+static inline uint64_t hash64(const char *word, size_t length, int fold) {
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ length;
+	size_t i = 0;
+
+	// consume eight bytes at a time
+	for (; i + 8 <= length; i += 8) {
+		h = (h ^ (fold ? load_folded(word, length, i, 8) : load64(word + i)))
+				* 0x100000001b3ULL;
+		h = (h << 29) | (h >> 35);
+	}
+
+	// consume the remaining bytes
+	if (i < length) {
+		h = (h ^ (fold ? load_folded(word, length, i, length - i) :
+				load_tail(word + i, length - i, 0))) * 0x100000001b3ULL;
+	}
+
+	return mix64(h);
+}
+
+/**
+ * Returns the hash of the given word, whose case is folded first if fold
+ * is not zero.
+ */
+static inline uint32_t hash(const char *word, size_t length, int fold) {
+	return (uint32_t) hash64(word, length, fold);
+}
+
+uint32_t word_hash(const char *word, size_t length) {
+	return hash(word, length, 0);
+}
+
+uint64_t word_hash64(const char *word, size_t length, int fold) {
+	return hash64(word, length, fold);
+}
+
+/**
+ * Returns nonzero, iff the given stored word equals the given word, whose
+ * case is folded first if fold is not zero.
+ */
+static inline int equal_words(const char *stored, const char *word,
+		size_t length, int fold) {
+	size_t i = 0;
+
+	if (!fold) {
+		return memcmp(stored, word, length) == 0;
+	}
+
+	for (; i + 8 <= length; i += 8) {
+		if (load64(stored + i) != load_folded(word, length, i, 8)) {
+			return 0;
+		}
+	}
+
+	return (i == length) || (load_tail(stored + i, length - i, 0)
+			== load_folded(word, length, i, length - i));
+}
+
+int word_equal(const char *stored, const char *word, size_t length,
+		int fold) {
+	return equal_words(stored, word, length, fold);
+}
+
+/**
+ * Copies the given word into the given arena like word_arena_copy and
+ * folds the case of the copy if fold is not zero.
+ */
+static inline const char *arena_copy(word_arena_block **arena,
+		const char *word, size_t length, int fold) {
+	word_arena_block *block = *arena;
+	char *copy;
+
+	if (!block || (block->size - block->used < length + 1)) {
+		size_t size = ARENA_BLOCK_SIZE;
+
+		if (size < length + 1) {
+			size = length + 1;
+		}
+
+		block = (word_arena_block *) malloc(
+				sizeof(word_arena_block) + size - 1);
+		if (!block) {
+			return NULL;
+		}
+		block->next = *arena;
+		block->used = 0;
+		block->size = size;
+		*arena = block;
+	}
+
+	copy = block->data + block->used;
+	copy[length] = 0;
+	block->used += length + 1;
+
+	if (fold) {
+		size_t i = 0;
+
+		for (; i + 8 <= length; i += 8) {
+			uint64_t v = load_folded(word, length, i, 8);
+
+			memcpy(copy + i, &v, sizeof(v));
+		}
+		if (i < length) {
+			uint64_t v = load_folded(word, length, i, length - i);
+
+			memcpy(copy + i, &v, length - i);
+		}
+	} else {
+		memcpy(copy, word, length);
+	}
+
+	return copy;
+}
+
+const char *word_arena_copy(word_arena_block **arena, const char *word,
+		size_t length) {
+	return arena_copy(arena, word, length, 0);
+}
+
+/**
+ * Doubles the number of slots of the table.
+ * The stored hashes determine the new positions, so words are not touched.
+ */
+static int grow(word_table *table) {
+	size_t capacity = table->capacity * 2;
+	size_t mask = capacity - 1;
+	word_table_slot *slots = (word_table_slot *) calloc(capacity,
+			sizeof(word_table_slot));
+
+	if (!slots) {
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < table->capacity; i++) {
+		const word_table_slot *slot = &table->slots[i];
+
+		if (slot->word) {
+			size_t j = slot->hash & mask;
+
+			while (slots[j].word) {
+				j = (j + 1) & mask;
+			}
+			slots[j] = *slot;
+		}
+	}
+
+	free(table->slots);
+	table->slots = slots;
+	table->capacity = capacity;
+
+	return EXIT_SUCCESS;
+}
+
+int word_table_init(word_table *table, size_t capacity) {
+	size_t slots = MIN_CAPACITY;
+
+	// keep the load factor at or below one half
+	while (slots < 2 * capacity) {
+		slots *= 2;
+	}
+
+	table->slots = (word_table_slot *) calloc(slots, sizeof(word_table_slot));
+	table->capacity = slots;
+	table->size = 0;
+	table->arena = NULL;
+
+	return table->slots ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void word_arena_free(word_arena_block **arena) {
+	word_arena_block *block = *arena;
+
+	while (block) {
+		word_arena_block *next = block->next;
+
+		free(block);
+		block = next;
+	}
+
+	*arena = NULL;
+}
+
+void word_table_free(word_table *table) {
+	word_arena_free(&table->arena);
+	free(table->slots);
+	table->slots = NULL;
+	table->capacity = 0;
+	table->size = 0;
+}
+
+/**
+ * Adds count occurrences of the given word with the given hash to the
+ * table like word_table_add_hashed, and folds the case of the word first
+ * if fold is not zero.
+ */
+static inline int add(word_table *table, const char *word, size_t length,
+		uint32_t hash, uint64_t count, int fold) {
+	size_t mask = table->capacity - 1;
+	size_t i = hash & mask;
+	word_table_slot *slot;
+
+	for (;;) {
+		slot = &table->slots[i];
+
+		if (!slot->word) {
+			break;
+		}
+		if ((slot->hash == hash) && (slot->length == length)
+				&& equal_words(slot->word, word, length, fold)) {
+			slot->count += count;
+			return EXIT_SUCCESS;
+		}
+		i = (i + 1) & mask;
+	}
+
+	// the word is new
+	if (2 * (table->size + 1) > table->capacity) {
+		if (grow(table) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+
+		mask = table->capacity - 1;
+		i = hash & mask;
+		while (table->slots[i].word) {
+			i = (i + 1) & mask;
+		}
+		slot = &table->slots[i];
+	}
+
+	slot->word = arena_copy(&table->arena, word, length, fold);
+	if (!slot->word) {
+		return EXIT_FAILURE;
+	}
+	slot->hash = hash;
+	slot->length = (uint32_t) length;
+	slot->count = count;
+	table->size++;
+
+	return EXIT_SUCCESS;
+}
+
+void word_table_clear(word_table *table) {
+	word_arena_block *block = table->arena;
+
+	if (block) {
+		word_arena_free(&block->next);
+		block->used = 0;
+	}
+	memset(table->slots, 0, table->capacity * sizeof(word_table_slot));
+	table->size = 0;
+}
+
+int word_table_add_hashed(word_table *table, const char *word, size_t length,
+		uint32_t hash, uint64_t count) {
+	return add(table, word, length, hash, count, 0);
+}
+
+int word_table_add_folded(word_table *table, const char *word, size_t length,
+		uint64_t count) {
+	return add(table, word, length, hash(word, length, 1), count, 1);
+}
+
+/**
+ * Returns the slot of the given word like word_table_find, and folds the
+ * case of the word first if fold is not zero.
+ */
+static inline const word_table_slot *find(const word_table *table,
+		const char *word, size_t length, int fold) {
+	uint32_t word_hash = hash(word, length, fold);
+	size_t mask = table->capacity - 1;
+	size_t i = word_hash & mask;
+
+	while (table->slots[i].word) {
+		const word_table_slot *slot = &table->slots[i];
+
+		if ((slot->hash == word_hash) && (slot->length == length)
+				&& equal_words(slot->word, word, length, fold)) {
+			return slot;
+		}
+		i = (i + 1) & mask;
+	}
+
+	return NULL;
+}
+
+const word_table_slot *word_table_find(const word_table *table,
+		const char *word, size_t length) {
+	return find(table, word, length, 0);
+}
+
+const word_table_slot *word_table_find_folded(const word_table *table,
+		const char *word, size_t length) {
+	return find(table, word, length, 1);
+}
+
+int word_table_merge(word_table *destination, const word_table *source) {
+	for (size_t i = 0; i < source->capacity; i++) {
+		const word_table_slot *slot = &source->slots[i];
+
+		if (slot->word && (word_table_add_hashed(destination, slot->word,
+				slot->length, slot->hash, slot->count) != EXIT_SUCCESS)) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the number of bytes of the serialized record of a word of the
+ * given length.
+ */
+static inline size_t record_length(size_t length) {
+	size_t size = sizeof(word_record) + length + 1;
+
+	return (size + sizeof(word_record) - 1) & ~(sizeof(word_record) - 1);
+}
+
+/**
+ * Returns the number of bytes of the header of a serialized table with the
+ * given number of partitions.
+ * The header is padded to a multiple of the record header size.
+ */
+static inline size_t header_length(size_t partitions) {
+	size_t size = sizeof(uint64_t) + partitions * sizeof(word_partition);
+
+	return (size + sizeof(word_record) - 1) & ~(sizeof(word_record) - 1);
+}
+
+size_t word_table_serialized_length(const word_table *table,
+		size_t partitions) {
+	size_t length = header_length(partitions);
+
+	for (size_t i = 0; i < table->capacity; i++) {
+		if (table->slots[i].word) {
+			length += record_length(table->slots[i].length);
+		}
+	}
+
+	return length;
+}
+
+void word_table_serialize(const word_table *table, char *buffer,
+		size_t partitions) {
+	word_partition *index = (word_partition *) (buffer + sizeof(uint64_t));
+	size_t offset = header_length(partitions);
+
+	*(uint64_t *) buffer = partitions;
+
+	// compute the location of each partition
+	for (size_t p = 0; p < partitions; p++) {
+		index[p].offset = 0;
+		index[p].number_words = 0;
+	}
+	for (size_t i = 0; i < table->capacity; i++) {
+		const word_table_slot *slot = &table->slots[i];
+
+		if (slot->word) {
+			word_partition *partition = &index[word_partition_of(slot->hash,
+					partitions)];
+
+			// accumulate the length of the partition in its offset for now
+			partition->offset += record_length(slot->length);
+			partition->number_words++;
+		}
+	}
+	for (size_t p = 0; p < partitions; p++) {
+		size_t length = index[p].offset;
+
+		index[p].offset = offset;
+		offset += length;
+	}
+
+	// write the records, advancing each partition's offset as a cursor
+	for (size_t i = 0; i < table->capacity; i++) {
+		const word_table_slot *slot = &table->slots[i];
+
+		if (slot->word) {
+			word_partition *partition = &index[word_partition_of(slot->hash,
+					partitions)];
+			word_record *record = (word_record *) (buffer + partition->offset);
+
+			record->hash = slot->hash;
+			record->length = slot->length;
+			record->count = slot->count;
+			memcpy(record + 1, slot->word, slot->length + 1);
+			partition->offset += record_length(slot->length);
+		}
+	}
+
+	// restore the offsets of the partitions
+	offset = header_length(partitions);
+	for (size_t p = 0; p < partitions; p++) {
+		size_t end = index[p].offset;
+
+		index[p].offset = offset;
+		offset = end;
+	}
+}
+
+int word_table_check_serialized(const char *buffer, size_t length,
+		size_t partitions) {
+	size_t records_start = header_length(partitions);
+
+	if ((length < records_start) || (*(const uint64_t *) buffer != partitions)) {
+		return EXIT_FAILURE;
+	}
+
+	for (size_t p = 0; p < partitions; p++) {
+		const word_partition *index = word_serialized_partition(buffer, p);
+		size_t offset;
+
+		// each record takes at least one record header
+		if ((index->offset < records_start) || (index->offset > length)
+				|| (index->offset % sizeof(word_record) != 0)
+				|| (index->number_words
+						> (length - index->offset) / sizeof(word_record))) {
+			return EXIT_FAILURE;
+		}
+
+		offset = index->offset;
+		for (uint64_t i = 0; i < index->number_words; i++) {
+			const word_record *record = (const word_record *) (buffer + offset);
+			const char *word = word_record_word(record);
+			size_t available;
+
+			if ((offset > length) || (length - offset < sizeof(word_record))) {
+				return EXIT_FAILURE;
+			}
+			available = length - offset - sizeof(word_record);
+			if ((record->length >= available) || (word[record->length] != 0)
+					|| (record->count == 0)
+					|| (record->hash != word_hash(word, record->length))) {
+				return EXIT_FAILURE;
+			}
+			offset += record_length(record->length);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int word_table_merge_serialized(word_table *table, const char *buffer,
+		size_t partition) {
+	const word_partition *index = word_serialized_partition(buffer, partition);
+	const word_record *record = (const word_record *) (buffer + index->offset);
+
+	for (uint64_t i = 0; i < index->number_words; i++) {
+		if (word_table_add_hashed(table, word_record_word(record),
+				record->length, record->hash, record->count) != EXIT_SUCCESS) {
+			return EXIT_FAILURE;
+		}
+		record = word_record_next(record);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,256 @@
+/*
+ * word_table.h
+ *
+ *      Author: Fabian Foerg
+ */
+
+#ifndef WORD_TABLE_H_
+#define WORD_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Slot of the word table.
+ * The word points into the arena of the table and is null-terminated.
+ * Empty slots have a NULL word.
+ */
+typedef struct word_table_slot_t {
+	const char *word;
+	uint32_t hash;
+	uint32_t length;
+	uint64_t count;
+} word_table_slot;
+
+/**
+ * Block of the bump arena which holds the words of a table.
+ * An arena is a list of blocks, the first of which is being filled.
+ */
+typedef struct word_arena_block_t {
+	struct word_arena_block_t *next;
+	size_t used;
+	size_t size;
+	char data[1];
+} word_arena_block;
+
+/**
+ * Map from words to their frequency.
+ * The table uses open addressing with linear probing.
+ * The hash of each word is stored in its slot, so that probing rarely
+ * touches the words and growing the table does not rehash them.
+ * Words are copied into a bump arena, so they stay valid until the table
+ * is freed.
+ */
+typedef struct word_table_t {
+	word_table_slot *slots;
+	size_t capacity;
+	size_t size;
+	word_arena_block *arena;
+} word_table;
+
+/**
+ * Header of a word in the serialized form of a table.
+ * The header is followed by the word and a terminating null byte.
+ * Records are padded to a multiple of the header size.
+ */
+typedef struct word_record_t {
+	uint32_t hash;
+	uint32_t length;
+	uint64_t count;
+} word_record;
+
+/**
+ * Location of the records of one partition in the serialized form of a
+ * table.
+ * The offset is relative to the beginning of the serialized form.
+ *
+ * The serialized form begins with the number of partitions (uint64_t),
+ * followed by one word_partition per partition and the records of the
+ * partitions in partition order.
+ */
+typedef struct word_partition_t {
+	uint64_t offset;
+	uint64_t number_words;
+} word_partition;
+
+/**
+ * Returns the hash of the given word of the given length.
+ */
+uint32_t word_hash(const char *word, size_t length);
+
+/**
+ * Writes the given word of the given length with its case folded to
+ * folded, which must hold length bytes.
+ * ASCII letters are turned into lower case and the other UTF-8 characters
+ * into their simple case folding (see utf8_fold), which keeps the length
+ * of the word; invalid bytes are copied unchanged.
+ */
+void word_fold(const char *word, size_t length, char *folded);
+
+/**
+ * Returns the 64-bit hash of the given word, whose case is folded like by
+ * word_fold if fold is not zero.
+ * Its low 32 bits are the hash of word_hash for words which are not
+ * folded.
+ */
+uint64_t word_hash64(const char *word, size_t length, int fold);
+
+/**
+ * Returns nonzero, iff the given stored word of the given length equals the
+ * given word, whose case is folded like by word_fold if fold is not zero.
+ */
+int word_equal(const char *stored, const char *word, size_t length,
+		int fold);
+
+/**
+ * Returns the partition out of the given number of partitions to which a
+ * word with the given hash belongs.
+ * It uses the high bits of the hash, whereas tables use the low bits.
+ */
+static inline size_t word_partition_of(uint32_t hash, size_t partitions) {
+	return (size_t) (((uint64_t) hash * partitions) >> 32);
+}
+
+/**
+ * Returns the word of the given serialized record.
+ */
+static inline const char *word_record_word(const word_record *record) {
+	return (const char *) (record + 1);
+}
+
+/**
+ * Returns the serialized record which follows the given record.
+ */
+static inline const word_record *word_record_next(const word_record *record) {
+	size_t size = sizeof(word_record) + record->length + 1;
+
+	return record + (size + sizeof(word_record) - 1) / sizeof(word_record);
+}
+
+/**
+ * Returns the location of the given partition in the given serialized
+ * form of a table.
+ */
+static inline const word_partition *word_serialized_partition(
+		const char *buffer, size_t partition) {
+	return ((const word_partition *) (buffer + sizeof(uint64_t))) + partition;
+}
+
+/**
+ * Copies the given word into the given arena and terminates it with a null
+ * byte.
+ * The copy stays valid until the arena is freed.
+ * Returns the copy, or NULL if there is not enough memory.
+ */
+const char *word_arena_copy(word_arena_block **arena, const char *word,
+		size_t length);
+
+/**
+ * Frees the blocks of the given arena.
+ */
+void word_arena_free(word_arena_block **arena);
+
+/**
+ * Initializes an empty table that can take about capacity words before it
+ * grows.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_table_init(word_table *table, size_t capacity);
+
+/**
+ * Frees the slots and words of the given table.
+ */
+void word_table_free(word_table *table);
+
+/**
+ * Removes all words from the given table, but keeps its slots and the
+ * most recent block of its arena for the next words.
+ */
+void word_table_clear(word_table *table);
+
+/**
+ * Adds count occurrences of the given word with the given hash to the table.
+ * The word does not need to be null-terminated.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_table_add_hashed(word_table *table, const char *word, size_t length,
+		uint32_t hash, uint64_t count);
+
+/**
+ * Adds count occurrences of the given word to the table.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+static inline int word_table_add(word_table *table, const char *word,
+		size_t length, uint64_t count) {
+	return word_table_add_hashed(table, word, length, word_hash(word, length),
+			count);
+}
+
+/**
+ * Adds count occurrences of the given word with its case folded like by
+ * word_fold to the table.
+ * The case is folded eight bytes at a time while the word is hashed,
+ * compared, and copied into the table, so the word itself is untouched.
+ * Only blocks with UTF-8 characters beyond ASCII are folded byte by byte.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_table_add_folded(word_table *table, const char *word, size_t length,
+		uint64_t count);
+
+/**
+ * Returns the slot of the given word, or NULL if the table does not
+ * contain it.
+ */
+const word_table_slot *word_table_find(const word_table *table,
+		const char *word, size_t length);
+
+/**
+ * Returns the slot of the given word with its case folded like by
+ * word_fold, or NULL if the table does not contain it.
+ */
+const word_table_slot *word_table_find_folded(const word_table *table,
+		const char *word, size_t length);
+
+/**
+ * Adds the words of the table source along with their counts to the
+ * table destination.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_table_merge(word_table *destination, const word_table *source);
+
+/**
+ * Returns the number of bytes word_table_serialize writes for the given table
+ * and number of partitions.
+ */
+size_t word_table_serialized_length(const word_table *table,
+		size_t partitions);
+
+/**
+ * Writes the words of the given table along with their hashes and counts
+ * into buffer, which must hold word_table_serialized_length bytes.
+ * The words are grouped into the given number of partitions by their hash.
+ */
+void word_table_serialize(const word_table *table, char *buffer,
+		size_t partitions);
+
+/**
+ * Checks that buffer of the given length holds the serialized form of a
+ * table with the given number of partitions: that the partitions and
+ * records lie within the buffer, and that each word is null-terminated,
+ * has a positive count, and has its own hash.
+ * Serialized forms which do not come from this process, such as files,
+ * must be checked before they are merged.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if the serialized form is corrupt.
+ */
+int word_table_check_serialized(const char *buffer, size_t length,
+		size_t partitions);
+
+/**
+ * Adds the words of the given partition of the serialized form of a table
+ * in buffer to the given table.
+ * Returns EXIT_SUCCESS, or EXIT_FAILURE if there is not enough memory.
+ */
+int word_table_merge_serialized(word_table *table, const char *buffer,
+		size_t partition);
+
+#endif /* WORD_TABLE_H_ */